@@ -6,4 +6,6 @@ set(RAY_TRACER_FILES
     ${ACCELERATION_DIR}/SimpleContainer.hpp
 	${ACCELERATION_DIR}/BoundingVolumeHierarchy.hpp
 	${ACCELERATION_DIR}/BoundingVolumeHierarchy.cpp
+    ${ACCELERATION_DIR}/LightBVH.hpp
+    ${ACCELERATION_DIR}/LightBVH.cpp
 )
\ No newline at end of file
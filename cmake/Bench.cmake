@@ -0,0 +1,10 @@
+set(BENCH_DIR source/bench)
+
+set(RAY_TRACER_BENCH_FILES
+    ${RAY_TRACER_BENCH_FILES}
+    ${BENCH_DIR}/Benchmark.hpp
+    ${BENCH_DIR}/Benchmark.cpp
+    ${BENCH_DIR}/MicroBenchmarks.cpp
+    ${BENCH_DIR}/SceneBenchmarks.cpp
+    ${BENCH_DIR}/BenchMain.cpp
+)
\ No newline at end of file
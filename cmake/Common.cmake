@@ -4,6 +4,12 @@ set(COMMON_DIR source/common)
 set(RAY_TRACER_FILES
     ${RAY_TRACER_FILES}
     ${COMMON_DIR}/Types.hpp
+    ${COMMON_DIR}/Arena.hpp
     ${COMMON_DIR}/Arch.hpp
 	${COMMON_DIR}/Threading.hpp
+    ${COMMON_DIR}/Memory.hpp
+    ${COMMON_DIR}/Stats.hpp
+    ${COMMON_DIR}/Stats.cpp
+    ${COMMON_DIR}/Trace.hpp
+    ${COMMON_DIR}/Trace.cpp
     )
\ No newline at end of file
@@ -5,7 +5,16 @@ set(RAY_TRACER_FILES
     ${RAY_TRACER_FILES}
     ${FRAMEBUFFER_DIR}/RenderTarget.hpp
     ${FRAMEBUFFER_DIR}/RenderTarget.cpp
+    ${FRAMEBUFFER_DIR}/TiledBuffer.hpp
+    ${FRAMEBUFFER_DIR}/TiledBuffer.cpp
     ${FRAMEBUFFER_DIR}/Image.hpp
+    ${FRAMEBUFFER_DIR}/ImageWriter.hpp
+    ${FRAMEBUFFER_DIR}/ImageWriter.cpp
+    ${FRAMEBUFFER_DIR}/Deflate.hpp
+    ${FRAMEBUFFER_DIR}/Deflate.cpp
     ${FRAMEBUFFER_DIR}/ImagePNG.cpp
+    ${FRAMEBUFFER_DIR}/ImageEXR.hpp
+    ${FRAMEBUFFER_DIR}/ImageEXR.cpp
     ${FRAMEBUFFER_DIR}/ImageTGA.cpp
+    ${FRAMEBUFFER_DIR}/ImageHDR.cpp
 )
\ No newline at end of file
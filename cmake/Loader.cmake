@@ -0,0 +1,16 @@
+set(LOADER_DIR source/loader)
+
+set(RAY_TRACER_FILES
+    ${RAY_TRACER_FILES}
+    ${LOADER_DIR}/Loader.hpp
+    ${LOADER_DIR}/Json.hpp
+    ${LOADER_DIR}/Json.cpp
+    ${LOADER_DIR}/Loader.cpp
+    ${LOADER_DIR}/MappedFile.hpp
+    ${LOADER_DIR}/MappedFile.cpp
+    ${LOADER_DIR}/ObjImporter.hpp
+    ${LOADER_DIR}/ObjImporter.cpp
+    ${LOADER_DIR}/SceneBinary.cpp
+    ${LOADER_DIR}/SceneGltf.cpp
+    ${LOADER_DIR}/SceneText.cpp
+)
\ No newline at end of file
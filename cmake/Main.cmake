@@ -4,12 +4,19 @@ set(RAY_TRACER_FILES
     ${RAY_TRACER_FILES}
     source/Main.cpp
     source/Interaction.hpp
+    source/Interaction.cpp
     source/RayTracer.hpp
     source/Primitive.hpp
     source/Material.hpp
     source/Material.cpp
     source/RayTracer.cpp
+    source/AmbientOcclusion.hpp
+    source/AmbientOcclusion.cpp
+    source/TraversalHeatmap.hpp
+    source/TraversalHeatmap.cpp
     source/Light.hpp
+    source/EnvironmentLight.hpp
+    source/EnvironmentLight.cpp
     source/BRDF.hpp
     source/Mesh.hpp
     )
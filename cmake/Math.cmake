@@ -8,7 +8,11 @@ set(RAY_TRACER_FILES
     ${MATH_DIR}/Integer.cpp
     ${MATH_DIR}/Ray.hpp
     ${MATH_DIR}/Bounds.hpp
+    ${MATH_DIR}/Bounds.cpp
     ${MATH_DIR}/Matrix44.hpp
     ${MATH_DIR}/Matrix44.cpp
     ${MATH_DIR}/CommonMath.hpp
+    ${MATH_DIR}/Random.hpp
+    ${MATH_DIR}/Distribution.hpp
+    ${MATH_DIR}/Distribution.cpp
     )
\ No newline at end of file
@@ -0,0 +1,11 @@
+set(POSTPROCESS_DIR source/postprocess)
+
+set(RAY_TRACER_FILES
+    ${RAY_TRACER_FILES}
+    ${POSTPROCESS_DIR}/Bloom.hpp
+    ${POSTPROCESS_DIR}/Bloom.cpp
+    ${POSTPROCESS_DIR}/Denoiser.hpp
+    ${POSTPROCESS_DIR}/Denoiser.cpp
+    ${POSTPROCESS_DIR}/Tonemapper.hpp
+    ${POSTPROCESS_DIR}/Tonemapper.cpp
+)
\ No newline at end of file
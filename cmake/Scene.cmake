@@ -4,6 +4,8 @@ set(SCENE_DIR source/scene)
 set (RAY_TRACER_FILES 
     ${RAY_TRACER_FILES}
     ${SCENE_DIR}/Camera.hpp
+    ${SCENE_DIR}/DefaultScene.hpp
+    ${SCENE_DIR}/DefaultScene.cpp
     ${SCENE_DIR}/Scene.hpp
     ${SCENE_DIR}/Scene.cpp
     )
\ No newline at end of file
@@ -0,0 +1,11 @@
+set(TEXTURE_DIR source/texture)
+
+set(RAY_TRACER_FILES
+    ${RAY_TRACER_FILES}
+    ${TEXTURE_DIR}/Texture.hpp
+    ${TEXTURE_DIR}/Texture.cpp
+    ${TEXTURE_DIR}/TextureSampler.hpp
+    ${TEXTURE_DIR}/TextureSampler.cpp
+    ${TEXTURE_DIR}/TileCache.hpp
+    ${TEXTURE_DIR}/TileCache.cpp
+)
\ No newline at end of file
@@ -0,0 +1,58 @@
+// Raytracer.
+#include "AmbientOcclusion.hpp"
+#include "Interaction.hpp"
+#include "Material.hpp"
+
+#include "scene/Scene.hpp"
+
+#include "math/Distribution.hpp"
+
+namespace rt {
+
+
+Float3 AmbientOcclusionIntegrator::li(Ray& ray, Scene* pScene, Random& rng, I32 /*depth*/, SampleAOVs* pAovs)
+{
+    SurfaceInteraction si = { };
+    si.time = INFINITY;
+    if (!pScene->intersects(ray, si))
+    {
+        if (pAovs)
+            *pAovs = { INFINITY, Float3(), Float3(), ~0u, Float3(), Float3(), 0.f };
+        return Float3();
+    }
+
+    // Both sides of a surface are shaded, about the normal facing the viewer.
+    Float3 n = dot(si.vNormal, si.wo) < 0.f ? -si.vNormal : si.vNormal;
+    Float3 s, t;
+    coordinateSystem(n, s, t);
+
+    // Start a little off the surface so the rays don't hit it again, scaled with the
+    // position since float precision is relative.
+    F32 scale = fmaxf(fabsf(si.vPosition.x), fmaxf(fabsf(si.vPosition.y), fabsf(si.vPosition.z)));
+    Float3 origin = si.vPosition + n * (1e-4f * (1.f + scale));
+
+    U32 unoccluded = 0;
+    for (U32 i = 0; i < m_aoSamples; ++i)
+    {
+        // Cosine weighting cancels the cosine of the estimator, each open ray counts the same.
+        Float3 d = cosineSampleHemisphere(rng.nextFloat2());
+        Ray aoRay(origin, s * d.x + t * d.y + n * d.z, m_maxDistance);
+        if (!pScene->occluded(aoRay))
+            ++unoccluded;
+    }
+    F32 ao = (F32)unoccluded / (F32)m_aoSamples;
+    Float3 radiance(ao, ao, ao);
+
+    if (pAovs)
+    {
+        pAovs->depth = length(si.vPosition - ray.o);
+        pAovs->normal = si.vNormal;
+        IMaterial* pMaterial = pScene->getMaterial(si);
+        pAovs->albedo = pMaterial ? pMaterial->getAlbedo(si) : Float3();
+        pAovs->primitiveId = si.primitiveId;
+        pAovs->direct = radiance;
+        pAovs->indirect = Float3();
+    }
+    return radiance;
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,42 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "RayTracer.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+// Geometry only preview, shading every first hit by how much of the hemisphere above it is
+// open. Occlusion rays only look for any hit within the max distance, so this costs a
+// fraction of full shading and mostly measures raw traversal speed. Drop in for Integrator,
+// everything but li() is shared.
+class AmbientOcclusionIntegrator : public Integrator
+{
+public:
+    AmbientOcclusionIntegrator(U32 aoSamples = 16, F32 maxDistance = INFINITY)
+        : m_aoSamples(aoSamples > 0 ? aoSamples : 1)
+        , m_maxDistance(maxDistance)
+    {
+        // Sorted shading runs the base class' shading, not li().
+        setSortedShading(false);
+    }
+
+    // Occlusion rays cast per camera sample, cosine weighted about the normal.
+    void setAOSamples(U32 aoSamples) { m_aoSamples = aoSamples > 0 ? aoSamples : 1; }
+    U32 getAOSamples() const { return m_aoSamples; }
+
+    // Geometry farther than this doesn't occlude. Keep it short for the classic contact shadow look.
+    void setMaxDistance(F32 maxDistance) { m_maxDistance = maxDistance; }
+    F32 getMaxDistance() const { return m_maxDistance; }
+
+    // Fraction of unoccluded occlusion rays at the first hit, black where the ray escapes.
+    Float3 li(Ray& ray, Scene* pScene, Random& rng, I32 depth = 0, SampleAOVs* pAovs = nullptr) override;
+
+private:
+    U32 m_aoSamples;
+    F32 m_maxDistance;
+};
+} // rt
\ No newline at end of file
@@ -0,0 +1,161 @@
+// Raytracer.
+#include "EnvironmentLight.hpp"
+#include "Interaction.hpp"
+
+#include "framebuffer/Image.hpp"
+#include "math/CommonMath.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+// Largest width of the luminance map used for sampling. Height is half of it.
+static const U32 kMaxDistributionWidth = 512;
+
+static F32 luminance(const Float3& c)
+{
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+B32 EnvironmentLight::loadHDR(const std::string& filename)
+{
+    U32 width = 0, height = 0;
+    std::vector<Float3> pixels;
+    if (!rt::loadHDR(filename, width, height, pixels))
+        return false;
+    setImage(width, height, pixels);
+    return true;
+}
+
+void EnvironmentLight::setImage(U32 width, U32 height, const std::vector<Float3>& pixels)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels = pixels;
+    buildDistribution();
+}
+
+void EnvironmentLight::buildDistribution()
+{
+    if (m_width == 0 || m_height == 0)
+        return;
+
+    // Box filter the luminance down to the distribution resolution. Every source pixel
+    // lands in exactly one cell, so small bright features are never skipped.
+    U32 nu = m_width < kMaxDistributionWidth ? m_width : kMaxDistributionWidth;
+    U32 nv = m_height < kMaxDistributionWidth / 2 ? m_height : kMaxDistributionWidth / 2;
+    std::vector<F32> lum((U64)nu * nv, 0.f);
+    std::vector<U32> counts((U64)nu * nv, 0u);
+    for (U32 y = 0; y < m_height; ++y)
+    {
+        U32 v = (U32)((U64)y * nv / m_height);
+        for (U32 x = 0; x < m_width; ++x)
+        {
+            U32 u = (U32)((U64)x * nu / m_width);
+            lum[(U64)v * nu + u] += luminance(m_pixels[(U64)y * m_width + x]);
+            counts[(U64)v * nu + u] += 1;
+        }
+    }
+
+    // Weigh by sin(theta), rows near the poles cover less solid angle.
+    for (U32 v = 0; v < nv; ++v)
+    {
+        F32 sinTheta = sinf((F32)RT_PI * ((F32)v + 0.5f) / (F32)nv);
+        for (U32 u = 0; u < nu; ++u)
+        {
+            U64 i = (U64)v * nu + u;
+            lum[i] = (counts[i] > 0) ? (lum[i] / (F32)counts[i]) * sinTheta : 0.f;
+        }
+    }
+    m_distribution.build(lum.data(), nu, nv);
+}
+
+Float2 EnvironmentLight::directionToUV(const Float3& wLight) const
+{
+    F32 theta = acosf(RT_CLAMP(wLight.y, -1.f, 1.f));
+    F32 phi = atan2f(wLight.z, wLight.x);
+    if (phi < 0.f) phi += 2.f * (F32)RT_PI;
+    return Float2(phi * (F32)(0.5 * RT_INV_PI), theta * (F32)RT_INV_PI);
+}
+
+Float3 EnvironmentLight::uvToDirection(const Float2& uv) const
+{
+    F32 phi = uv.x * 2.f * (F32)RT_PI;
+    F32 theta = uv.y * (F32)RT_PI;
+    F32 sinTheta = sinf(theta);
+    return Float3(sinTheta * cosf(phi), cosf(theta), sinTheta * sinf(phi));
+}
+
+Float3 EnvironmentLight::lookup(const Float2& uv) const
+{
+    if (m_pixels.empty())
+        return Float3();
+
+    // Bilinear filter, wrapping around in u and clamping at the poles.
+    F32 x = uv.x * (F32)m_width - 0.5f;
+    F32 y = uv.y * (F32)m_height - 0.5f;
+    F32 fx = floorf(x);
+    F32 fy = floorf(y);
+    F32 dx = x - fx;
+    F32 dy = y - fy;
+    I32 x0 = (I32)fx;
+    I32 y0 = (I32)fy;
+
+    Float3 c;
+    for (I32 j = 0; j < 2; ++j)
+    {
+        I32 py = RT_CLAMP(y0 + j, 0, (I32)m_height - 1);
+        F32 wy = j ? dy : 1.f - dy;
+        for (I32 i = 0; i < 2; ++i)
+        {
+            I32 px = ((x0 + i) % (I32)m_width + (I32)m_width) % (I32)m_width;
+            F32 wx = i ? dx : 1.f - dx;
+            c += m_pixels[(U64)py * m_width + px] * (wx * wy);
+        }
+    }
+    return c;
+}
+
+Float3 EnvironmentLight::le(const Ray& ray) const
+{
+    Float3 wLight = normalize(Float4(ray.dir, 0.f) * m_worldToLight);
+    return lookup(directionToUV(wLight)) * m_scale;
+}
+
+Float3 EnvironmentLight::sampleLi(const SurfaceInteraction& si, const Float2& u,
+                                  Float3& wi, F32& pdf, Ray& shadowRay)
+{
+    pdf = 0.f;
+    if (m_pixels.empty())
+        return Float3();
+
+    F32 mapPdf = 0.f;
+    Float2 uv = m_distribution.sample(u, mapPdf);
+    if (mapPdf == 0.f)
+        return Float3();
+
+    // Convert the density from image space to solid angle.
+    F32 sinTheta = sinf(uv.y * (F32)RT_PI);
+    if (sinTheta == 0.f)
+        return Float3();
+    pdf = mapPdf / (2.f * (F32)RT_PI * (F32)RT_PI * sinTheta);
+
+    wi = normalize(Float4(uvToDirection(uv), 0.f) * m_lightToWorld);
+    Float3 err = si.vNormal * 0.0005f;
+    shadowRay = { si.vPosition + (dot(wi, si.vNormal) < 0.f ? -err : err), wi };
+    return lookup(uv) * m_scale;
+}
+
+F32 EnvironmentLight::pdfLi(const SurfaceInteraction& /*si*/, const Float3& wi)
+{
+    if (m_pixels.empty())
+        return 0.f;
+    Float3 wLight = normalize(Float4(wi, 0.f) * m_worldToLight);
+    Float2 uv = directionToUV(wLight);
+    F32 sinTheta = sinf(uv.y * (F32)RT_PI);
+    if (sinTheta == 0.f)
+        return 0.f;
+    return m_distribution.pdf(uv) / (2.f * (F32)RT_PI * (F32)RT_PI * sinTheta);
+}
+} // rt
\ No newline at end of file
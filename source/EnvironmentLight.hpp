@@ -0,0 +1,64 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Distribution.hpp"
+#include "math/Float.hpp"
+#include "math/Matrix44.hpp"
+
+#include "Light.hpp"
+
+#include <string>
+#include <vector>
+
+namespace rt {
+
+
+// Infinitely far away light, with radiance taken from an equirectangular (latitude-longitude)
+// HDR image wrapped around the scene. The image is +y up, with u along the azimuth and v
+// from the top of the sky down to the ground.
+//
+// Directions are importance sampled from a downsampled luminance map, so bright areas like
+// the sun are found with few samples. The same map gives pdfLi(), so evaluating the density
+// for multiple importance sampling stays cheap and consistent with sampling.
+class EnvironmentLight : public Light
+{
+public:
+    EnvironmentLight(const Matrix44& lightToWorld = Matrix44(), const Float3& scale = Float3(1.f, 1.f, 1.f))
+        : m_lightToWorld(lightToWorld)
+        , m_worldToLight(inverse(lightToWorld))
+        , m_scale(scale)
+        , m_width(0)
+        , m_height(0) { }
+
+    // Load the radiance map from a .hdr file. Returns false if the image can not be read.
+    B32 loadHDR(const std::string& filename);
+
+    // Set the radiance map directly, width * height pixels, top row first.
+    void setImage(U32 width, U32 height, const std::vector<Float3>& pixels);
+
+    Float3 le(const Ray& ray) const override;
+
+    Float3 sampleLi(const SurfaceInteraction& si, const Float2& u,
+                    Float3& wi, F32& pdf, Ray& shadowRay) override;
+
+    F32 pdfLi(const SurfaceInteraction& si, const Float3& wi) override;
+
+    B32 isInfinite() const override { return true; }
+
+private:
+    void buildDistribution();
+
+    Float3 lookup(const Float2& uv) const;
+    Float2 directionToUV(const Float3& wLight) const;
+    Float3 uvToDirection(const Float2& uv) const;
+
+    Matrix44            m_lightToWorld;
+    Matrix44            m_worldToLight;
+    Float3              m_scale;
+    U32                 m_width;
+    U32                 m_height;
+    std::vector<Float3> m_pixels;
+    Distribution2D      m_distribution;
+};
+} // rt
\ No newline at end of file
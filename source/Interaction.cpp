@@ -0,0 +1,62 @@
+// Raytracer.
+#include "Interaction.hpp"
+
+#include "math/Ray.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+void SurfaceInteraction::computeDifferentials(const Ray& ray)
+{
+    dpdx = Float3();
+    dpdy = Float3();
+    dudx = dvdx = 0.f;
+    dudy = dvdy = 0.f;
+
+    if (!ray.hasDifferentials)
+        return;
+
+    // Intersect the offset rays with the plane tangent to the surface.
+    F32 d = dot(vNormal, vPosition);
+    F32 tx = -(dot(vNormal, ray.rxOrigin) - d) / dot(vNormal, ray.rxDirection);
+    F32 ty = -(dot(vNormal, ray.ryOrigin) - d) / dot(vNormal, ray.ryDirection);
+    if (!isfinite(tx) || !isfinite(ty))
+        return;
+    dpdx = ray.rxOrigin + ray.rxDirection * tx - vPosition;
+    dpdy = ray.ryOrigin + ray.ryDirection * ty - vPosition;
+
+    // dp = dpdu * du + dpdv * dv is overdetermined, solve it on the two axes 
+    // the normal is the smallest along, which keeps the system well conditioned.
+    U32 dim0, dim1;
+    Float3 n = Float3(fabsf(vNormal.x), fabsf(vNormal.y), fabsf(vNormal.z));
+    if (n.x > n.y && n.x > n.z)
+    {
+        dim0 = 1; dim1 = 2;
+    }
+    else if (n.y > n.z)
+    {
+        dim0 = 0; dim1 = 2;
+    }
+    else
+    {
+        dim0 = 0; dim1 = 1;
+    }
+
+    F32 a00 = dpdu[dim0], a01 = dpdv[dim0];
+    F32 a10 = dpdu[dim1], a11 = dpdv[dim1];
+    F32 det = a00 * a11 - a01 * a10;
+    if (fabsf(det) < 1e-12f)
+    {
+        dpdx = Float3();
+        dpdy = Float3();
+        return;
+    }
+    F32 invDet = 1.f / det;
+    dudx = (a11 * dpdx[dim0] - a01 * dpdx[dim1]) * invDet;
+    dvdx = (a00 * dpdx[dim1] - a10 * dpdx[dim0]) * invDet;
+    dudy = (a11 * dpdy[dim0] - a01 * dpdy[dim1]) * invDet;
+    dvdy = (a00 * dpdy[dim1] - a10 * dpdy[dim0]) * invDet;
+}
+} // rt
\ No newline at end of file
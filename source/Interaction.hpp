@@ -6,23 +6,61 @@
 
 namespace rt {
 
-struct IMaterial;
+struct Ray;
 
 
+// Material ids index the scene's material table. The top bit marks primitives that are area
+// lights, and the other bits all set means no material.
+static const U32 kEmissiveMaterialBit   = 0x80000000u;
+static const U32 kNoMaterial            = 0x7FFFFFFFu;
+
+// What intersection tests keep while searching for the closest hit, a quarter of a cache line.
+// The surface interaction is only worked out from it once, for the hit that's kept.
+struct HitRecord
+{
+    F32         time;
+    // Scene index of the primitive hit.
+    U32         primitiveId;
+    // Parametric coordinates of the hit on the shape, barycentrics for triangles.
+    Float2      uv;
+};
+
+static_assert(sizeof(HitRecord) == 16, "HitRecord should stay a quarter of a cache line");
+
 // A surface interaction made by a given ray, will need to be stored as data to be used 
 // for lighting.
 struct SurfaceInteraction
 {
     Float3      vNormal;
     Float3      vPosition;
-    Float3      vTexCoord;
+    Float2      vTexCoord;
 
     // Direction of outgoing light, which is usually being taken in by the viewer, or eye.
     Float3      wo;
     Float3      dpdu; // tangent u.
     Float3      dpdv; // tangent v.
 
-    IMaterial*  pMaterial;
+    // Screen space derivatives of the position and texture coordinates, from the differentials 
+    // of the ray that made this interaction. Left at zero if the ray had none.
+    Float3      dpdx;
+    Float3      dpdy;
+    F32         dudx, dvdx;
+    F32         dudy, dvdy;
+
+    // Scene index of the primitive hit, and of its material. The scene looks up the material,
+    // and the emitter when the primitive is a light.
+    U32         primitiveId;
+    U32         materialId;
     F32         time;
+
+    U32 getMaterialIndex() const { return materialId & ~kEmissiveMaterialBit; }
+    B32 isEmissive() const { return (materialId & kEmissiveMaterialBit) != 0; }
+
+    // Fill in the screen space derivatives, by intersecting the ray's offset rays
+    // with the tangent plane at the interaction.
+    void computeDifferentials(const Ray& ray);
 };
+
+// Ids instead of pointers keep the record within this budget.
+static_assert(sizeof(SurfaceInteraction) <= 120, "SurfaceInteraction grew past its budget");
 } // rt
\ No newline at end of file
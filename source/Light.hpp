@@ -1,27 +1,77 @@
 // Raytracer.
 #pragma once
 
+#include "math/Bounds.hpp"
+#include "math/CommonMath.hpp"
 #include "math/Float.hpp"
+#include "math/Matrix44.hpp"
 #include "math/Ray.hpp"
 
 #include "Interaction.hpp"
+#include "Primitive.hpp"
 
 namespace rt {
 
 struct SurfaceInteraction;
 
-struct Light 
+// Spatial and directional bounds of a light's emission. Used by the light hierarchy to
+// estimate how much a light (or cluster of lights) contributes to a given shading point.
+struct LightBounds
 {
-    // Light radiance (luminance)
-    virtual Float3 sampleLi(const SurfaceInteraction& si, Float3& wi) = 0;
-    
-    virtual Float3 getLightDirection() = 0;
+    Bounds3 bounds;
+    // Principal direction of emission.
+    Float3  w;
+    // Total emitted power.
+    F32     phi;
+    // Cosine of the spread of w, and of the falloff angle past that spread.
+    F32     cosThetaO;
+    F32     cosThetaE;
+    B32     twoSided;
+};
+
+// Spawn a shadow ray from the interaction towards pLight, stopping just short of it
+// so the light does not shadow itself.
+inline Ray spawnShadowRay(const SurfaceInteraction& si, const Float3& pLight)
+{
+    Float3 err = si.vNormal * 0.0005f;
+    Float3 origin = si.vPosition + (dot(pLight - si.vPosition, si.vNormal) < 0.f ? -err : err);
+    Float3 toLight = pLight - origin;
+    F32 dist = length(toLight);
+    return { origin, toLight / dist, dist * (1.f - 0.001f) };
+}
+
+struct Light
+{
+    Light() : m_shadowing(false) { }
+    virtual ~Light() { }
+
+    // Light radiance (luminance) arriving at the interaction. Writes the direction towards the light
+    // into wi, the solid angle density of having sampled it into pdf (1 for delta lights, which can
+    // only be sampled one way), and the ray to test visibility with into shadowRay.
+    // u is a uniform sample in [0, 1)^2, ignored by delta lights.
+    virtual Float3 sampleLi(const SurfaceInteraction& si, const Float2& u,
+                            Float3& wi, F32& pdf, Ray& shadowRay) = 0;
+
+    // Solid angle density of sampleLi() choosing wi from the interaction. 0 for delta lights,
+    // since no other sampling technique could ever pick their direction.
+    virtual F32 pdfLi(const SurfaceInteraction& /*si*/, const Float3& /*wi*/) { return 0.f; }
+
+    // Radiance carried along a ray that escapes the scene. Only infinite lights emit this way.
+    virtual Float3 le(const Ray& /*ray*/) const { return Float3(); }
+
+    // Lights at infinity (environment) surround the whole scene, and are looked up by rays that miss.
+    virtual B32 isInfinite() const { return false; }
+
+    // Number of samples to take from this light per shading point.
+    virtual U32 getSampleCount() const { return 1; }
 
     B32 isShadowing() const { return m_shadowing; }
 
     void enableShadowing(B32 enable) { m_shadowing = enable; }
 
-    virtual Ray emitShadowRay(SurfaceInteraction& si) = 0;
+    // Obtain the bounds of this light, for building the light hierarchy. Lights that can not
+    // be bounded (directional, environment) return false, and are sampled separately.
+    virtual B32 getLightBounds(LightBounds& /*lightBounds*/) const { return false; }
 
 private:
     B32 m_shadowing;
@@ -32,44 +82,115 @@ struct PointLight : public Light
     Float3 position;
     Float3 i;
 
-    Float3 sampleLi(const SurfaceInteraction& si, Float3& wi) override {
+    Float3 sampleLi(const SurfaceInteraction& si, const Float2& /*u*/,
+                    Float3& wi, F32& pdf, Ray& shadowRay) override
+    {
         wi = normalize(position - si.vPosition);
+        pdf = 1.f;
+        shadowRay = spawnShadowRay(si, position);
         return i / length2(position - si.vPosition);
     }
+
+    B32 getLightBounds(LightBounds& lightBounds) const override
+    {
+        // Point lights emit uniformly in all directions.
+        lightBounds.bounds = { position, position };
+        lightBounds.w = Float3(0.f, 0.f, 1.f);
+        lightBounds.phi = 4.f * (F32)RT_PI * fmaxf(i.x, fmaxf(i.y, i.z));
+        lightBounds.cosThetaO = -1.f;
+        lightBounds.cosThetaE = 0.f;
+        lightBounds.twoSided = false;
+        return true;
+    }
 };
 
-struct DirectionLight : public Light 
+struct DirectionLight : public Light
 {
     Float3 wi; // light direction.
     Float3 l;  // light radiance.
 
-    Float3 sampleLi(const SurfaceInteraction& si, Float3& wi) override {
-        wi = this->wi;
-        return l;
-    }
-
-    Float3 getLightDirection() override
-    {
-        return wi;
-    }
-
-    Ray emitShadowRay(SurfaceInteraction& si) override
+    Float3 sampleLi(const SurfaceInteraction& si, const Float2& /*u*/,
+                    Float3& wi, F32& pdf, Ray& shadowRay) override
     {
+        wi = this->wi;
+        pdf = 1.f;
         Float3 err = si.vNormal * 0.0005f;
-        return { si.vPosition + err, wi };
+        shadowRay = { si.vPosition + err, wi };
+        return l;
     }
 };
 
 
+// Lights that emit from the surface of a shape. Primitives sharing the shape should point to the
+// light with Scene::createPrimitive(), so rays hitting them pick up the emission.
 struct AreaLight : public Light
 {
-    AreaLight(const Matrix44& lightToWorld, I32 nSamples);
+    AreaLight(const Matrix44& lightToWorld, I32 nSamples)
+        : m_lightToWorld(lightToWorld)
+        , m_worldToLight(inverse(lightToWorld))
+        , m_nSamples(nSamples > 0 ? nSamples : 1) { }
+
+    // Emitted radiance leaving the surface point si in direction w.
     virtual Float3 l(const SurfaceInteraction& si, const Float3& w) const = 0;
 
+    U32 getSampleCount() const override { return (U32)m_nSamples; }
+
+protected:
+    Matrix44 m_lightToWorld;
+    Matrix44 m_worldToLight;
+    I32      m_nSamples;
 };
 
 struct DiffuseAreaLight : public AreaLight
 {
-    virtual Float3 l(const SurfaceInteraction& si, const Float3& w) const override { return Float3(); }
+    DiffuseAreaLight(const Matrix44& lightToWorld, I32 nSamples, Shape* pShape,
+                     const Float3& lEmit, B32 twoSided = false)
+        : AreaLight(lightToWorld, nSamples)
+        , m_pShape(pShape)
+        , m_lEmit(lEmit)
+        , m_twoSided(twoSided) { }
+
+    // Lambertian emitter, constant radiance over the outward side of the surface.
+    virtual Float3 l(const SurfaceInteraction& si, const Float3& w) const override
+    {
+        return (m_twoSided || dot(si.vNormal, w) > 0.f) ? m_lEmit : Float3();
+    }
+
+    Float3 sampleLi(const SurfaceInteraction& si, const Float2& u,
+                    Float3& wi, F32& pdf, Ray& shadowRay) override
+    {
+        // Let the shape pick a point, ideally only from the part visible to si.
+        SurfaceInteraction lightSI = { };
+        if (!m_pShape->sample(si, u, lightSI, pdf) || pdf == 0.f)
+        {
+            pdf = 0.f;
+            return Float3();
+        }
+        wi = normalize(lightSI.vPosition - si.vPosition);
+        shadowRay = spawnShadowRay(si, lightSI.vPosition);
+        return l(lightSI, -wi);
+    }
+
+    F32 pdfLi(const SurfaceInteraction& si, const Float3& wi) override
+    {
+        return m_pShape->pdf(si, wi);
+    }
+
+    B32 getLightBounds(LightBounds& lightBounds) const override
+    {
+        F32 lMax = fmaxf(m_lEmit.x, fmaxf(m_lEmit.y, m_lEmit.z));
+        lightBounds.bounds = m_pShape->getWorldBounds();
+        lightBounds.phi = lMax * m_pShape->area() * (F32)RT_PI * (m_twoSided ? 2.f : 1.f);
+        lightBounds.cosThetaO = m_pShape->getNormalBounds(lightBounds.w);
+        // Lambertian emission falls off to nothing at the horizon.
+        lightBounds.cosThetaE = 0.f;
+        lightBounds.twoSided = m_twoSided;
+        return true;
+    }
+
+private:
+    Shape*  m_pShape;
+    Float3  m_lEmit;
+    B32     m_twoSided;
 };
-} // rt
\ No newline at end of file
+} // rt
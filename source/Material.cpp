@@ -3,6 +3,11 @@
 #include "Interaction.hpp"
 
 #include "math/CommonMath.hpp"
+#include "texture/TextureSampler.hpp"
+
+#if defined SIMD_ENABLE
+#include <immintrin.h>
+#endif
 
 namespace rt {
 
@@ -19,9 +24,39 @@ Float3 lambertDiffuse(const Float3& r)
     return r * RT_INV_PI;
 }
 
+void MatteMaterial::commit()
+{
+    m_f = lambertDiffuse(color);
+    m_committed = true;
+}
+
 Float3 MatteMaterial::distributionF(const Float3& wi, const Float3& wo)
 {
-    return lambertDiffuse(color);
+    return m_committed ? m_f : lambertDiffuse(color);
+}
+
+void MatteMaterial::distributionF(const BsdfBatch& batch)
+{
+    // Lambertian, the same everywhere.
+    Float3 f = m_committed ? m_f : lambertDiffuse(color);
+    for (U32 i = 0; i < batch.count; ++i)
+    {
+        batch.fR[i] = f.x;
+        batch.fG[i] = f.y;
+        batch.fB[i] = f.z;
+    }
+}
+
+void IMaterial::distributionF(const BsdfBatch& batch)
+{
+    for (U32 i = 0; i < batch.count; ++i)
+    {
+        Float3 f = distributionF(*batch.ppSi[i], Float3(batch.wiX[i], batch.wiY[i], batch.wiZ[i]), 
+                                 Float3(batch.woX[i], batch.woY[i], batch.woZ[i]));
+        batch.fR[i] = f.x;
+        batch.fG[i] = f.y;
+        batch.fB[i] = f.z;
+    }
 }
 
 F32 MicrofacetMaterial::roughnessToAlpha(F32 roughness)
@@ -54,6 +89,24 @@ F32 sin2Phi(const Float3& w)
     return sinPhi(w) * sinPhi(w);
 }
 
+// cos2Phi(w) + sin2Phi(w), sharing the sin2Theta(w) the caller already has. One for unit vectors,
+// but not for the unnormalized directions some lights hand out. With alphaX == alphaY this is all
+// d() and lambda() need of the azimuth.
+static F32 azimuth(const Float3& w, F32 sin2)
+{
+    if (sin2 == 0.f) return 1.f;
+    return fminf(w.x * w.x / sin2, 1.f) + fminf(w.y * w.y / sin2, 1.f);
+}
+
+// lambda() for an isotropic distribution, zero where tan theta is infinite.
+static F32 isotropicLambda(F32 alpha2, const Float3& w)
+{
+    F32 cos2 = cos2Theta(w);
+    if (cos2 == 0.f) return 0.f;
+    F32 sin2 = sin2Theta(w);
+    return (-1.f + sqrtf(1.f + azimuth(w, sin2) * alpha2 * sin2 / cos2)) / 2.f;
+}
+
 B32 sameHemisphere(const Float3& w, const Float3& wp)
 {
     return w.z * wp.z > 0.f;
@@ -114,7 +167,187 @@ F32 MicrofacetMaterial::d(F32 alphaX, F32 alphaY, const Float3& wh)
 
 Float3 MicrofacetMaterial::distributionF(const Float3& wi, const Float3& wo)
 {
-    if (wo.z == 0.f) return Float3();
+    return evaluate(wi, wo, getShadingRecord());
+}
+
+Float3 MicrofacetMaterial::getAlbedo(const SurfaceInteraction& si)
+{
+    if (!surfaceSampler || !albedo)
+        return color;
+    return color * Float3(surfaceSampler->sample(albedo, si.vTexCoord, Float2(si.dudx, si.dvdx), 
+                                                 Float2(si.dudy, si.dvdy)));
+}
+
+void MicrofacetMaterial::commit()
+{
+    m_record = bake(color, kD);
+    m_committed = true;
+}
+
+MicrofacetMaterial::ShadingRecord MicrofacetMaterial::bake(const Float3& albedoColor, F32 roughness)
+{
+    ShadingRecord record;
+    record.color = albedoColor;
+    record.alpha = roughnessToAlpha(roughness);
+    record.dNormalization = 1.f / (RT_PI * record.alpha * record.alpha);
+    record.etaEntering = etaI / etaT;
+    record.etaLeaving = etaT / etaI;
+    return record;
+}
+
+MicrofacetMaterial::ShadingRecord MicrofacetMaterial::getShadingRecord()
+{
+    return m_committed ? m_record : bake(color, kD);
+}
+
+MicrofacetMaterial::ShadingRecord MicrofacetMaterial::getShadingRecord(const SurfaceInteraction& si)
+{
+    ShadingRecord record = getShadingRecord();
+    if (surfaceSampler)
+    {
+        Float2 uv = si.vTexCoord;
+        Float2 duvdx = Float2(si.dudx, si.dvdx);
+        Float2 duvdy = Float2(si.dudy, si.dvdy);
+        if (albedo)
+            record.color = record.color * Float3(surfaceSampler->sample(albedo, uv, duvdx, duvdy));
+        if (metallicRoughness)
+        {
+            // Only the roughness dependent terms are baked again.
+            F32 roughness = kD * surfaceSampler->sample(metallicRoughness, uv, duvdx, duvdy).y;
+            record.alpha = roughnessToAlpha(roughness);
+            record.dNormalization = 1.f / (RT_PI * record.alpha * record.alpha);
+        }
+    }
+    return record;
+}
+
+Float3 MicrofacetMaterial::distributionF(const SurfaceInteraction& si, const Float3& wi, const Float3& wo)
+{
+    return evaluate(wi, wo, getShadingRecord(si));
+}
+
+#if defined SIMD_ENABLE
+static __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// azimuth() of four directions.
+static __m128 azimuth4(__m128 x, __m128 y, __m128 sin2)
+{
+    __m128 invSin2 = _mm_div_ps(_mm_set1_ps(1.f), sin2);
+    __m128 sum = _mm_add_ps(_mm_min_ps(_mm_mul_ps(_mm_mul_ps(x, x), invSin2), _mm_set1_ps(1.f)),
+                            _mm_min_ps(_mm_mul_ps(_mm_mul_ps(y, y), invSin2), _mm_set1_ps(1.f)));
+    return select(_mm_cmpeq_ps(sin2, _mm_setzero_ps()), _mm_set1_ps(1.f), sum);
+}
+
+// (sqrt(1 + alpha^2 tan^2 theta) - 1) / 2, lanes with cos theta of 0 are masked by the caller.
+static __m128 lambda4(__m128 alpha2, __m128 x, __m128 y, __m128 z)
+{
+    __m128 cos2 = _mm_mul_ps(z, z);
+    __m128 sin2 = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.f), cos2));
+    __m128 tan2 = _mm_div_ps(sin2, cos2);
+    __m128 root = _mm_sqrt_ps(_mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_mul_ps(azimuth4(x, y, sin2), alpha2), tan2)));
+    return _mm_mul_ps(_mm_sub_ps(root, _mm_set1_ps(1.f)), _mm_set1_ps(0.5f));
+}
+
+// Four points of evaluate() at once, for the isotropic distribution it always uses.
+static void evaluate4(const BsdfBatch& batch, U32 i, __m128 alpha, __m128 dNormalization, F32 etaEntering,
+                      F32 etaLeaving, __m128 r, __m128 g, __m128 b)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 wix = _mm_loadu_ps(batch.wiX + i), wiy = _mm_loadu_ps(batch.wiY + i), wiz = _mm_loadu_ps(batch.wiZ + i);
+    __m128 wox = _mm_loadu_ps(batch.woX + i), woy = _mm_loadu_ps(batch.woY + i), woz = _mm_loadu_ps(batch.woZ + i);
+    __m128 cosThetaI = _mm_and_ps(wiz, absMask);
+    __m128 cosThetaO = _mm_and_ps(woz, absMask);
+
+    // Half vector, and the same early outs as evaluate() as a lane mask.
+    __m128 whx = _mm_add_ps(wix, wox), why = _mm_add_ps(wiy, woy), whz = _mm_add_ps(wiz, woz);
+    __m128 whLength2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(whx, whx), _mm_mul_ps(why, why)), _mm_mul_ps(whz, whz));
+    __m128 valid = _mm_and_ps(_mm_cmpneq_ps(cosThetaI, zero), _mm_cmpneq_ps(cosThetaO, zero));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(whLength2, zero));
+    __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(whLength2));
+    whx = _mm_mul_ps(whx, invLength);
+    why = _mm_mul_ps(why, invLength);
+    whz = _mm_mul_ps(whz, invLength);
+
+    // Fresnel with the relative index of refraction, which inverts when leaving the surface.
+    __m128 cosI = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wix, whx), _mm_mul_ps(wiy, why)), _mm_mul_ps(wiz, whz));
+    cosI = _mm_min_ps(_mm_max_ps(cosI, _mm_set1_ps(-1.f)), one);
+    __m128 eta = select(_mm_cmpgt_ps(cosI, zero), _mm_set1_ps(etaEntering), _mm_set1_ps(etaLeaving));
+    cosI = _mm_and_ps(cosI, absMask);
+    __m128 sinI = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(cosI, cosI))));
+    __m128 sinT = _mm_mul_ps(eta, sinI);
+    __m128 cosT = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(sinT, sinT))));
+    __m128 parl = _mm_div_ps(_mm_sub_ps(cosI, _mm_mul_ps(eta, cosT)), _mm_add_ps(cosI, _mm_mul_ps(eta, cosT)));
+    __m128 perp = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(eta, cosI), cosT), _mm_add_ps(_mm_mul_ps(eta, cosI), cosT));
+    __m128 fresnel = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(parl, parl), _mm_mul_ps(perp, perp)), _mm_set1_ps(0.5f));
+    fresnel = select(_mm_cmpge_ps(sinT, one), one, fresnel);
+
+    // d(), zero where the half vector lies in the surface and tan theta is infinite.
+    __m128 alpha2 = _mm_mul_ps(alpha, alpha);
+    __m128 cos2H = _mm_mul_ps(whz, whz);
+    valid = _mm_and_ps(valid, _mm_cmpneq_ps(cos2H, zero));
+    __m128 sin2H = _mm_max_ps(zero, _mm_sub_ps(one, cos2H));
+    __m128 e = _mm_div_ps(_mm_mul_ps(azimuth4(whx, why, sin2H), _mm_div_ps(sin2H, cos2H)), alpha2);
+    __m128 onePlusE = _mm_add_ps(one, e);
+    __m128 dTerm = _mm_div_ps(dNormalization, _mm_mul_ps(_mm_mul_ps(cos2H, cos2H), _mm_mul_ps(onePlusE, onePlusE)));
+
+    // g()
+    __m128 gTerm = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(one, lambda4(alpha2, wox, woy, woz)),
+                                               lambda4(alpha2, wix, wiy, wiz)));
+
+    __m128 scale = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(dTerm, gTerm), fresnel),
+                              _mm_mul_ps(_mm_set1_ps(4.f), _mm_mul_ps(cosThetaI, cosThetaO)));
+    scale = _mm_and_ps(scale, valid);
+    _mm_storeu_ps(batch.fR + i, _mm_mul_ps(r, scale));
+    _mm_storeu_ps(batch.fG + i, _mm_mul_ps(g, scale));
+    _mm_storeu_ps(batch.fB + i, _mm_mul_ps(b, scale));
+}
+#endif
+
+void MicrofacetMaterial::distributionF(const BsdfBatch& batch)
+{
+    U32 i = 0;
+#if defined SIMD_ENABLE
+    // Untextured materials use the same record for the whole batch.
+    B32 textured = surfaceSampler && (albedo || metallicRoughness);
+    ShadingRecord shared = getShadingRecord();
+    for (; i + 4 <= batch.count; i += 4)
+    {
+        alignas(16) F32 alphas[4], dNormalizations[4], r[4], g[4], b[4];
+        for (U32 k = 0; k < 4; ++k)
+        {
+            ShadingRecord record = textured ? getShadingRecord(*batch.ppSi[i + k]) : shared;
+            alphas[k] = record.alpha;
+            dNormalizations[k] = record.dNormalization;
+            r[k] = record.color.x;
+            g[k] = record.color.y;
+            b[k] = record.color.z;
+        }
+        evaluate4(batch, i, _mm_load_ps(alphas), _mm_load_ps(dNormalizations), shared.etaEntering,
+                  shared.etaLeaving, _mm_load_ps(r), _mm_load_ps(g), _mm_load_ps(b));
+    }
+#endif
+    for (; i < batch.count; ++i)
+    {
+        Float3 f = distributionF(*batch.ppSi[i], Float3(batch.wiX[i], batch.wiY[i], batch.wiZ[i]), 
+                                 Float3(batch.woX[i], batch.woY[i], batch.woZ[i]));
+        batch.fR[i] = f.x;
+        batch.fG[i] = f.y;
+        batch.fB[i] = f.z;
+    }
+}
+
+Float3 MicrofacetMaterial::evaluate(const Float3& wi, const Float3& wo, const Float3& albedoColor, F32 roughness)
+{
+    return evaluate(wi, wo, bake(albedoColor, roughness));
+}
+
+Float3 MicrofacetMaterial::evaluate(const Float3& wi, const Float3& wo, const ShadingRecord& record) const
+{
     // We must transfer our rays to local space, in order to use microfacet equations.
     F32 cosThetaO = absCosTheta(wo);
     F32 cosThetaI = absCosTheta(wi);
@@ -122,10 +355,31 @@ Float3 MicrofacetMaterial::distributionF(const Float3& wi, const Float3& wo)
     if (cosThetaI == 0.f || cosThetaO == 0.f) return Float3();
     if (wh.x == 0.f && wh.y == 0.f && wh.z == 0.f) return Float3();
     wh = normalize(wh);
-    Float3 fresnel = fresnelDielectric(dot(wi, wh), 0.5f, 0.1f);
-    F32 alphaX = roughnessToAlpha(kD);      
-    F32 alphaY = roughnessToAlpha(kD);
-    return color * (d(alphaX, alphaY, wh) * g(wo, wi, alphaX, alphaY) * fresnel / (4 * cosThetaI * cosThetaO));
+
+    // fresnelDielectric() with the indices folded into one ratio, total internal reflection past 1.
+    F32 cosI = RT_CLAMP(dot(wi, wh), -1.f, 1.f);
+    F32 eta = cosI > 0.f ? record.etaEntering : record.etaLeaving;
+    cosI = fabsf(cosI);
+    F32 sinT = eta * sqrtf(fmaxf(0.f, 1.f - cosI * cosI));
+    F32 fresnel = 1.f;
+    if (sinT < 1.f)
+    {
+        F32 cosT = sqrtf(fmaxf(0.f, 1.f - sinT * sinT));
+        F32 parl = (cosI - eta * cosT) / (cosI + eta * cosT);
+        F32 perp = (eta * cosI - cosT) / (eta * cosI + cosT);
+        fresnel = (parl * parl + perp * perp) / 2.f;
+    }
+
+    // d(), zero where the half vector lies in the surface and tan theta is infinite.
+    F32 cos2H = cos2Theta(wh);
+    if (cos2H == 0.f) return Float3();
+    F32 sin2H = sin2Theta(wh);
+    F32 alpha2 = record.alpha * record.alpha;
+    F32 e = azimuth(wh, sin2H) * sin2H / (cos2H * alpha2);
+    F32 dTerm = record.dNormalization / (cos2H * cos2H * (1.f + e) * (1.f + e));
+
+    F32 gTerm = 1.f / (1.f + isotropicLambda(alpha2, wo) + isotropicLambda(alpha2, wi));
+    return record.color * (dTerm * gTerm * fresnel / (4 * cosThetaI * cosThetaO));
 }
 
 Float3 worldToLightLocal(const Float3& v, const SurfaceInteraction& si)
@@ -1,5 +1,5 @@
 // Raytracer.
-
+#pragma once
 
 #include "common/Types.hpp"
 #include "math/Float.hpp"
@@ -29,18 +29,63 @@ Float3  lightLocalToWorld(const Float3& v, const SurfaceInteraction& si);
 // hemisphere, then the sampling probability is 0.
 B32     sameHemisphere(const Float3& w, const Float3& wp);
 
+// Many shading points that share a material, to be evaluated in one call. Every component
+// is its own array so materials can load several points at once. Directions are in shading space.
+struct BsdfBatch
+{
+    U32                                 count;
+    const SurfaceInteraction* const*    ppSi;
+    const F32*                          wiX;
+    const F32*                          wiY;
+    const F32*                          wiZ;
+    const F32*                          woX;
+    const F32*                          woY;
+    const F32*                          woZ;
+    F32*                                fR;
+    F32*                                fG;
+    F32*                                fB;
+};
+
 struct IMaterial
 {
     virtual ~IMaterial() { }
 
+    // Bake everything that doesn't depend on the directions into the material's shading record,
+    // so evaluating it is only the angle dependent math. The scene commits its materials before
+    // every render, materials used on their own should be committed by hand.
+    virtual void commit() { m_committed = true; }
+
+    // Mark the shading record stale after changing any parameter, it's baked again on the next
+    // commit. Until then evaluation works the parameters out every time. Not while rendering.
+    void invalidate() { m_committed = false; }
+
+    B32 isCommitted() const { return m_committed; }
+
     // Sample the distribution, but also be sure to convert wi and wo to 
     // shading space before passing to this function.
     virtual Float3 distributionF(const Float3& wi, const Float3& wo) = 0;
 
+    // Sample the distribution at a surface interaction, so textured materials can look up their 
+    // parameters at the interaction's texture coordinates. Defaults to the untextured distribution.
+    virtual Float3 distributionF(const SurfaceInteraction& /*si*/, const Float3& wi, const Float3& wo) 
+    { 
+        return distributionF(wi, wo); 
+    }
+
+    // Sample the distribution for a whole batch. Defaults to one point at a time, materials
+    // override it to share per material work and evaluate several points together.
+    virtual void distributionF(const BsdfBatch& batch);
+
     //
     virtual Float3 sampleDistributionF(const Float3& wo, Float3& wi, const Float2& u, F32& pdf);
 
     virtual Float3 sampleWh(const Float3& wo, const Float2& u) { return Float3(); }
+
+    // Base color of the surface at the interaction, without any lighting. 
+    virtual Float3 getAlbedo(const SurfaceInteraction& /*si*/) { return Float3(); }
+
+protected:
+    B32 m_committed = false;
 };
 
 // Custom materials can store multiple types of textures, which should 
@@ -73,8 +118,18 @@ private:
 struct MatteMaterial : public IMaterial
 {
     Float4              color;
+
+    void commit() override;
+
     // Sample the distribution function.
     Float3 distributionF(const Float3& wi, const Float3& wo) override;
+    void distributionF(const BsdfBatch& batch) override;
+
+    Float3 getAlbedo(const SurfaceInteraction& /*si*/) override { return color; }
+
+private:
+    // Lambertian reflectance, color / pi.
+    Float3              m_f;
 };
 
 
@@ -86,22 +141,59 @@ struct TrowbridgeReitzDistribution : public IMaterial
 struct MicrofacetMaterial : public TrowbridgeReitzDistribution
 {  
     Float3              color;
-    Texture*            albedo;
+    // Textures are optional, and only looked up when surfaceSampler is set.
+    Texture*            albedo              = nullptr;
     // Normal * 0.5 + 0.5 to obtain [0, 1] range.
-    Texture*            normal;
-    Texture*            metallicRoughness;
-    Texture*            ao;
-    TextureSampler*     surfaceSampler;
+    Texture*            normal              = nullptr;
+    // Roughness in green, metallic in blue, as in glTF.
+    Texture*            metallicRoughness   = nullptr;
+    Texture*            ao                  = nullptr;
+    TextureSampler*     surfaceSampler      = nullptr;
     // Roughness parameter [0.04, 1]
     F32                 kD;
     // Metallic parameter [0, 1]
     F32                 kS;
+    // Indices of refraction outside and inside the surface, for the Fresnel term.
+    F32                 etaI                = 0.5f;
+    F32                 etaT                = 0.1f;
+
+    // Direction independent terms of evaluate().
+    struct ShadingRecord
+    {
+        Float3          color;
+        F32             alpha;
+        // 1 / (pi alpha^2), the constant part of d().
+        F32             dNormalization;
+        // Relative index of refraction for light arriving from outside, and from inside.
+        F32             etaEntering;
+        F32             etaLeaving;
+    };
+
+    void commit() override;
 
     Float3 distributionF(const Float3& wi, const Float3& wo) override;
+    Float3 distributionF(const SurfaceInteraction& si, const Float3& wi, const Float3& wo) override;
+    // Untextured materials share one record over the batch, then four points at a time.
+    void distributionF(const BsdfBatch& batch) override;
+    Float3 getAlbedo(const SurfaceInteraction& si) override;
+
+    // The committed shading record, or a freshly baked one if the material changed since.
+    ShadingRecord getShadingRecord();
+    ShadingRecord bake(const Float3& albedoColor, F32 roughness);
+
+    // Evaluate the microfacet distribution for the given surface color and roughness.
+    Float3 evaluate(const Float3& wi, const Float3& wo, const Float3& albedoColor, F32 roughness);
+    Float3 evaluate(const Float3& wi, const Float3& wo, const ShadingRecord& record) const;
 
     F32 d(F32 alphaX, F32 alphaY, const Float3& wh);
     F32 g(const Float3& wo, const Float3& wi, F32 alphaX, F32 alphaY);
     F32 roughnessToAlpha(F32 roughness);
     F32 lambda(F32 alphaX, F32 alphaY, const Float3& w) const;
+
+private:
+    // The record at the interaction, with textures applied on top of the committed one.
+    ShadingRecord getShadingRecord(const SurfaceInteraction& si);
+
+    ShadingRecord       m_record;
 };
 } // rt
\ No newline at end of file
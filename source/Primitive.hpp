@@ -16,6 +16,7 @@
 
 namespace rt {
 
+struct AreaLight;
 
 // Shape structure.
 struct Shape 
@@ -24,18 +25,94 @@ struct Shape
     virtual Matrix44 getLocalToWorld() const { return m_localToWorld; }
     virtual Matrix44 getWorldToLocal() const { return m_worldToLocal; }
 
+    // Check for intersection of the ray, filling in only the time and parametric coordinates
+    // of the hit. This is all traversal needs, the rest waits for computeInteraction().
+    virtual B32 intersect(const Ray& ray, HitRecord& hit) const = 0;
+
+    // Fill the interaction table at a hit found by intersect() with the same ray.
+    virtual void computeInteraction(const Ray& ray, const HitRecord& hit, SurfaceInteraction& si) const = 0;
+
     // Check for intersection of the ray, and fill the interaction table
     // if such an intersection is made.
-    virtual B32 intersects(const Ray& ray, SurfaceInteraction& si) = 0;
+    B32 intersects(const Ray& ray, SurfaceInteraction& si) const
+    {
+        HitRecord hit;
+        if (!intersect(ray, hit))
+            return false;
+        computeInteraction(ray, hit, si);
+        si.time = hit.time;
+        return true;
+    }
 
     // Get the area of our shape.
     virtual F32 area() const { return 0.f; }
+
+    // World space bounds of the shape.
+    virtual Bounds3 getWorldBounds() const { return Bounds3(); }
+
+    // Bound the directions of the shape's surface normals, returns the cosine of the spread about w.
+    // Defaults to every direction.
+    virtual F32 getNormalBounds(Float3& w) const 
+    { 
+        w = Float3(0.f, 0.f, 1.f);
+        return -1.f;
+    }
     
     // Calculate the probability density function (PDF) for the shape.
-    // This is usually 1 / area. 
+    // This is usually 1 / area. Shapes without an area can not be sampled.
     virtual F32 pdf(const SurfaceInteraction& si) const
     {
-        return 1.f / area();
+        F32 a = area();
+        return (a > 0.f) ? 1.f / a : 0.f;
+    }
+
+    // Sample a point uniformly over the surface of the shape. Fills in the position and normal,
+    // and returns the density with respect to area in pdf.
+    virtual B32 sample(const Float2& /*u*/, SurfaceInteraction& /*si*/, F32& pdf) const
+    {
+        pdf = 0.f;
+        return false;
+    }
+
+    // Sample a point on the shape as seen from the reference interaction, returning the density
+    // with respect to solid angle in pdf. By default this converts an area sample, shapes that
+    // can do better (sampling only the visible part) override it.
+    virtual B32 sample(const SurfaceInteraction& ref, const Float2& u, SurfaceInteraction& si, F32& pdf) const
+    {
+        if (!sample(u, si, pdf) || pdf == 0.f)
+            return false;
+        Float3 wi = si.vPosition - ref.vPosition;
+        F32 dist2 = length2(wi);
+        if (dist2 == 0.f)
+        {
+            pdf = 0.f;
+            return false;
+        }
+        wi = wi / sqrtf(dist2);
+        // Convert from area measure to solid angle measure.
+        F32 cosThetaL = fabsf(dot(si.vNormal, -wi));
+        if (cosThetaL == 0.f)
+        {
+            pdf = 0.f;
+            return false;
+        }
+        pdf *= dist2 / cosThetaL;
+        return true;
+    }
+
+    // Density, with respect to solid angle, of sample() picking direction wi from the reference interaction.
+    virtual F32 pdf(const SurfaceInteraction& ref, const Float3& wi)
+    {
+        Ray ray(ref.vPosition, wi);
+        SurfaceInteraction isect = { };
+        isect.time = INFINITY;
+        if (!intersects(ray, isect))
+            return 0.f;
+        F32 cosThetaL = fabsf(dot(isect.vNormal, -wi));
+        F32 a = area();
+        if (cosThetaL == 0.f || a == 0.f)
+            return 0.f;
+        return length2(ref.vPosition - isect.vPosition) / (cosThetaL * a);
     }
 
 protected:
@@ -44,29 +121,54 @@ protected:
     Matrix44 m_worldToLocal;
 };
 
+// A shape in the scene, with the ids of its material and of itself. Aggregates walk arrays of
+// these, so it's kept to a pointer and two indices. Materials and area lights are looked up by
+// the scene, and bounds come from the shape.
 struct Primitive 
 {
-    B32 intersects(const Ray& ray, SurfaceInteraction& si)
+    Primitive(Shape* pShape, U32 id, U32 materialId)
+        : m_pShape(pShape)
+        , m_id(id)
+        , m_materialId(materialId) { }
+
+    B32 intersect(const Ray& ray, HitRecord& hit) const
     {
-        B32 intersect = m_pShape->intersects(ray, si); 
-        if (intersect)
-            si.pMaterial = m_pMaterial; 
-        return intersect;
+        if (!m_pShape->intersect(ray, hit))
+            return false;
+        hit.primitiveId = m_id;
+        return true;
     }
 
-    IMaterial* getMat() { return m_pMaterial; }
-    Shape* getShape() { return m_pShape; }
+    void computeInteraction(const Ray& ray, const HitRecord& hit, SurfaceInteraction& si) const
+    {
+        m_pShape->computeInteraction(ray, hit, si);
+        si.time = hit.time;
+        si.primitiveId = m_id;
+        si.materialId = m_materialId;
+    }
 
-    Bounds3& getLocalBounds() { return Bounds3(); }
-    Bounds3& getWorldBounds() { return Bounds3(); }
+    B32 intersects(const Ray& ray, SurfaceInteraction& si) const
+    {
+        HitRecord hit;
+        if (!intersect(ray, hit))
+            return false;
+        computeInteraction(ray, hit, si);
+        return true;
+    }
 
-    void setShape(Shape* pShape) { m_pShape = pShape; }
-    void setMat(IMaterial* pMat) { m_pMaterial = pMat; }
+    Shape* getShape() const { return m_pShape; }
+    Bounds3 getWorldBounds() const { return m_pShape->getWorldBounds(); }
+
+    // Index of the primitive in its scene.
+    U32 getId() const { return m_id; }
+    // Index of the material in its scene, with kEmissiveMaterialBit set for area lights.
+    U32 getMaterialId() const { return m_materialId; }
     
 private:
     Shape*      m_pShape;
-    IMaterial*  m_pMaterial;
-    Bounds3     m_localBounds;
-    Bounds3     m_worldBounds;
+    U32         m_id;
+    U32         m_materialId;
 };
+
+static_assert(sizeof(Primitive) <= 16, "Primitive should fit four to a cache line");
 } // rt
\ No newline at end of file
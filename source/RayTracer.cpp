@@ -4,9 +4,13 @@
 #include "Interaction.hpp"
 #include "Light.hpp"
 #include "Material.hpp"
+#include "common/Memory.hpp"
+#include "common/Stats.hpp"
 #include "common/Threading.hpp"
+#include "common/Trace.hpp"
 
 #include "framebuffer/Image.hpp"
+#include "framebuffer/ImageEXR.hpp"
 #include "framebuffer/RenderTarget.hpp"
 
 #include "scene/Camera.hpp"
@@ -14,6 +18,11 @@
 
 #include "math/CommonMath.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
 #define IMDEBUGGING 1
 #if IMDEBUGGING
     #include <iostream>
@@ -55,54 +64,483 @@ static Sample sample4[] {
     {-0.25, 0.25 }
 };
 
+// Offset from the pixel's center of one of its samples. Up to four use the fixed pattern,
+// past that the samples follow the R2 sequence, which covers the pixel evenly at any count.
+static Sample getPixelSample(U32 sample)
+{
+    if (sample < 4)
+        return sample4[sample];
+    F32 n = (F32)(sample - 4);
+    return { fmodf(0.5f + n * 0.7548776662f, 1.f) - 0.5f, fmodf(0.5f + n * 0.5698402910f, 1.f) - 0.5f };
+}
+
+// Write one tile of the HDR radiance to the EXR, straight from the radiance tiles.
+static B32 writeExrTile(ExrWriter& writer, const TiledBuffer& radiance, U32 tileX, U32 tileY)
+{
+    U32 tileSize = writer.getTileSize();
+    U32 x0 = tileX * tileSize;
+    U32 y0 = tileY * tileSize;
+    U32 width = std::min(tileSize, radiance.getWidth() - x0);
+    U32 height = std::min(tileSize, radiance.getHeight() - y0);
+    std::vector<F32> pixels((U64)width * height * 4);
+    for (U32 y = 0; y < height; ++y)
+        for (U32 x = 0; x < width; ++x)
+            memcpy(&pixels[((U64)y * width + x) * 4], radiance.getPixel(x0 + x, y0 + y), sizeof(F32) * 4);
+    return writer.writeTile(tileX, tileY, pixels.data());
+}
+
 void Integrator::render(Scene* pScene)
 {
     checkFrameBuffer();
 
     checkCamera();
 
-    U64 frameWidth = m_framebuffer.rt0->getWidth();
-    U64 frameHeight = m_framebuffer.rt0->getHeight();
-
-    dispatch({[=] (const ThreadID& id) -> void {
-        Float3 accumColor;
-        U32 x = id.global.x;
-        U32 y = id.global.y;
-
-        if (x >= frameWidth || y >= frameHeight)
-            return;
-
-        for (U32 sample = 0; sample < m_samples; ++sample) {
-            F32 posX = (F32)x + sample4[sample].x;
-            F32 posY = (F32)y + sample4[sample].y;
-            Ray camRay = m_pCamera->generateRay(posX, posY);
-            Float3 sceneColor = li(camRay, pScene, 1);
-            // Tonemap. Since this is optional, we need to check if there is a function to use. Otherwise,
-            // just store the raw color.
-            Float3 rgb = (m_tonemap.evaluate) ? m_tonemap.evaluate(sceneColor) : sceneColor;
-            accumColor += rgb;
-        }
-
-        accumColor = accumColor / m_samples;
-        accumColor.x = RT_CLAMP(accumColor.x, 0.f, 1.f);
-        accumColor.y = RT_CLAMP(accumColor.y, 0.f, 1.f);
-        accumColor.z = RT_CLAMP(accumColor.z, 0.f, 1.f);
-        // Write to image.
-        m_framebuffer.rt0->storeColor(x, y, accumColor);
-    }, 64, 64, 1 }, m_framebuffer.rt0->getWidth() / 64 + 1, m_framebuffer.rt0->getHeight() / 64 + 1, 1);
-
-    //
-    m_output = createPNG("Test.png");
-    if (m_output)
-    {
-        m_output->saveBuffer(m_framebuffer.rt0->getBuffer(), 
+    U64 countersBefore[(U32)Stat::Count];
+    gatherStats(countersBefore);
+    TileCache::Stats tilesBefore = { };
+    if (m_pTileCache)
+        tilesBefore = m_pTileCache->getStats();
+    m_stats = FrameStats();
+    m_stats.width = m_framebuffer.rt0->getWidth();
+    m_stats.height = m_framebuffer.rt0->getHeight();
+    F64 phaseStart = getStatsTime();
+    RT_TRACE_SCOPE("render");
+
+    RenderTarget* pTarget = m_framebuffer.rt0;
+    B32 writeAOVs = false;
+    {
+        RT_TRACE_SCOPE("build");
+        pScene->buildLightSampler();
+        pScene->commitMaterials();
+
+        if (m_denoiserEnabled)
+        {
+            pTarget->enableAOV(AOV::Depth);
+            pTarget->enableAOV(AOV::Normal);
+            pTarget->enableAOV(AOV::Albedo);
+        }
+        for (U32 i = 0; i < (U32)AOV::Count; ++i)
+            if (m_requiredAOVs & (1u << i)) pTarget->enableAOV((AOV)i);
+        writeAOVs = pTarget->hasAOVs();
+        if (!pTarget->radianceTiles.isAllocated())
+            pTarget->enableTiling();
+    }
+    endPhase(StatPhase::Build, phaseStart);
+
+    // EXR output is the HDR radiance, written tile by tile as it's ready instead of from the
+    // tonemapped color. Without denoising or bloom each tile is final once it's traced, and
+    // goes to the file from the thread that traced it.
+    U32 tilesX = (pTarget->getWidth() + m_tileSize - 1) / m_tileSize;
+    U32 tilesY = (pTarget->getHeight() + m_tileSize - 1) / m_tileSize;
+    ExrWriter exr;
+    std::atomic<U32> exrFailures{ 0 };
+    B32 writeExr = !m_outputPath.empty() && m_outputFormat == ImageFormat::EXR;
+    B32 exrOpen = writeExr && exr.open(m_outputPath, pTarget->getWidth(), pTarget->getHeight(),
+                                       { "R", "G", "B", "A" }, ExrCompression::Zip, m_tileSize);
+    if (writeExr && !exrOpen)
+    {
+        fprintf(stderr, "can't write %s\n", m_outputPath.c_str());
+        ++m_outputFailures;
+    }
+    B32 streamExr = exrOpen && !m_denoiserEnabled && !m_bloomEnabled;
+
+    // Threads take one tile at a time, shading all of its pixels together.
+    {
+        RT_TRACE_SCOPE("trace");
+        parallelForEach(tilesX * tilesY, m_threadCount, [&] (U32 tile) -> void {
+            RT_TRACE_SCOPE("tile", "render", "x", (I64)(tile % tilesX), "y", (I64)(tile / tilesX));
+            renderTile(pScene, tile % tilesX, tile / tilesX, writeAOVs);
+            if (streamExr && !writeExrTile(exr, pTarget->radianceTiles, tile % tilesX, tile / tilesX))
+                ++exrFailures;
+        }, "trace worker");
+    }
+    endPhase(StatPhase::Trace, phaseStart);
+
+    // Post process the frame.
+    {
+        RT_TRACE_SCOPE("post");
+        if (m_denoiserEnabled)
+        {
+            RT_TRACE_SCOPE("denoise");
+            m_denoiser.apply(pTarget->radianceTiles, *pTarget->getAOV(AOV::Albedo), *pTarget->getAOV(AOV::Normal),
+                             *pTarget->getAOV(AOV::Depth));
+        }
+        if (m_bloomEnabled)
+        {
+            RT_TRACE_SCOPE("bloom");
+            m_bloom.apply(pTarget->radianceTiles);
+        }
+        {
+            RT_TRACE_SCOPE("tonemap");
+            m_tonemapper.apply(pTarget->radianceTiles, pTarget->colorTiles);
+        }
+        RT_TRACE_SCOPE("resolve");
+        pTarget->resolve();
+    }
+    endPhase(StatPhase::Post, phaseStart);
+
+    // Hand the frame off to be encoded in the background, the next one can start right away.
+    // Only EXR output is finished here, its tiles are encoded in parallel.
+    {
+        RT_TRACE_SCOPE("write");
+        if (exrOpen)
+        {
+            if (!streamExr)
+            {
+                parallelForEach(tilesX * tilesY, m_threadCount, [&] (U32 tile) -> void {
+                    if (!writeExrTile(exr, pTarget->radianceTiles, tile % tilesX, tile / tilesX))
+                        ++exrFailures;
+                }, "exr writer");
+            }
+            if (!exr.close() || exrFailures > 0)
+            {
+                fprintf(stderr, "can't write %s\n", m_outputPath.c_str());
+                ++m_outputFailures;
+            }
+        }
+        else if (!m_outputPath.empty() && !writeExr)
+        {
+            m_writer.submit(m_outputPath, m_outputFormat, m_framebuffer.rt0->getBuffer(),
                             m_framebuffer.rt0->getWidth(), m_framebuffer.rt0->getHeight(), 3);
+        }
+        if (writeAOVs && !m_aovOutputPath.empty())
+        {
+            std::vector<const RenderPlane*> planes;
+            for (U32 i = 0; i < (U32)AOV::Count; ++i)
+                if (pTarget->getAOV((AOV)i)) planes.push_back(pTarget->getAOV((AOV)i));
+            m_writer.submit(m_aovOutputPath, planes);
+        }
+    }
+    endPhase(StatPhase::Write, phaseStart);
+
+    // Every tile's thread has exited by now, so their counts are all in.
+    U64 countersAfter[(U32)Stat::Count];
+    gatherStats(countersAfter);
+    for (U32 i = 0; i < (U32)Stat::Count; ++i)
+        m_stats.counters[i] = countersAfter[i] - countersBefore[i];
+    if (m_pTileCache)
+    {
+        TileCache::Stats tilesAfter = m_pTileCache->getStats();
+        m_stats.tileHits = tilesAfter.hits - tilesBefore.hits;
+        m_stats.tileMisses = tilesAfter.misses - tilesBefore.misses;
+        m_stats.tileEvictions = tilesAfter.evictions - tilesBefore.evictions;
+        m_stats.tileBytesResident = tilesAfter.bytesResident;
+    }
+}
+
+void Integrator::setTileSize(U32 tileSize)
+{
+    // Multiples of the target's tiles round to the nearest one. Its divisors are powers of two,
+    // the largest one that fits is taken.
+    const U32 kMinTileSize = (U32)(kCacheLineSize / (sizeof(F32) * 4));
+    if (tileSize >= TiledBuffer::kTileSize)
+    {
+        m_tileSize = (tileSize + TiledBuffer::kTileSize / 2) / TiledBuffer::kTileSize * TiledBuffer::kTileSize;
+        return;
+    }
+    m_tileSize = kMinTileSize;
+    while (m_tileSize * 2 <= tileSize)
+        m_tileSize *= 2;
+}
+
+void Integrator::endPhase(StatPhase phase, F64& phaseStart)
+{
+    F64 now = getStatsTime();
+    m_stats.phaseSeconds[(U32)phase] += now - phaseStart;
+    phaseStart = now;
+}
+
+// A camera sample on its way through sorted shading.
+struct ShadingPoint
+{
+    Ray                 ray;
+    SurfaceInteraction  si;
+    Float3              radiance;
+    SampleAOVs          aovs;
+};
+
+// A light sample taken at a shading point, waiting on its BSDF value and shadow ray.
+struct DirectSample
+{
+    U32     point;
+    Light*  light;
+    Float3  wi;
+    // Incident radiance, already divided by its density and weighted for how the light was picked.
+    Float3  li;
+    Ray     shadowRay;
+};
+
+// Per tile state, reused by every sample pass.
+struct ShadingBatch
+{
+    std::vector<ShadingPoint>               points;
+    std::vector<Random>                     rngs;
+    std::vector<U32>                        hits;
+    std::vector<DirectSample>               directSamples;
+    std::vector<const SurfaceInteraction*>  interactions;
+    // Shading space wi and wo, then f, one array per component.
+    std::vector<F32>                        components;
+};
+
+void Integrator::renderTile(Scene* pScene, U32 tileX, U32 tileY, B32 writeAOVs)
+{
+    RenderTarget* pTarget = m_framebuffer.rt0;
+    U32 frameWidth = pTarget->getWidth();
+    U32 x0 = tileX * m_tileSize;
+    U32 y0 = tileY * m_tileSize;
+    U32 width = std::min(m_tileSize, frameWidth - x0);
+    U32 height = std::min(m_tileSize, pTarget->getHeight() - y0);
+    U32 count = width * height;
+
+    ShadingBatch batch;
+    batch.points.resize(count);
+    batch.rngs.resize(count);
+    std::vector<Float3> accumColor(count);
+    // Depth keeps the nearest sample, the id the first, and everything else is averaged.
+    std::vector<SampleAOVs> pixelAovs(count, { INFINITY, Float3(), Float3(), ~0u, Float3(), Float3(), 0.f });
+
+    // Every pixel gets its own random sequence, offset by the seed.
+    for (U32 i = 0; i < count; ++i)
+        batch.rngs[i] = Random(U64(y0 + i / width) * frameWidth + U64(x0 + i % width), Random::kDefaultSeed + m_seed);
+
+    for (U32 sample = 0; sample < m_samples; ++sample) 
+    {
+        Sample offset = getPixelSample(sample);
+        for (U32 i = 0; i < count; ++i)
+        {
+            F32 posX = (F32)(x0 + i % width) + offset.x;
+            F32 posY = (F32)(y0 + i / width) + offset.y;
+            batch.points[i].ray = m_pCamera->generateRay(posX, posY);
+            // Each sample only covers its share of the pixel.
+            batch.points[i].ray.scaleDifferentials(1.f / sqrtf((F32)m_samples));
+        }
+        RT_STAT_ADD(Stat::CameraRays, count);
+
+        if (m_sortedShading)
+        {
+            shadeSorted(batch, count, pScene, writeAOVs);
+        }
+        else
+        {
+            for (U32 i = 0; i < count; ++i)
+            {
+                ShadingPoint& point = batch.points[i];
+                point.radiance = li(point.ray, pScene, batch.rngs[i], 1, writeAOVs ? &point.aovs : nullptr);
+            }
+        }
+
+        for (U32 i = 0; i < count; ++i)
+        {
+            const SampleAOVs& sampleAovs = batch.points[i].aovs;
+            if (writeAOVs)
+            {
+                pixelAovs[i].depth = fminf(pixelAovs[i].depth, sampleAovs.depth);
+                pixelAovs[i].normal += sampleAovs.normal;
+                pixelAovs[i].albedo += sampleAovs.albedo;
+                if (sample == 0)
+                    pixelAovs[i].primitiveId = sampleAovs.primitiveId;
+                pixelAovs[i].direct += sampleAovs.direct;
+                pixelAovs[i].indirect += sampleAovs.indirect;
+                pixelAovs[i].cost += sampleAovs.cost;
+            }
+            accumColor[i] += batch.points[i].radiance;
+        }
+    }
+
+    for (U32 i = 0; i < count; ++i)
+    {
+        U32 x = x0 + i % width;
+        U32 y = y0 + i / width;
+        // Keep the radiance, it's tonemapped once the whole frame is done.
+        pTarget->storeRadiance(x, y, accumColor[i] / m_samples);
+
+        if (writeAOVs)
+        {
+            F32 invSamples = 1.f / (F32)m_samples;
+            Float3 normal = pixelAovs[i].normal * invSamples;
+            Float3 albedo = pixelAovs[i].albedo * invSamples;
+            Float3 direct = pixelAovs[i].direct * invSamples;
+            Float3 indirect = pixelAovs[i].indirect * invSamples;
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Depth))
+                pPlane->store(x, y, &pixelAovs[i].depth);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Normal))
+                pPlane->store(x, y, &normal.x);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Albedo))
+                pPlane->store(x, y, &albedo.x);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::PrimitiveId))
+                pPlane->store(x, y, pixelAovs[i].primitiveId);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Direct))
+                pPlane->store(x, y, &direct.x);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Indirect))
+                pPlane->store(x, y, &indirect.x);
+            if (RenderPlane* pPlane = pTarget->getAOV(AOV::Cost))
+            {
+                F32 cost = pixelAovs[i].cost * invSamples;
+                pPlane->store(x, y, &cost);
+            }
+        }
+    }
+}
+
+// Take the light's samples at the point, the first half of estimateDirect().
+static void sampleDirect(Light* light, U32 point, const SurfaceInteraction& si, Random& rng, F32 weight,
+                         std::vector<DirectSample>& samples)
+{
+    U32 nSamples = light->getSampleCount();
+    for (U32 sample = 0; sample < nSamples; ++sample)
+    {
+        DirectSample direct;
+        F32 pdf = 0.f;
+        Float3 li = light->sampleLi(si, rng.nextFloat2(), direct.wi, pdf, direct.shadowRay);
+        if (pdf == 0.f || isBlack(li))
+            continue;
+        direct.point = point;
+        direct.light = light;
+        direct.li = li * (weight / (pdf * (F32)nSamples));
+        samples.push_back(direct);
+    }
+}
+
+void Integrator::shadeSorted(ShadingBatch& batch, U32 count, Scene* pScene, B32 writeAOVs)
+{
+    // Camera rays, the same depth render() passes to li().
+    const U32 depth = 1;
+    std::vector<Light*>& lights = pScene->getLights();
+
+    // Trace every camera ray first. Misses are done right away.
+    batch.hits.clear();
+    for (U32 i = 0; i < count; ++i)
+    {
+        ShadingPoint& point = batch.points[i];
+        point.si = { };
+        point.si.time = INFINITY;
+        point.radiance = Float3();
+        if (pScene->intersects(point.ray, point.si))
+        {
+            point.si.computeDifferentials(point.ray);
+            batch.hits.push_back(i);
+            continue;
+        }
+        // Escaped the scene, pick up the environment.
+        std::vector<Light*>& infiniteLights = pScene->getInfiniteLights();
+        for (U32 l = 0; l < infiniteLights.size(); ++l)
+            point.radiance += infiniteLights[l]->le(point.ray);
+        if (writeAOVs)
+            point.aovs = { INFINITY, Float3(), Float3(), ~0u, point.radiance, Float3(), 0.f };
+    }
+
+    // Group the hits by material, pixels stay in order within a group.
+    std::stable_sort(batch.hits.begin(), batch.hits.end(), [&] (U32 a, U32 b) -> bool {
+        return batch.points[a].si.getMaterialIndex() < batch.points[b].si.getMaterialIndex();
+    });
+
+    // Sample the lights at every hit in that order, so the samples come out grouped too. Each 
+    // pixel draws from its random sequence in the same order as li() would.
+    batch.directSamples.clear();
+    for (U32 index : batch.hits)
+    {
+        ShadingPoint& point = batch.points[index];
+        Random& rng = batch.rngs[index];
+        if (AreaLight* pAreaLight = pScene->getAreaLight(point.si))
+            point.radiance += pAreaLight->l(point.si, point.si.wo);
+        if (m_lightSamples == 0)
+        {
+            for (U32 i = 0; i < lights.size(); ++i)
+                sampleDirect(lights[i], index, point.si, rng, 1.f, batch.directSamples);
+        }
+        else
+        {
+            const LightBVH& lightSampler = pScene->getLightSampler();
+            for (U32 i = 0; i < m_lightSamples; ++i)
+            {
+                F32 pmf = 0.f;
+                Light* light = lightSampler.sample(point.si.vPosition, point.si.vNormal, rng.nextF32(), pmf);
+                if (!light || pmf == 0.f)
+                    continue;
+                sampleDirect(light, index, point.si, rng, 1.f / (pmf * m_lightSamples), batch.directSamples);
+            }
+        }
+    }
+
+    // Evaluate the BSDFs, one call per run of samples sharing a material.
+    U32 n = (U32)batch.directSamples.size();
+    batch.interactions.resize(n);
+    batch.components.resize((U64)n * 9);
+    F32* pComponents[9];
+    for (U32 c = 0; c < 9; ++c)
+        pComponents[c] = batch.components.data() + (U64)c * n;
+    for (U32 i = 0; i < n; ++i)
+    {
+        const DirectSample& direct = batch.directSamples[i];
+        const SurfaceInteraction& si = batch.points[direct.point].si;
+        Float3 wis = worldToLightLocal(direct.wi, si);
+        Float3 wos = worldToLightLocal(si.wo, si);
+        batch.interactions[i] = &si;
+        for (U32 c = 0; c < 3; ++c)
+        {
+            pComponents[c][i] = wis[c];
+            pComponents[3 + c][i] = wos[c];
+        }
+    }
+    for (U32 begin = 0, end = 0; begin < n; begin = end)
+    {
+        U32 materialIndex = batch.interactions[begin]->getMaterialIndex();
+        while (end < n && batch.interactions[end]->getMaterialIndex() == materialIndex)
+            ++end;
+        IMaterial* pMaterial = pScene->getMaterial(*batch.interactions[begin]);
+        BsdfBatch bsdf = { end - begin, &batch.interactions[begin], 
+                           pComponents[0] + begin, pComponents[1] + begin, pComponents[2] + begin,
+                           pComponents[3] + begin, pComponents[4] + begin, pComponents[5] + begin,
+                           pComponents[6] + begin, pComponents[7] + begin, pComponents[8] + begin };
+        RT_STAT_ADD(Stat::ShadingCalls, end - begin);
+        if (pMaterial)
+        {
+            pMaterial->distributionF(bsdf);
+            continue;
+        }
+        for (U32 c = 6; c < 9; ++c)
+            std::fill(pComponents[c] + begin, pComponents[c] + end, 0.f);
+    }
+
+    // Shadow rays last, only for the samples that still contribute.
+    for (U32 i = 0; i < n; ++i)
+    {
+        const DirectSample& direct = batch.directSamples[i];
+        ShadingPoint& point = batch.points[direct.point];
+        Float3 f(pComponents[6][i], pComponents[7][i], pComponents[8][i]);
+        F32 kD = dot(direct.wi, point.si.vNormal);
+        if (isBlack(f) || kD <= 0.f)
+            continue;
+        if (direct.light->isShadowing() && pScene->occluded(direct.shadowRay))
+            continue;
+        point.radiance += f * direct.li * kD;
+    }
+
+    // Scattering off specular surfaces is traced one point at a time.
+    for (U32 index : batch.hits)
+    {
+        ShadingPoint& point = batch.points[index];
+        Float3 indirect;
+        if (depth <= m_maxDepth)
+        {
+            indirect += specularReflect(point.ray, pScene, point.si, batch.rngs[index], depth + 1);
+            indirect += specularTransmit(point.ray, pScene, point.si, batch.rngs[index], depth + 1);
+        }
+        if (writeAOVs)
+        {
+            point.aovs.depth = length(point.si.vPosition - point.ray.o);
+            point.aovs.normal = point.si.vNormal;
+            IMaterial* pMaterial = pScene->getMaterial(point.si);
+            point.aovs.albedo = pMaterial ? pMaterial->getAlbedo(point.si) : Float3();
+            point.aovs.primitiveId = point.si.primitiveId;
+            point.aovs.direct = point.radiance;
+            point.aovs.indirect = indirect;
+        }
+        point.radiance += indirect;
     }
-    destroyImage(m_output);
-    m_output = nullptr;
 }
 
-Float3 Integrator::li(Ray& ray, Scene* pScene, I32 depth)
+Float3 Integrator::li(Ray& ray, Scene* pScene, Random& rng, I32 depth, SampleAOVs* pAovs)
 {
     // Calculate radiance along the camera ray.
     Float3 radiance = Float3(0.0f, 0.0f, 0.0f);
@@ -114,54 +552,114 @@ Float3 Integrator::li(Ray& ray, Scene* pScene, I32 depth)
  
     if (pScene->intersects(ray, si))
     {
+        si.computeDifferentials(ray);
+
         //radiance += si.pMaterial->color;
-        for (U32 i = 0; i < lights.size(); ++i)
-        {
-            Light* light = lights[i];
-            Float3 wi = light->getLightDirection();
-            Float3 li = light->sampleLi(si, wi);
-            Float3 wo = si.wo; // Outgoing direction, usually represents the eye
-            // Obtain the local space for the bsdf.
-            Float3 wis = worldToLightLocal(wi, si);
-            Float3 wos = worldToLightLocal(wo, si);
-            Float3 f = si.pMaterial->distributionF(wis, wos);
-            
-            F32 shadow = 1.f;
-            if (light->isShadowing())
+        // Emission, if we have hit a light.
+        if (AreaLight* pAreaLight = pScene->getAreaLight(si))
+            radiance += pAreaLight->l(si, si.wo);
+
+        if (m_lightSamples == 0)
+        {
+            // Brute force, every light in the scene contributes.
+            for (U32 i = 0; i < lights.size(); ++i)
+                radiance += estimateDirect(lights[i], pScene, si, rng);
+        }
+        else
+        {
+            // Pick a few lights by importance from the light hierarchy, and weigh each 
+            // by the probability of having chosen it. Cost no longer scales with light count.
+            const LightBVH& lightSampler = pScene->getLightSampler();
+            for (U32 i = 0; i < m_lightSamples; ++i)
             {
-                // Spawn shadow ray from point to direction of light source.
-                Ray shadowRay = light->emitShadowRay(si);
-                // check if shadow ray intersect an object in the scene.
-                // Actually a pretty shitty way to do it, especially because it will
-                // fail on glossy surfaces. Need to find another way.
-                SurfaceInteraction shadowSI = { };
-                if (pScene->intersects(shadowRay, shadowSI))
-                {
-                    // Determine the material, otherwise, assume it is opaque. No
-                    // radiance applied to this point.
-                    shadow = 0.f;
-                }
+                F32 pmf = 0.f;
+                Light* light = lightSampler.sample(si.vPosition, si.vNormal, rng.nextF32(), pmf);
+                if (!light || pmf == 0.f)
+                    continue;
+                radiance += estimateDirect(light, pScene, si, rng) / (pmf * m_lightSamples);
             }
-            // Light contribution factored by the BSDF distribution.
-            
-            F32 kD = dot(wi, si.vNormal);
-            if (!isBlack(f) && kD > 0.f) 
-                radiance += (f * li * kD) * shadow;
         }
 
         // Compute scattering, reflection and transmission.
-        if (depth <= m_maxDepth)
+        Float3 indirect;
+        if (depth <= (I32)m_maxDepth)
         {
-            radiance += specularReflect(ray, pScene, si, depth + 1);
-            radiance += specularTransmit(ray, pScene, si, depth + 1);
+            indirect += specularReflect(ray, pScene, si, rng, depth + 1);
+            indirect += specularTransmit(ray, pScene, si, rng, depth + 1);
         }
+
+        if (pAovs)
+        {
+            pAovs->depth = length(si.vPosition - ray.o);
+            pAovs->normal = si.vNormal;
+            IMaterial* pMaterial = pScene->getMaterial(si);
+            pAovs->albedo = pMaterial ? pMaterial->getAlbedo(si) : Float3();
+            pAovs->primitiveId = si.primitiveId;
+            pAovs->direct = radiance;
+            pAovs->indirect = indirect;
+        }
+        radiance += indirect;
+    }
+    else
+    {
+        // Escaped the scene, pick up the environment.
+        std::vector<Light*>& infiniteLights = pScene->getInfiniteLights();
+        for (U32 i = 0; i < infiniteLights.size(); ++i)
+            radiance += infiniteLights[i]->le(ray);
+
+        if (pAovs)
+            *pAovs = { INFINITY, Float3(), Float3(), ~0u, radiance, Float3(), 0.f };
     }
         
     return radiance;
 }
 
 
-Float3 Integrator::specularReflect(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, I32 depth)
+Float3 Integrator::estimateDirect(Light* light, Scene* pScene, const SurfaceInteraction& si, Random& rng)
+{
+    Float3 radiance;
+    Float3 wo = si.wo; // Outgoing direction, usually represents the eye
+    Float3 wos = worldToLightLocal(wo, si);
+    IMaterial* pMaterial = pScene->getMaterial(si);
+    // Area lights may ask for several samples, to soften their shadows with less noise.
+    U32 nSamples = light->getSampleCount();
+    for (U32 sample = 0; sample < nSamples; ++sample)
+    {
+        Float3 wi;
+        F32 pdf = 0.f;
+        Ray shadowRay;
+        Float3 li = light->sampleLi(si, rng.nextFloat2(), wi, pdf, shadowRay);
+        if (pdf == 0.f || isBlack(li))
+            continue;
+        // Obtain the local space for the bsdf.
+        Float3 wis = worldToLightLocal(wi, si);
+        Float3 f = pMaterial->distributionF(si, wis, wos);
+        RT_STAT_ADD(Stat::ShadingCalls, 1);
+
+        // Light contribution factored by the BSDF distribution.
+        F32 kD = dot(wi, si.vNormal);
+        if (isBlack(f) || kD <= 0.f) 
+            continue;
+
+        if (light->isShadowing())
+        {
+            // check if shadow ray intersect an object in the scene.
+            // Actually a pretty shitty way to do it, especially because it will
+            // fail on glossy surfaces. Need to find another way.
+            if (pScene->occluded(shadowRay))
+            {
+                // Determine the material, otherwise, assume it is opaque. No
+                // radiance applied to this point.
+                continue;
+            }
+        }
+        radiance += f * li * kD / pdf;
+    }
+    return radiance / (F32)nSamples;
+}
+
+
+Float3 Integrator::specularReflect(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, Random& rng, I32 depth)
 {
     Float3 woW = si.wo;
     Float3 wiW;
@@ -181,13 +679,25 @@ Float3 Integrator::specularReflect(const Ray& ray, Scene* pScene, const SurfaceI
         // the same surface.
         Float3 err = si.vNormal * 0.001f;
         Ray reflectR =  { si.vPosition + err, wiW };
-        return f * li(reflectR, pScene, depth + 1);
+        if (ray.hasDifferentials)
+        {
+            // Mirror the offset rays about the same normal, treating the surface as locally flat.
+            Float3 dwodx = -ray.rxDirection - woW;
+            Float3 dwody = -ray.ryDirection - woW;
+            reflectR.hasDifferentials = true;
+            reflectR.rxOrigin = reflectR.o + si.dpdx;
+            reflectR.ryOrigin = reflectR.o + si.dpdy;
+            reflectR.rxDirection = wiW - dwodx + 2.f * dot(dwodx, si.vNormal) * si.vNormal;
+            reflectR.ryDirection = wiW - dwody + 2.f * dot(dwody, si.vNormal) * si.vNormal;
+        }
+        RT_STAT_ADD(Stat::SecondaryRays, 1);
+        return f * li(reflectR, pScene, rng, depth + 1);
     }
         
     return f;
 }
 
-Float3 Integrator::specularTransmit(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, I32 depth)
+Float3 Integrator::specularTransmit(const Ray& /*ray*/, Scene* /*pScene*/, const SurfaceInteraction& /*si*/, Random& /*rng*/, I32 /*depth*/)
 {
     return Float3(0.f);
 }
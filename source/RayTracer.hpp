@@ -1,89 +1,213 @@
 // Raytracer.
 #pragma once
+#include "common/Stats.hpp"
 #include "common/Types.hpp"
 
 #include "scene/Camera.hpp"
 #include "scene/Scene.hpp"
+#include "texture/TileCache.hpp"
+
+#include "framebuffer/ImageWriter.hpp"
+#include "framebuffer/TiledBuffer.hpp"
+#include "postprocess/Bloom.hpp"
+#include "postprocess/Denoiser.hpp"
+#include "postprocess/Tonemapper.hpp"
 
 #include "math/Float.hpp"
+#include "math/Random.hpp"
 #include "math/Ray.hpp"
 #include <vector>
-#include <functional>
 
 namespace rt {
 
 struct Light;
 struct RenderTarget;
+struct ShadingBatch;
 struct SurfaceInteraction;
 
 class Image;
 class Scene;
 
-class Tonemapper
+// Output variables of a single camera sample, taken at its first hit.
+struct SampleAOVs
 {
- public:
-  typedef std::function<Float3(const Float3&)> EvaluateFun;
-  EvaluateFun evaluate;
+    F32     depth;
+    Float3  normal;
+    Float3  albedo;
+    U32     primitiveId;
+    Float3  direct;
+    Float3  indirect;
+    // Traversal cost of the camera ray, only set by integrators measuring it.
+    F32     cost;
 };
 
-static Float3 reinhardtToneMapEvaluate(const Float3& sceneReferredColor) 
-{
-  // Simple Reinhardt tonemap.
-  return sceneReferredColor / (1.0f + sceneReferredColor);
-}
-
 class Integrator 
 {
 public:
     Integrator()
-        : m_maxDepth(2)
+        : m_pCamera(nullptr)
+        , m_pTileCache(nullptr)
+        , m_maxDepth(2)
         , m_samples(1)
-        , m_output(nullptr)
+        , m_lightSamples(1)
+        , m_threadCount(0)
+        , m_tileSize(TiledBuffer::kTileSize)
+        , m_seed(0)
+        , m_outputPath("Test.png")
+        , m_outputFormat(ImageFormat::PNG)
+        , m_aovOutputPath("Test_aovs.exr")
+        , m_bloomEnabled(false)
+        , m_denoiserEnabled(false)
+        , m_sortedShading(true)
+        , m_requiredAOVs(0)
+        , m_outputFailures(0)
     {
         m_framebuffer.rt0 = nullptr;
     }
 
+    virtual ~Integrator() { }
+
     // Render the scene.
     //
     void render(Scene* pScene);
 
     // Calculate incidence radiance along the camera ray.
-    // This function handles the light contributions to this given ray.
-    Float3 li(Ray& ray, Scene* pScene, I32 depth = 0);
+    // This function handles the light contributions to this given ray. Camera rays
+    // can pass pAovs to also get the output variables of their first hit.
+    // Integrators deriving from this one override it to shade differently.
+    virtual Float3 li(Ray& ray, Scene* pScene, Random& rng, I32 depth = 0, SampleAOVs* pAovs = nullptr);
 
-    Float3 specularReflect(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, I32 depth);
-    Float3 specularTransmit(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, I32 depth);
+    // Direct lighting from a single light at the interaction, including its shadow rays.
+    Float3 estimateDirect(Light* light, Scene* pScene, const SurfaceInteraction& si, Random& rng);
+
+    Float3 specularReflect(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, Random& rng, I32 depth);
+    Float3 specularTransmit(const Ray& ray, Scene* pScene, const SurfaceInteraction& si, Random& rng, I32 depth);
 
     void setCamera(Camera* cam) {
         m_pCamera = cam;
     }
 
+    // Cache the scene's textures are sampled through, optional. Its traffic during a frame
+    // goes into the frame's stats.
+    void setTileCache(TileCache* pCache) { m_pTileCache = pCache; }
+
     void setRenderTarget(RenderTarget* rt) 
     {
         m_framebuffer.rt0 = rt;    
     }
 
-    void setTonemapFun(Tonemapper::EvaluateFun fun)
+    // Applied to the whole frame, after the samples of each pixel are averaged.
+    void setTonemapper(const Tonemapper& tonemapper) { m_tonemapper = tonemapper; }
+    Tonemapper& getTonemapper() { return m_tonemapper; }
+
+    // Bloom is added to the HDR radiance, before it's tonemapped. Off by default.
+    void setBloom(const Bloom& bloom) { m_bloom = bloom; m_bloomEnabled = true; }
+    void enableBloom(B32 enable) { m_bloomEnabled = enable; }
+    Bloom& getBloom() { return m_bloom; }
+
+    // Denoise the HDR radiance before any other post processing. Off by default. The depth,
+    // normal and albedo AOVs it's guided by are enabled on the render target when rendering.
+    void setDenoiser(const Denoiser& denoiser) { m_denoiser = denoiser; m_denoiserEnabled = true; }
+    void enableDenoiser(B32 enable) { m_denoiserEnabled = enable; }
+    Denoiser& getDenoiser() { return m_denoiser; }
+
+    // Where finished frames are written. An empty path skips writing.
+    void setOutput(const std::string& path, ImageFormat format)
     {
-        m_tonemap.evaluate = fun;
+        m_outputPath = path;
+        m_outputFormat = format;
+    }
+
+    // Same as above, with the format taken from the path's extension.
+    void setOutput(const std::string& path) { setOutput(path, getImageFormat(path)); }
+
+    // Where the render target's enabled AOVs are written, as layers of one EXR.
+    void setAOVOutput(const std::string& path) { m_aovOutputPath = path; }
+
+    // Wait for every frame rendered so far to be written out. False if any of them couldn't be.
+    B32 flushOutput()
+    {
+        B32 ok = m_writer.flush() && m_outputFailures == 0;
+        m_outputFailures = 0;
+        return ok;
     }
 
     void setSamples(U32 samples) { m_samples = samples > 0 ? samples : 1; }
 
+    // Bounces followed by reflection and refraction past the camera ray's hit.
+    void setMaxDepth(U32 maxDepth) { m_maxDepth = maxDepth; }
+
+    // Threads tracing the frame, 0 for one per hardware thread. Tiles are handed out to them
+    // as they finish the previous one.
+    void setThreadCount(U32 threadCount) { m_threadCount = threadCount; }
+
+    // Width and height in pixels of the squares the frame is traced in. Rounded to a size that
+    // divides, or is a multiple of, the render target's tile size, and covers at least a cache
+    // line of radiance, so threads never write to each other's cache lines.
+    void setTileSize(U32 tileSize);
+    U32 getTileSize() const { return m_tileSize; }
+
+    // Offsets every pixel's random sequence. The same seed renders the same image, whatever
+    // the thread count and tile size.
+    void setSeed(U64 seed) { m_seed = seed; }
+
+    // Number of lights picked from the scene's light hierarchy per shading point. 
+    // Set to 0 to evaluate every light in the scene instead.
+    void setLightSamples(U32 lightSamples) { m_lightSamples = lightSamples; }
+
+    // Trace a whole tile's camera rays before shading them, with the hits grouped by material
+    // so each material evaluates its BSDF over all of its hits in one call. On by default.
+    // This replaces li() for camera rays, so integrators overriding li() turn it off.
+    void setSortedShading(B32 sortedShading) { m_sortedShading = sortedShading; }
+
+    // Timings and counters of the last frame rendered. The counters stay zero unless built
+    // with STATS_ENABLE.
+    const FrameStats& getStats() const { return m_stats; }
+
+protected:
+    // Have render() enable the AOV on the render target, for integrators that write it.
+    void requireAOV(AOV aov) { m_requiredAOVs |= 1u << (U32)aov; }
+
 private:
 
+    void renderTile(Scene* pScene, U32 tileX, U32 tileY, B32 writeAOVs);
+
+    // Shade one sample of every pixel in the batch, the sorted equivalent of li() at depth 1.
+    void shadeSorted(ShadingBatch& batch, U32 count, Scene* pScene, B32 writeAOVs);
+
+    // Add the time since phaseStart to the phase, and restart it for the next one.
+    void endPhase(StatPhase phase, F64& phaseStart);
+
     void checkCamera();
     void checkFrameBuffer();
 
     Camera* m_pCamera;
+    TileCache* m_pTileCache;
 
     struct {
         RenderTarget* rt0;
     } m_framebuffer;
 
-    Image*              m_output;
     U32                 m_maxDepth;
     U32                 m_samples;
-    Tonemapper          m_tonemap;
+    U32                 m_lightSamples;
+    U32                 m_threadCount;
+    U32                 m_tileSize;
+    U64                 m_seed;
+    std::string         m_outputPath;
+    ImageFormat         m_outputFormat;
+    std::string         m_aovOutputPath;
+    Tonemapper          m_tonemapper;
+    Bloom               m_bloom;
+    B32                 m_bloomEnabled;
+    Denoiser            m_denoiser;
+    B32                 m_denoiserEnabled;
+    B32                 m_sortedShading;
+    U32                 m_requiredAOVs;
+    // EXR frames the integrator failed to write itself, the rest are the writer's to count.
+    U32                 m_outputFailures;
+    FrameStats          m_stats;
+    // Last, so it's destroyed first and finishes writing while the rest is still alive.
+    ImageWriter         m_writer;
 };
 } // rt
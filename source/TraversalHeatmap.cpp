@@ -0,0 +1,92 @@
+// Raytracer.
+#include "TraversalHeatmap.hpp"
+#include "Interaction.hpp"
+
+#include "common/Stats.hpp"
+#include "math/CommonMath.hpp"
+#include "scene/Scene.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+// Blue for cheap, through green and yellow, to red for expensive.
+static Float3 heatmapRamp(F32 t)
+{
+    static const Float3 kStops[] = {
+        Float3(0.05f, 0.05f, 0.35f),
+        Float3(0.0f, 0.45f, 1.0f),
+        Float3(0.1f, 0.9f, 0.3f),
+        Float3(1.0f, 0.85f, 0.0f),
+        Float3(0.9f, 0.05f, 0.05f)
+    };
+    static const U32 kSegments = sizeof(kStops) / sizeof(kStops[0]) - 1;
+    t = RT_CLAMP(t, 0.f, 1.f) * (F32)kSegments;
+    U32 segment = t < (F32)kSegments ? (U32)t : kSegments - 1;
+    F32 f = t - (F32)segment;
+    return kStops[segment] * (1.f - f) + kStops[segment + 1] * f;
+}
+
+#if defined STATS_ENABLE
+static U64 readCounter(HeatmapMetric metric)
+{
+    return getThreadStats().get(metric == HeatmapMetric::NodesVisited ? Stat::NodesVisited : Stat::PrimitiveTests);
+}
+#endif
+
+void TraversalHeatmapIntegrator::setMetric(HeatmapMetric metric)
+{
+#if !defined STATS_ENABLE
+    metric = HeatmapMetric::Nanoseconds;
+#endif
+    m_metric = metric;
+    switch (metric)
+    {
+    case HeatmapMetric::Nanoseconds:
+        m_maxCost = 20000.f;
+        break;
+    case HeatmapMetric::PrimitiveTests:
+        m_maxCost = 1024.f;
+        break;
+    case HeatmapMetric::NodesVisited:
+        m_maxCost = 256.f;
+        break;
+    }
+}
+
+Float3 TraversalHeatmapIntegrator::li(Ray& ray, Scene* pScene, Random& /*rng*/, I32 /*depth*/, SampleAOVs* pAovs)
+{
+    SurfaceInteraction si = { };
+    si.time = INFINITY;
+
+    F32 cost = 0.f;
+    B32 hit = false;
+#if defined STATS_ENABLE
+    if (m_metric != HeatmapMetric::Nanoseconds)
+    {
+        U64 before = readCounter(m_metric);
+        hit = pScene->intersects(ray, si);
+        cost = (F32)(readCounter(m_metric) - before);
+    }
+    else
+#endif
+    {
+        F64 start = getStatsTime();
+        hit = pScene->intersects(ray, si);
+        cost = (F32)((getStatsTime() - start) * 1e9);
+    }
+
+    if (pAovs)
+    {
+        *pAovs = { INFINITY, Float3(), Float3(), ~0u, Float3(), Float3(), cost };
+        if (hit)
+        {
+            pAovs->depth = length(si.vPosition - ray.o);
+            pAovs->normal = si.vNormal;
+            pAovs->primitiveId = si.primitiveId;
+        }
+    }
+    return heatmapRamp(logf(1.f + cost) / logf(1.f + m_maxCost));
+}
+} // rt
\ No newline at end of file
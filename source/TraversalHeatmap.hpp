@@ -0,0 +1,52 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "RayTracer.hpp"
+
+namespace rt {
+
+
+enum class HeatmapMetric
+{
+    // Time spent finding the camera ray's closest hit.
+    Nanoseconds,
+    // Primitives and aggregate nodes tested by the camera ray. These come from the hot path
+    // counters, so they need a build with STATS_ENABLE, without it time is measured instead.
+    PrimitiveTests,
+    NodesVisited
+};
+
+// Debug view of how much the camera rays cost to trace, instead of shaded color. Each pixel is
+// colored on a blue, green, red ramp over a log scale of its cost, and the raw cost, averaged
+// over the pixel's samples, goes to the Cost AOV. Made for finding geometry that defeats the
+// aggregate, such as huge spheres overlapping everything or long thin triangles.
+class TraversalHeatmapIntegrator : public Integrator
+{
+public:
+    TraversalHeatmapIntegrator(HeatmapMetric metric = HeatmapMetric::Nanoseconds)
+    {
+        // Sorted shading runs the base class' shading, not li().
+        setSortedShading(false);
+        // The ramp's colors are written as they are.
+        setTonemapper(Tonemapper(TonemapOperator::Linear));
+        requireAOV(AOV::Cost);
+        setMetric(metric);
+    }
+
+    // Also resets the max cost to a default suited to the metric.
+    void setMetric(HeatmapMetric metric);
+    HeatmapMetric getMetric() const { return m_metric; }
+
+    // Cost shown at the red end of the ramp, and anything above it.
+    void setMaxCost(F32 maxCost) { m_maxCost = maxCost > 1.f ? maxCost : 1.f; }
+    F32 getMaxCost() const { return m_maxCost; }
+
+    // Ramp color of the camera ray's traversal cost, misses included.
+    Float3 li(Ray& ray, Scene* pScene, Random& rng, I32 depth = 0, SampleAOVs* pAovs = nullptr) override;
+
+private:
+    HeatmapMetric   m_metric;
+    F32             m_maxCost;
+};
+} // rt
\ No newline at end of file
@@ -1,6 +1,7 @@
 // Raytracer.
 #pragma once
 
+#include "common/Arena.hpp"
 #include "math/Float.hpp"
 #include "math/Ray.hpp"
 
@@ -17,8 +18,19 @@ public:
 
     virtual B32 intersects(const Ray& ray, SurfaceInteraction& si) = 0;
 
+    // Whether anything blocks the ray before its tMax. Any hit will do, so aggregates should 
+    // stop at the first one they find instead of searching for the closest.
+    virtual B32 occluded(const Ray& ray)
+    {
+        SurfaceInteraction si = { };
+        si.time = INFINITY;
+        return intersects(ray, si) && si.time < ray.tMax;
+    }
+
     virtual B32 update() { return true; }
 
-    virtual B32 addPrimitives(U32 primitiveCount, Primitive** pPrimitives) = 0;
+    // Add the primitives [first, first + count) of the scene's arena. The arena outlives the
+    // aggregate and never moves what it holds, so aggregates can trace the primitives in place.
+    virtual B32 addPrimitives(const TypedArena<Primitive>& primitives, U32 first, U32 count) = 0;
 };
 } // rt
\ No newline at end of file
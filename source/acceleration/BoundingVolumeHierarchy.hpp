@@ -23,7 +23,7 @@ public:
 
     virtual B32 intersects(const Ray& ray, SurfaceInteraction& si) override;
 
-    virtual B32 addPrimitives(U32 primitiveCount, Primitive** ppPrimitives) override;
+    virtual B32 addPrimitives(const TypedArena<Primitive>& primitives, U32 first, U32 count) override;
 
     virtual B32 update() override { return true; }
 
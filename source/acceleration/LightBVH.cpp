@@ -0,0 +1,353 @@
+// Raytracer.
+#include "LightBVH.hpp"
+
+#include "math/Bounds.hpp"
+#include "math/CommonMath.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+namespace rt {
+
+
+static const U32 kLightBuckets = 12;
+static const F32 kOneMinusEpsilon = 0.99999994f;
+
+static F32 safeSqrt(F32 v)
+{
+    return sqrtf(fmaxf(0.f, v));
+}
+
+// cos(max(0, a - b)), given the sine and cosine of both angles.
+static F32 cosSubClamped(F32 sinA, F32 cosA, F32 sinB, F32 cosB)
+{
+    if (cosA > cosB) return 1.f;
+    return cosA * cosB + sinA * sinB;
+}
+
+// sin(max(0, a - b)), given the sine and cosine of both angles.
+static F32 sinSubClamped(F32 sinA, F32 cosA, F32 sinB, F32 cosB)
+{
+    if (cosA > cosB) return 0.f;
+    return sinA * cosB - cosA * sinB;
+}
+
+// Rotate v about the unit axis k by the given angle (Rodrigues' rotation).
+static Float3 rotateAbout(const Float3& v, const Float3& k, F32 radians)
+{
+    F32 c = cosf(radians);
+    F32 s = sinf(radians);
+    return v * c + cross(k, v) * s + k * (dot(k, v) * (1.f - c));
+}
+
+F32 lightImportance(const LightBounds& lb, const Float3& p, const Float3& n)
+{
+    Float3 pc = center(lb.bounds);
+    F32 radius = length(diagonal(lb.bounds)) * 0.5f;
+    F32 d2 = length2(p - pc);
+    F32 d = sqrtf(d2);
+    d2 = fmaxf(d2, radius);
+
+    // Angle between the principal emission direction and the shading point.
+    Float3 wi = (d > 0.f) ? (p - pc) / d : Float3(0.f, 0.f, 1.f);
+    F32 cosThetaW = (d > 0.f) ? dot(lb.w, wi) : 1.f;
+    if (lb.twoSided) cosThetaW = fabsf(cosThetaW);
+    F32 sinThetaW = safeSqrt(1.f - cosThetaW * cosThetaW);
+
+    // Angle subtended by the bounds, as seen from the shading point.
+    F32 cosThetaB = -1.f;
+    if (d > radius)
+    {
+        F32 sin2ThetaMax = (radius * radius) / (d * d);
+        cosThetaB = safeSqrt(1.f - sin2ThetaMax);
+    }
+    F32 sinThetaB = safeSqrt(1.f - cosThetaB * cosThetaB);
+
+    // Minimum angle between the emission cone and the shading point.
+    F32 sinThetaO = safeSqrt(1.f - lb.cosThetaO * lb.cosThetaO);
+    F32 cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    F32 sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    F32 cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= lb.cosThetaE) return 0.f;
+
+    F32 importance = lb.phi * cosThetaP / d2;
+
+    // Factor in the incident angle at the surface, if there is one.
+    if (n.x != 0.f || n.y != 0.f || n.z != 0.f)
+    {
+        F32 cosThetaI = fabsf(dot(wi, n));
+        F32 sinThetaI = safeSqrt(1.f - cosThetaI * cosThetaI);
+        importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+    return fmaxf(importance, 0.f);
+}
+
+LightBounds lightBoundsUnion(const LightBounds& lh, const LightBounds& rh)
+{
+    // Lights without power do not contribute to the union.
+    if (lh.phi == 0.f) return rh;
+    if (rh.phi == 0.f) return lh;
+
+    LightBounds ans;
+    ans.bounds = boundsUnion(lh.bounds, rh.bounds);
+    ans.phi = lh.phi + rh.phi;
+    ans.cosThetaE = fminf(lh.cosThetaE, rh.cosThetaE);
+    ans.twoSided = lh.twoSided || rh.twoSided;
+
+    // Bound both emission cones with a single cone.
+    F32 thetaA = acosf(RT_CLAMP(lh.cosThetaO, -1.f, 1.f));
+    F32 thetaB = acosf(RT_CLAMP(rh.cosThetaO, -1.f, 1.f));
+    F32 thetaD = acosf(RT_CLAMP(dot(lh.w, rh.w), -1.f, 1.f));
+    if (fminf(thetaD + thetaB, (F32)RT_PI) <= thetaA)
+    {
+        ans.w = lh.w;
+        ans.cosThetaO = lh.cosThetaO;
+        return ans;
+    }
+    if (fminf(thetaD + thetaA, (F32)RT_PI) <= thetaB)
+    {
+        ans.w = rh.w;
+        ans.cosThetaO = rh.cosThetaO;
+        return ans;
+    }
+
+    F32 thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+    Float3 wr = cross(lh.w, rh.w);
+    if (thetaO >= (F32)RT_PI || length2(wr) == 0.f)
+    {
+        ans.w = lh.w;
+        ans.cosThetaO = -1.f;
+        return ans;
+    }
+    ans.w = normalize(rotateAbout(lh.w, normalize(wr), thetaO - thetaA));
+    ans.cosThetaO = cosf(thetaO);
+    return ans;
+}
+
+// Surface area orientation heuristic, weighing the power of a cluster by its bounds and
+// the solid angle of its emission.
+static F32 evaluateCost(const LightBounds& lb, const Bounds3& parentBounds, I32 dim)
+{
+    if (lb.phi == 0.f) return 0.f;
+    F32 thetaO = acosf(RT_CLAMP(lb.cosThetaO, -1.f, 1.f));
+    F32 thetaE = acosf(RT_CLAMP(lb.cosThetaE, -1.f, 1.f));
+    F32 thetaW = fminf(thetaO + thetaE, (F32)RT_PI);
+    F32 sinThetaO = safeSqrt(1.f - lb.cosThetaO * lb.cosThetaO);
+    F32 mOmega = 2.f * (F32)RT_PI * (1.f - lb.cosThetaO) +
+                 (F32)RT_PI / 2.f * (2.f * thetaW * sinThetaO - cosf(thetaO - 2.f * thetaW) -
+                                     2.f * thetaO * sinThetaO + lb.cosThetaO);
+    Float3 d = diagonal(parentBounds);
+    F32 maxExtent = fmaxf(d.x, fmaxf(d.y, d.z));
+    F32 kr = (d[dim] > 0.f) ? maxExtent / d[dim] : 1.f;
+    return lb.phi * mOmega * kr * surfaceArea(lb.bounds);
+}
+
+void LightBVH::build(const std::vector<Light*>& lights)
+{
+    m_nodes.clear();
+    m_boundedLights.clear();
+    m_infiniteLights.clear();
+    m_bitTrails.clear();
+
+    std::vector<BuildLight> buildLights;
+    for (Light* light : lights)
+    {
+        LightBounds lb;
+        if (!light->getLightBounds(lb))
+        {
+            m_infiniteLights.push_back(light);
+            continue;
+        }
+        if (lb.phi <= 0.f)
+            continue;
+        buildLights.push_back({ lb, (U32)m_boundedLights.size() });
+        m_boundedLights.push_back(light);
+    }
+
+    if (!buildLights.empty())
+        buildRecursive(buildLights, 0, (U32)buildLights.size(), 0ULL, 0);
+}
+
+LightBounds LightBVH::buildRecursive(std::vector<BuildLight>& buildLights, U32 start, U32 end,
+                                     U64 bitTrail, U32 depth)
+{
+    if (end - start == 1)
+    {
+        const BuildLight& bl = buildLights[start];
+        m_nodes.push_back({ bl.lightBounds, bl.lightIndex, true });
+        m_bitTrails[m_boundedLights[bl.lightIndex]] = bitTrail;
+        return bl.lightBounds;
+    }
+
+    Bounds3 bounds = buildLights[start].lightBounds.bounds;
+    Float3 c = center(bounds);
+    Bounds3 centroidBounds = { c, c };
+    for (U32 i = start + 1; i < end; ++i)
+    {
+        bounds = boundsUnion(bounds, buildLights[i].lightBounds.bounds);
+        centroidBounds = boundsUnion(centroidBounds, center(buildLights[i].lightBounds.bounds));
+    }
+
+    // Find the cheapest bucketed split over all three axes.
+    F32 minCost = INFINITY;
+    I32 minBucket = -1;
+    I32 minDim = -1;
+    for (I32 dim = 0; dim < 3; ++dim)
+    {
+        F32 cmin = centroidBounds.min[dim];
+        F32 cmax = centroidBounds.max[dim];
+        if (cmax == cmin)
+            continue;
+
+        LightBounds buckets[kLightBuckets] = { };
+        for (U32 i = start; i < end; ++i)
+        {
+            F32 pc = center(buildLights[i].lightBounds.bounds)[dim];
+            I32 b = (I32)(kLightBuckets * ((pc - cmin) / (cmax - cmin)));
+            b = RT_CLAMP(b, 0, (I32)kLightBuckets - 1);
+            buckets[b] = lightBoundsUnion(buckets[b], buildLights[i].lightBounds);
+        }
+
+        for (U32 split = 0; split < kLightBuckets - 1; ++split)
+        {
+            LightBounds below = { };
+            LightBounds above = { };
+            for (U32 b = 0; b <= split; ++b)
+                below = lightBoundsUnion(below, buckets[b]);
+            for (U32 b = split + 1; b < kLightBuckets; ++b)
+                above = lightBoundsUnion(above, buckets[b]);
+            F32 cost = evaluateCost(below, bounds, dim) + evaluateCost(above, bounds, dim);
+            if (cost > 0.f && cost < minCost)
+            {
+                minCost = cost;
+                minBucket = (I32)split;
+                minDim = dim;
+            }
+        }
+    }
+
+    U32 mid = (start + end) / 2;
+    if (minDim != -1)
+    {
+        F32 cmin = centroidBounds.min[minDim];
+        F32 cmax = centroidBounds.max[minDim];
+        auto it = std::partition(buildLights.begin() + start, buildLights.begin() + end,
+            [=] (const BuildLight& bl) -> bool {
+                F32 pc = center(bl.lightBounds.bounds)[minDim];
+                I32 b = (I32)(kLightBuckets * ((pc - cmin) / (cmax - cmin)));
+                b = RT_CLAMP(b, 0, (I32)kLightBuckets - 1);
+                return b <= minBucket;
+            });
+        mid = (U32)(it - buildLights.begin());
+        if (mid == start || mid == end)
+            mid = (start + end) / 2;
+    }
+
+    // Interior node. The first child immediately follows its parent, the second child's
+    // offset is patched in once the first subtree is built.
+    U32 nodeIndex = (U32)m_nodes.size();
+    m_nodes.push_back({ });
+    // Bit trails only hold 64 levels. Deeper trees stop recording, and their pmf degrades to an estimate.
+    U64 rightBit = (depth < 64) ? (1ULL << depth) : 0ULL;
+    LightBounds lb0 = buildRecursive(buildLights, start, mid, bitTrail, depth + 1);
+    m_nodes[nodeIndex].childOrLightIndex = (U32)m_nodes.size();
+    LightBounds lb1 = buildRecursive(buildLights, mid, end, bitTrail | rightBit, depth + 1);
+
+    LightBounds lb = lightBoundsUnion(lb0, lb1);
+    m_nodes[nodeIndex].lightBounds = lb;
+    m_nodes[nodeIndex].isLeaf = false;
+    return lb;
+}
+
+Light* LightBVH::sample(const Float3& p, const Float3& n, F32 u, F32& pmf) const
+{
+    pmf = 0.f;
+    // Choose between the unbounded lights and the hierarchy, with the hierarchy counting as one light.
+    U32 nInfinite = (U32)m_infiniteLights.size();
+    F32 pInfinite = (F32)nInfinite / (F32)(nInfinite + (m_nodes.empty() ? 0 : 1));
+    if (u < pInfinite)
+    {
+        U32 index = (U32)(u / pInfinite * nInfinite);
+        index = index < nInfinite - 1 ? index : nInfinite - 1;
+        pmf = pInfinite / nInfinite;
+        return m_infiniteLights[index];
+    }
+
+    if (m_nodes.empty())
+        return nullptr;
+
+    // Remap u to [0, 1) and walk down the tree, reusing it at every level.
+    u = fminf((u - pInfinite) / (1.f - pInfinite), kOneMinusEpsilon);
+    F32 nodePmf = 1.f - pInfinite;
+    U32 nodeIndex = 0;
+    while (true)
+    {
+        const LightBVHNode& node = m_nodes[nodeIndex];
+        if (node.isLeaf)
+        {
+            if (nodeIndex > 0 || lightImportance(node.lightBounds, p, n) > 0.f)
+            {
+                pmf = nodePmf;
+                return m_boundedLights[node.childOrLightIndex];
+            }
+            return nullptr;
+        }
+
+        U32 child0 = nodeIndex + 1;
+        U32 child1 = node.childOrLightIndex;
+        F32 ci0 = lightImportance(m_nodes[child0].lightBounds, p, n);
+        F32 ci1 = lightImportance(m_nodes[child1].lightBounds, p, n);
+        if (ci0 == 0.f && ci1 == 0.f)
+            return nullptr;
+
+        F32 p0 = ci0 / (ci0 + ci1);
+        if (u < p0)
+        {
+            nodeIndex = child0;
+            u = fminf(u / p0, kOneMinusEpsilon);
+            nodePmf *= p0;
+        }
+        else
+        {
+            nodeIndex = child1;
+            u = fminf((u - p0) / (1.f - p0), kOneMinusEpsilon);
+            nodePmf *= 1.f - p0;
+        }
+    }
+}
+
+F32 LightBVH::pmf(const Float3& p, const Float3& n, const Light* light) const
+{
+    U32 nInfinite = (U32)m_infiniteLights.size();
+    F32 pInfinite = (F32)nInfinite / (F32)(nInfinite + (m_nodes.empty() ? 0 : 1));
+
+    auto it = m_bitTrails.find(light);
+    if (it == m_bitTrails.end())
+    {
+        // Either an unbounded light, or one that is not in the scene.
+        for (Light* infinite : m_infiniteLights)
+            if (infinite == light)
+                return pInfinite / nInfinite;
+        return 0.f;
+    }
+
+    U64 bitTrail = it->second;
+    F32 nodePmf = 1.f - pInfinite;
+    U32 nodeIndex = 0;
+    while (!m_nodes[nodeIndex].isLeaf)
+    {
+        const LightBVHNode& node = m_nodes[nodeIndex];
+        U32 child0 = nodeIndex + 1;
+        U32 child1 = node.childOrLightIndex;
+        F32 ci0 = lightImportance(m_nodes[child0].lightBounds, p, n);
+        F32 ci1 = lightImportance(m_nodes[child1].lightBounds, p, n);
+        if (ci0 == 0.f && ci1 == 0.f)
+            return 0.f;
+        B32 right = bitTrail & 1ULL;
+        nodePmf *= (right ? ci1 : ci0) / (ci0 + ci1);
+        nodeIndex = right ? child1 : child0;
+        bitTrail >>= 1ULL;
+    }
+    return nodePmf;
+}
+} // rt
\ No newline at end of file
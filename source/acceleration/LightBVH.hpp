@@ -0,0 +1,65 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+#include "Light.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace rt {
+
+
+// Light hierarchy for many-light sampling. Bounded lights are clustered into a binary tree
+// of spatial bounds, power and emission cones. A shading point walks the tree once, picking
+// a child at each node in proportion to its estimated importance, so choosing a light costs
+// O(log n) regardless of how many lights are in the scene. Unbounded lights (directional,
+// environment) are kept aside and chosen uniformly.
+class LightBVH
+{
+public:
+    struct LightBVHNode
+    {
+        LightBounds lightBounds;
+        // Offset of the second child for interior nodes, or light index for leaves.
+        U32         childOrLightIndex;
+        B32         isLeaf;
+    };
+
+    // Rebuild the hierarchy over the given lights.
+    void build(const std::vector<Light*>& lights);
+
+    // Choose a light for the shading point p, with surface normal n. Returns the probability
+    // of having picked the light in pmf. Returns nullptr if no light could contribute.
+    Light* sample(const Float3& p, const Float3& n, F32 u, F32& pmf) const;
+
+    // Probability of sample() picking the given light, for the same shading point.
+    F32 pmf(const Float3& p, const Float3& n, const Light* light) const;
+
+    B32 isEmpty() const { return m_nodes.empty() && m_infiniteLights.empty(); }
+
+private:
+    struct BuildLight
+    {
+        LightBounds lightBounds;
+        U32         lightIndex;
+    };
+
+    LightBounds buildRecursive(std::vector<BuildLight>& buildLights, U32 start, U32 end,
+                               U64 bitTrail, U32 depth);
+
+    std::vector<LightBVHNode>               m_nodes;
+    std::vector<Light*>                     m_boundedLights;
+    std::vector<Light*>                     m_infiniteLights;
+    // Path taken from the root to each light's leaf, one bit per level. Used to evaluate the pmf.
+    std::unordered_map<const Light*, U64>   m_bitTrails;
+};
+
+// Estimate the contribution of a cluster of lights to the point p, with surface normal n.
+// n may be zero, for shading points without a surface.
+F32 lightImportance(const LightBounds& lb, const Float3& p, const Float3& n);
+
+LightBounds lightBoundsUnion(const LightBounds& lh, const LightBounds& rh);
+} // rt
\ No newline at end of file
@@ -3,43 +3,75 @@
 
 #include "math/Float.hpp"
 #include "acceleration/Aggregate.hpp"
+#include "common/Stats.hpp"
 
 #include "Primitive.hpp"
 
-#include <vector>
-
 namespace rt {
 
+// Tests every primitive, straight from the scene's arena. The scene adds its primitives in
+// order of creation, so the container's are always the first m_count of the arena, and a
+// traversal walks its blocks front to back without a pointer per primitive.
 class SimpleContainer : public Aggregate
 {
 public:
+    SimpleContainer()
+        : m_pPrimitives(nullptr)
+        , m_count(0) { }
+
+    // Only the hit record is kept while searching, the interaction is filled in once at the end
+    // for the closest hit, if it's closer than si.time. The ray tested is shortened to each
+    // closer hit, so shapes reject anything past it themselves.
     B32 intersects(const Ray& ray, SurfaceInteraction& si) override {
-        B32 intersect = false;
-        for (Primitive* prim : m_pPrimitives)
+        HitRecord closest;
+        closest.time = si.time;
+        const Primitive* pClosest = nullptr;
+        Ray tested(ray.o, ray.dir, ray.tMax < si.time ? ray.tMax : si.time);
+        for (U32 i = 0; i < m_count; ++i)
         {
-            SurfaceInteraction test;
-            if (prim->intersects(ray, test))
+            const Primitive& prim = m_pPrimitives->get(i);
+            HitRecord hit;
+            if (prim.intersect(tested, hit) && hit.time < closest.time)
             {
-                intersect = true;
-                if (test.time < si.time)
-                {
-                    si = test;
-                }   
+                closest = hit;
+                pClosest = &prim;
+                tested.tMax = hit.time;
             }
         }
-
-        return intersect;
+        RT_STAT_ADD(Stat::PrimitiveTests, m_count);
+        if (!pClosest)
+            return false;
+        pClosest->computeInteraction(ray, closest, si);
+        return true;
     }
 
-    B32 addPrimitives(U32 primitiveCount, Primitive** pPrimitives) override 
+    B32 occluded(const Ray& ray) override
     {
-        for (U32 i = 0; i < primitiveCount; ++i)
+        for (U32 i = 0; i < m_count; ++i)
         {
-            m_pPrimitives.push_back(pPrimitives[i]);
+            HitRecord hit;
+            if (m_pPrimitives->get(i).intersect(ray, hit) && hit.time < ray.tMax)
+            {
+                RT_STAT_ADD(Stat::PrimitiveTests, i + 1);
+                return true;
+            }
         }
+        RT_STAT_ADD(Stat::PrimitiveTests, m_count);
+        return false;
+    }
+
+    // Ranges have to follow each other from the start of one arena.
+    B32 addPrimitives(const TypedArena<Primitive>& primitives, U32 first, U32 count) override 
+    {
+        if ((m_pPrimitives && m_pPrimitives != &primitives) || first != m_count)
+            return false;
+        m_pPrimitives = &primitives;
+        m_count += count;
         return true;    
     }
 
-    std::vector<Primitive*> m_pPrimitives;
+private:
+    const TypedArena<Primitive>*    m_pPrimitives;
+    U32                             m_count;
 };
 } // rt
\ No newline at end of file
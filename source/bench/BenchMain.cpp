@@ -0,0 +1,75 @@
+// Raytracer.
+#include "Benchmark.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace rt;
+
+static void printUsage()
+{
+    printf("RayTracerBench [options] [scene files...]\n"
+           "  --filter <text>       only run benchmarks whose name contains text\n"
+           "  --json <path>         write the results as JSON\n"
+           "  --tag <text>          label stored in the JSON, such as a version or commit\n"
+           "  --repetitions <n>     runs per benchmark, the fastest is kept (3)\n"
+           "  --min-time <seconds>  shortest timed run of a microbenchmark (0.25)\n"
+           "  --micro               microbenchmarks only\n"
+           "  --scenes              scene benchmarks only\n");
+}
+
+// RayTracerBench [options] [scene files...]
+// Times the hot ray tracing kernels on their own, then whole frames of the canonical scenes
+// and of any scene files given.
+int main(int c, char* argv[])
+{
+    BenchmarkOptions options;
+    std::string jsonPath;
+    std::string tag;
+    std::vector<std::string> sceneFiles;
+    B32 micro = true;
+    B32 scenes = true;
+    for (I32 i = 1; i < c; ++i)
+    {
+        const char* pArg = argv[i];
+        B32 hasValue = i + 1 < c;
+        if (strcmp(pArg, "--filter") == 0 && hasValue)
+            options.filter = argv[++i];
+        else if (strcmp(pArg, "--json") == 0 && hasValue)
+            jsonPath = argv[++i];
+        else if (strcmp(pArg, "--tag") == 0 && hasValue)
+            tag = argv[++i];
+        else if (strcmp(pArg, "--repetitions") == 0 && hasValue)
+            options.repetitions = (U32)atoi(argv[++i]);
+        else if (strcmp(pArg, "--min-time") == 0 && hasValue)
+            options.minSeconds = atof(argv[++i]);
+        else if (strcmp(pArg, "--micro") == 0)
+            scenes = false;
+        else if (strcmp(pArg, "--scenes") == 0)
+            micro = false;
+        else if (pArg[0] == '-')
+        {
+            printUsage();
+            return 1;
+        }
+        else
+            sceneFiles.push_back(pArg);
+    }
+    if (options.repetitions == 0)
+        options.repetitions = 1;
+
+    BenchmarkSuite suite;
+    if (micro)
+        addMicroBenchmarks(suite);
+    if (scenes)
+        addSceneBenchmarks(suite, sceneFiles);
+    suite.run(options);
+
+    if (!jsonPath.empty() && !suite.writeJson(jsonPath, tag))
+    {
+        printf("can't write %s\n", jsonPath.c_str());
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+// Raytracer.
+#include "Benchmark.hpp"
+
+#include <chrono>
+#include <ctime>
+#include <stdio.h>
+#include <thread>
+
+namespace rt {
+
+
+F64 getBenchmarkTime()
+{
+    return std::chrono::duration<F64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void BenchmarkSuite::run(const BenchmarkOptions& options)
+{
+    for (const std::pair<std::string, MicroBenchmark>& micro : m_micro)
+    {
+        if (micro.first.find(options.filter) == std::string::npos)
+            continue;
+        // Find an iteration count that runs long enough for the clock to be trusted, then time
+        // that many repeatedly.
+        U64 iterations = 1;
+        F64 seconds = 0.0;
+        for (;;)
+        {
+            F64 start = getBenchmarkTime();
+            micro.second(iterations);
+            seconds = getBenchmarkTime() - start;
+            if (seconds >= options.minSeconds || iterations >= (1ULL << 40))
+                break;
+            iterations *= 2;
+        }
+        for (U32 i = 1; i < options.repetitions; ++i)
+        {
+            F64 start = getBenchmarkTime();
+            micro.second(iterations);
+            F64 elapsed = getBenchmarkTime() - start;
+            if (elapsed < seconds)
+                seconds = elapsed;
+        }
+        BenchmarkResult result;
+        result.name = micro.first;
+        result.kind = "micro";
+        result.iterations = iterations;
+        result.seconds = seconds;
+        printf("%-32s %12.2f ns/op %14llu ops\n", result.name.c_str(), result.getNsPerIteration(),
+               (unsigned long long)iterations);
+        m_results.push_back(result);
+    }
+
+    for (const std::pair<std::string, SceneBenchmark>& scene : m_scenes)
+    {
+        if (scene.first.find(options.filter) == std::string::npos)
+            continue;
+        BenchmarkResult best;
+        B32 ok = true;
+        for (U32 i = 0; i < options.repetitions && ok; ++i)
+        {
+            BenchmarkResult result;
+            ok = scene.second(result);
+            if (ok && (i == 0 || result.seconds < best.seconds))
+                best = result;
+        }
+        if (!ok)
+        {
+            printf("%-32s skipped\n", scene.first.c_str());
+            continue;
+        }
+        best.name = scene.first;
+        best.kind = "scene";
+        printf("%-32s %12.3f s", best.name.c_str(), best.seconds);
+        for (const std::pair<std::string, F64>& metric : best.metrics)
+            printf("  %s %.6g", metric.first.c_str(), metric.second);
+        printf("\n");
+        m_results.push_back(best);
+    }
+}
+
+static void writeJsonString(FILE* fp, const std::string& s)
+{
+    fputc('"', fp);
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if ((unsigned char)c < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+B32 BenchmarkSuite::writeJson(const std::string& path, const std::string& tag) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+
+    char date[32] = { };
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+#if defined(NDEBUG)
+    const char* pBuild = "release";
+#else
+    const char* pBuild = "debug";
+#endif
+#if defined(_MSC_VER)
+    const char* pCompiler = "msvc";
+#elif defined(__clang__)
+    const char* pCompiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    const char* pCompiler = "gcc " __VERSION__;
+#else
+    const char* pCompiler = "unknown";
+#endif
+
+    fprintf(fp, "{\n  \"tag\": ");
+    writeJsonString(fp, tag);
+    fprintf(fp, ",\n  \"date\": \"%s\",\n  \"build\": \"%s\",\n  \"compiler\": ", date, pBuild);
+    writeJsonString(fp, pCompiler);
+    fprintf(fp, ",\n  \"threads\": %u,\n  \"benchmarks\": [", std::thread::hardware_concurrency());
+    for (U64 i = 0; i < m_results.size(); ++i)
+    {
+        const BenchmarkResult& result = m_results[i];
+        fprintf(fp, "%s\n    { \"name\": ", i ? "," : "");
+        writeJsonString(fp, result.name);
+        fprintf(fp, ", \"kind\": \"%s\", \"iterations\": %llu, \"seconds\": %.9g, \"ns_per_iteration\": %.6g",
+                result.kind.c_str(), (unsigned long long)result.iterations, result.seconds,
+                result.getNsPerIteration());
+        for (const std::pair<std::string, F64>& metric : result.metrics)
+        {
+            fprintf(fp, ", ");
+            writeJsonString(fp, metric.first);
+            fprintf(fp, ": %.9g", metric.second);
+        }
+        fprintf(fp, " }");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    B32 ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+} // rt
\ No newline at end of file
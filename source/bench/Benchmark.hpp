@@ -0,0 +1,83 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+
+// Keep the compiler from dropping a value that's only computed to be timed.
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+    static volatile const void* s_pSink;
+    s_pSink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// Timing of one benchmark, the fastest of its repetitions.
+struct BenchmarkResult
+{
+    std::string                                 name;
+    // "micro" for single operations, "scene" for whole frames.
+    std::string                                 kind;
+    U64                                         iterations  = 0;
+    F64                                         seconds     = 0.0;
+    // Named counters reported next to the timing, such as ray counts.
+    std::vector<std::pair<std::string, F64>>    metrics;
+
+    F64 getNsPerIteration() const { return iterations ? seconds * 1e9 / (F64)iterations : 0.0; }
+};
+
+// Microbenchmarks run their operation the given number of times, scene benchmarks render once
+// and fill in the result themselves, returning false if their scene couldn't be set up.
+typedef std::function<void(U64 iterations)>         MicroBenchmark;
+typedef std::function<B32(BenchmarkResult& result)> SceneBenchmark;
+
+struct BenchmarkOptions
+{
+    // Benchmarks run only if their name contains this.
+    std::string filter;
+    // Microbenchmarks double their iteration count until a run takes at least this long.
+    F64         minSeconds  = 0.25;
+    // Each benchmark is run this many times, the fastest run is kept.
+    U32         repetitions = 3;
+};
+
+class BenchmarkSuite
+{
+public:
+    void addMicro(const std::string& name, const MicroBenchmark& func) { m_micro.push_back({ name, func }); }
+    void addScene(const std::string& name, const SceneBenchmark& func) { m_scenes.push_back({ name, func }); }
+
+    // Run every benchmark matching the filter, printing a line for each as it finishes.
+    void run(const BenchmarkOptions& options);
+
+    const std::vector<BenchmarkResult>& getResults() const { return m_results; }
+
+    // Write the results as JSON, along with the tag and some facts about the build and machine,
+    // so that runs of different versions can be lined up against each other.
+    B32 writeJson(const std::string& path, const std::string& tag) const;
+
+private:
+    std::vector<std::pair<std::string, MicroBenchmark>> m_micro;
+    std::vector<std::pair<std::string, SceneBenchmark>> m_scenes;
+    std::vector<BenchmarkResult>                        m_results;
+};
+
+// Seconds on a monotonic clock, from an arbitrary start.
+F64 getBenchmarkTime();
+
+void addMicroBenchmarks(BenchmarkSuite& suite);
+
+// The canonical scenes, plus one benchmark per scene file given.
+void addSceneBenchmarks(BenchmarkSuite& suite, const std::vector<std::string>& sceneFiles);
+} // rt
\ No newline at end of file
@@ -0,0 +1,212 @@
+// Raytracer.
+#include "Benchmark.hpp"
+
+#include "Interaction.hpp"
+#include "Material.hpp"
+
+#include "geometry/Sphere.hpp"
+#include "geometry/TriangleList.hpp"
+
+#include "math/Bounds.hpp"
+#include "math/CommonMath.hpp"
+#include "math/Matrix44.hpp"
+#include "math/Random.hpp"
+
+#include "scene/Camera.hpp"
+
+#include <memory>
+
+namespace rt {
+
+
+// Inputs cycle through arrays this long, small enough to stay in cache and large enough that
+// branches can't learn the pattern.
+static const U32 kInputCount = 1024;
+static const U32 kInputMask = kInputCount - 1;
+
+// Everything the microbenchmarks share, set up once with a fixed seed.
+struct MicroFixture
+{
+    Ray                 rays[kInputCount];
+    Float3              directions[kInputCount * 2];
+    Matrix44            matrices[64];
+    Float4              points[kInputCount];
+    Sphere              sphere;
+    TriangleList        triangleList;
+    Float3              trianglePositions[3];
+    U32                 triangleIndices[3];
+    Bounds3             bounds;
+    MicrofacetMaterial  microfacet;
+    Camera              camera;
+};
+
+static Float3 randomDirection(Random& rng)
+{
+    F32 z = 1.f - 2.f * rng.nextF32();
+    F32 r = sqrtf(fmaxf(0.f, 1.f - z * z));
+    F32 phi = 2.f * (F32)RT_PI * rng.nextF32();
+    return Float3(r * cosf(phi), r * sinf(phi), z);
+}
+
+static std::shared_ptr<MicroFixture> createMicroFixture()
+{
+    std::shared_ptr<MicroFixture> pFixture = std::make_shared<MicroFixture>();
+    MicroFixture& f = *pFixture;
+    Random rng(0, 1234);
+
+    // Rays from a sphere around the origin, aimed near the unit shapes so about half hit.
+    for (U32 i = 0; i < kInputCount; ++i)
+    {
+        Float3 origin = randomDirection(rng) * 5.f;
+        Float3 target = Float3(rng.nextF32(), rng.nextF32(), rng.nextF32()) * 3.f - 1.5f;
+        f.rays[i] = Ray(origin, normalize(target - origin));
+        f.points[i] = Float4(origin, 1.f);
+    }
+    // Pairs of shading space directions, both in the upper hemisphere.
+    for (U32 i = 0; i < kInputCount * 2; ++i)
+    {
+        Float3 w = randomDirection(rng);
+        f.directions[i] = Float3(w.x, w.y, fabsf(w.z));
+    }
+    for (U32 i = 0; i < 64; ++i)
+    {
+        Float3 t = Float3(rng.nextF32(), rng.nextF32(), rng.nextF32()) * 10.f;
+        f.matrices[i] = rotate(translate(identity(), t), normalize(randomDirection(rng)), rng.nextF32() * 6.f);
+    }
+
+    f.sphere.m_localToWorld = identity();
+    f.sphere.m_worldToLocal = identity();
+    f.sphere.m_radius = 1.f;
+
+    f.trianglePositions[0] = Float3(-1.f, -1.f, 0.f);
+    f.trianglePositions[1] = Float3( 1.f, -1.f, 0.f);
+    f.trianglePositions[2] = Float3( 0.f,  1.f, 0.f);
+    f.triangleIndices[0] = 0;
+    f.triangleIndices[1] = 1;
+    f.triangleIndices[2] = 2;
+    f.triangleList.setVertices(3, f.trianglePositions);
+    f.triangleList.setIndices(1, f.triangleIndices);
+
+    f.bounds = { Float3(-1.f, -1.f, -1.f), Float3(1.f, 1.f, 1.f) };
+
+    f.microfacet.color = Float3(0.8f, 0.6f, 0.4f);
+    f.microfacet.kD = 0.3f;
+    f.microfacet.kS = 0.f;
+    f.microfacet.commit();
+
+    Float2 resolution(1920.f, 1080.f);
+    f.camera.update(identity());
+    f.camera.adjustScreenToRaster(resolution);
+    f.camera.updateProjection(RT_RAD(45.0f), resolution.x / resolution.y, 0.001f, 1000.0f);
+    f.camera.update(translate(identity(), Float3(0.f, 2.f, -10.f)));
+    return pFixture;
+}
+
+void addMicroBenchmarks(BenchmarkSuite& suite)
+{
+    std::shared_ptr<MicroFixture> pFixture = createMicroFixture();
+
+    suite.addMicro("sphere_intersects", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        U32 hits = 0;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            SurfaceInteraction si;
+            hits += f.sphere.intersects(f.rays[i & kInputMask], si) ? 1 : 0;
+            doNotOptimize(si);
+        }
+        doNotOptimize(hits);
+    });
+
+    // Only the hit record, what traversal pays for each candidate.
+    suite.addMicro("sphere_intersect_hit", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        U32 hits = 0;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            HitRecord hit;
+            hits += f.sphere.intersect(f.rays[i & kInputMask], hit) ? 1 : 0;
+            doNotOptimize(hit);
+        }
+        doNotOptimize(hits);
+    });
+
+    suite.addMicro("triangle_intersects", [=] (U64 iterations) -> void {
+        Triangle triangle = pFixture->triangleList.getTriangle(0);
+        U32 hits = 0;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            SurfaceInteraction si;
+            hits += triangle.intersects(pFixture->rays[i & kInputMask], si) ? 1 : 0;
+            doNotOptimize(si);
+        }
+        doNotOptimize(hits);
+    });
+
+    suite.addMicro("triangle_intersect_hit", [=] (U64 iterations) -> void {
+        Triangle triangle = pFixture->triangleList.getTriangle(0);
+        U32 hits = 0;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            HitRecord hit;
+            hits += triangle.intersect(pFixture->rays[i & kInputMask], hit) ? 1 : 0;
+            doNotOptimize(hit);
+        }
+        doNotOptimize(hits);
+    });
+
+    suite.addMicro("ray_bounds_intersect", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        U32 hits = 0;
+        for (U64 i = 0; i < iterations; ++i)
+            hits += rayBoundsIntersect(f.rays[i & kInputMask], f.bounds) ? 1 : 0;
+        doNotOptimize(hits);
+    });
+
+    suite.addMicro("matrix44_multiply", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            Matrix44 m = f.matrices[i & 63] * f.matrices[(i + 1) & 63];
+            doNotOptimize(m);
+        }
+    });
+
+    suite.addMicro("matrix44_inverse", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            Matrix44 m = inverse(f.matrices[i & 63]);
+            doNotOptimize(m);
+        }
+    });
+
+    suite.addMicro("matrix44_transform_point", [=] (U64 iterations) -> void {
+        const MicroFixture& f = *pFixture;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            Float4 p = f.points[i & kInputMask] * f.matrices[i & 63];
+            doNotOptimize(p);
+        }
+    });
+
+    suite.addMicro("microfacet_distribution_f", [=] (U64 iterations) -> void {
+        MicroFixture& f = *pFixture;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            U64 j = (i & kInputMask) * 2;
+            Float3 value = f.microfacet.distributionF(f.directions[j], f.directions[j + 1]);
+            doNotOptimize(value);
+        }
+    });
+
+    suite.addMicro("camera_generate_ray", [=] (U64 iterations) -> void {
+        MicroFixture& f = *pFixture;
+        for (U64 i = 0; i < iterations; ++i)
+        {
+            Ray ray = f.camera.generateRay((F32)(i % 1920), (F32)((i / 1920) % 1080));
+            doNotOptimize(ray);
+        }
+    });
+}
+} // rt
\ No newline at end of file
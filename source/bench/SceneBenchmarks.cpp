@@ -0,0 +1,309 @@
+// Raytracer.
+#include "Benchmark.hpp"
+
+#include "Light.hpp"
+#include "Material.hpp"
+#include "RayTracer.hpp"
+
+#include "acceleration/SimpleContainer.hpp"
+#include "framebuffer/RenderTarget.hpp"
+#include "geometry/Sphere.hpp"
+#include "geometry/TriangleList.hpp"
+#include "loader/Loader.hpp"
+#include "math/CommonMath.hpp"
+#include "math/Random.hpp"
+#include "scene/DefaultScene.hpp"
+#include "scene/Scene.hpp"
+
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+
+namespace rt {
+
+
+class CountingAggregate;
+
+// Rays the calling thread traced through one aggregate, added to the aggregate's totals when
+// the thread exits or the totals are read. Every render thread adding to the same atomic would
+// time the contention on its cache line as much as the traversal.
+struct RayTally
+{
+    CountingAggregate*  pOwner = nullptr;
+    U64                 rays = 0;
+    U64                 shadowRays = 0;
+
+    ~RayTally() { flush(); }
+    void flush();
+};
+
+static thread_local RayTally s_rayTally;
+
+// Forwards to a SimpleContainer, counting the rays traced through it.
+class CountingAggregate : public Aggregate
+{
+public:
+    B32 intersects(const Ray& ray, SurfaceInteraction& si) override
+    {
+        ++getTally().rays;
+        return m_container.intersects(ray, si);
+    }
+
+    B32 occluded(const Ray& ray) override
+    {
+        ++getTally().shadowRays;
+        return m_container.occluded(ray);
+    }
+
+    B32 addPrimitives(const TypedArena<Primitive>& primitives, U32 first, U32 count) override
+    {
+        m_primitiveCount += count;
+        return m_container.addPrimitives(primitives, first, count);
+    }
+
+    void addCounts(U64 rays, U64 shadowRays)
+    {
+        m_rays += rays;
+        m_shadowRays += shadowRays;
+    }
+
+    // The threads that rendered must have exited, the caller's own count is added here.
+    void resetCounts()
+    {
+        s_rayTally.flush();
+        m_rays = 0;
+        m_shadowRays = 0;
+    }
+
+    U64 getRayCount() { s_rayTally.flush(); return m_rays; }
+    U64 getShadowRayCount() { s_rayTally.flush(); return m_shadowRays; }
+    U32 getPrimitiveCount() const { return m_primitiveCount; }
+
+private:
+    RayTally& getTally()
+    {
+        RayTally& tally = s_rayTally;
+        if (tally.pOwner != this)
+        {
+            tally.flush();
+            tally.pOwner = this;
+        }
+        return tally;
+    }
+
+    SimpleContainer     m_container;
+    std::atomic<U64>    m_rays{ 0 };
+    std::atomic<U64>    m_shadowRays{ 0 };
+    U32                 m_primitiveCount = 0;
+};
+
+void RayTally::flush()
+{
+    if (pOwner)
+        pOwner->addCounts(rays, shadowRays);
+    pOwner = nullptr;
+    rays = 0;
+    shadowRays = 0;
+}
+
+// A scene ready to render, built the first time its benchmark runs. The scene is declared last,
+// so it's destroyed before the arrays and aggregate it points into.
+struct SceneFixture
+{
+    // Vertices and indices of generated meshes.
+    std::vector<Float3> positions;
+    std::vector<Float3> normals;
+    std::vector<U32>    indices;
+    SceneDescription    desc;
+    SceneAssets         assets;
+    CountingAggregate   aggregate;
+    Scene               scene;
+    U32                 samples = 1;
+};
+
+static void setCamera(SceneAssets& assets, U32 width, U32 height, const Float3& position, const Float3& target)
+{
+    Float2 resolution((F32)width, (F32)height);
+    assets.width = width;
+    assets.height = height;
+    assets.camera.update(identity());
+    assets.camera.adjustScreenToRaster(resolution);
+    assets.camera.updateProjection(RT_RAD(45.0f), resolution.x / resolution.y, 0.001f, 1000.0f);
+    assets.camera.update(inverse(lookAt(position, target, Float3(0.f, 1.f, 0.f))));
+}
+
+static Handle<Sphere> createSphere(Scene& scene, const Float3& center, F32 radius)
+{
+    Sphere sphere;
+    sphere.m_localToWorld = translate(identity(), center);
+    sphere.m_worldToLocal = inverse(sphere.m_localToWorld);
+    sphere.m_radius = radius;
+    return scene.createSphere(sphere);
+}
+
+// The default scene of the RayTracer executable, at its default seed.
+static B32 buildSpheres(SceneFixture& f)
+{
+    buildDefaultScene(f.scene, f.assets, 640, 360, 0);
+    return true;
+}
+
+// A tessellated sphere on the ground under a point light, for triangle intersection costs.
+static B32 buildMesh(SceneFixture& f)
+{
+    static const U32 kRings = 12;
+    static const U32 kSegments = 24;
+    for (U32 ring = 0; ring <= kRings; ++ring)
+    {
+        F32 theta = (F32)RT_PI * (F32)ring / (F32)kRings;
+        for (U32 segment = 0; segment <= kSegments; ++segment)
+        {
+            F32 phi = 2.f * (F32)RT_PI * (F32)segment / (F32)kSegments;
+            Float3 n(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            f.normals.push_back(n);
+            f.positions.push_back(n * 2.f + Float3(0.f, 2.f, 0.f));
+        }
+    }
+    for (U32 ring = 0; ring < kRings; ++ring)
+    {
+        for (U32 segment = 0; segment < kSegments; ++segment)
+        {
+            U32 i0 = ring * (kSegments + 1) + segment;
+            U32 i1 = i0 + kSegments + 1;
+            U32 quad[6] = { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 };
+            f.indices.insert(f.indices.end(), quad, quad + 6);
+        }
+    }
+
+    Scene& scene = f.scene;
+    TriangleList* pList = new TriangleList();
+    f.assets.meshes.emplace_back(pList);
+    pList->setVertices((U32)f.positions.size(), f.positions.data(), f.normals.data());
+    pList->setIndices((U32)f.indices.size() / 3, f.indices.data());
+    MicrofacetMaterial* pMaterial = scene.createMaterial<MicrofacetMaterial>();
+    pMaterial->color = Float3(0.9f, 0.7f, 0.3f);
+    pMaterial->kD = 0.2f;
+    pMaterial->kS = 1.f;
+    for (U32 i = 0; i < pList->getTriangleCount(); ++i)
+        scene.createPrimitive(&scene.getTriangle(scene.createTriangle(pList->getTriangle(i))), pMaterial);
+
+    MatteMaterial* pGround = scene.createMaterial<MatteMaterial>();
+    pGround->color = Float3(0.5f, 0.5f, 0.5f);
+    scene.createPrimitive(&scene.getSphere(createSphere(scene, Float3(0.f, -1000.f, 0.f), 1000.f)), pGround);
+    scene.addCreatedPrimitives();
+
+    PointLight* pLight = scene.createLight<PointLight>();
+    pLight->enableShadowing(true);
+    pLight->position = Float3(4.f, 8.f, -4.f);
+    pLight->i = Float3(100.f, 100.f, 100.f);
+    scene.addLight(pLight);
+
+    setCamera(f.assets, 320, 180, Float3(0.f, 4.f, -9.f), Float3(0.f, 1.5f, 0.f));
+    return true;
+}
+
+// Spheres lit only by a spherical area light taking several samples, so shadow rays dominate.
+static B32 buildAreaLight(SceneFixture& f)
+{
+    Scene& scene = f.scene;
+    Random rng(0, 27);
+    for (U32 i = 0; i < 24; ++i)
+    {
+        Float3 center(rng.nextF32() * 12.f - 6.f, 1.f, rng.nextF32() * 12.f - 6.f);
+        MatteMaterial* pMaterial = scene.createMaterial<MatteMaterial>();
+        pMaterial->color = Float3(rng.nextF32(), rng.nextF32(), rng.nextF32());
+        scene.createPrimitive(&scene.getSphere(createSphere(scene, center, 1.f)), pMaterial);
+    }
+    MatteMaterial* pGround = scene.createMaterial<MatteMaterial>();
+    pGround->color = Float3(0.6f, 0.6f, 0.6f);
+    scene.createPrimitive(&scene.getSphere(createSphere(scene, Float3(0.f, -1000.f, 0.f), 1000.f)), pGround);
+
+    Sphere* pLightShape = &scene.getSphere(createSphere(scene, Float3(0.f, 8.f, 0.f), 1.5f));
+    DiffuseAreaLight* pLight = scene.createLight<DiffuseAreaLight>(pLightShape->m_localToWorld, 4, pLightShape,
+                                                                   Float3(20.f, 20.f, 20.f));
+    pLight->enableShadowing(true);
+    scene.addLight(pLight);
+    MatteMaterial* pEmitter = scene.createMaterial<MatteMaterial>();
+    pEmitter->color = Float3();
+    scene.createPrimitive(pLightShape, pEmitter, pLight);
+    scene.addCreatedPrimitives();
+
+    setCamera(f.assets, 480, 270, Float3(0.f, 10.f, -16.f), Float3());
+    return true;
+}
+
+// Render the fixture's scene once, timing only the render itself.
+static B32 renderScene(SceneFixture& f, BenchmarkResult& result)
+{
+    ImageBuffer renderBuf(f.assets.width, f.assets.height);
+    RenderTarget rt;
+    rt.width = f.assets.width;
+    rt.height = f.assets.height;
+    rt.surface = &renderBuf;
+    rt.enableTiling();
+
+    Integrator integrator;
+    integrator.setOutput("", ImageFormat::PNG);
+    integrator.setCamera(&f.assets.camera);
+    integrator.setRenderTarget(&rt);
+    integrator.setSamples(f.samples);
+
+    f.aggregate.resetCounts();
+    F64 start = getBenchmarkTime();
+    integrator.render(&f.scene);
+    result.seconds = getBenchmarkTime() - start;
+
+    U64 primaryRays = (U64)f.assets.width * f.assets.height * f.samples;
+    U64 rays = f.aggregate.getRayCount();
+    U64 shadowRays = f.aggregate.getShadowRayCount();
+    result.iterations = primaryRays;
+    result.metrics = {
+        { "width",              (F64)f.assets.width },
+        { "height",             (F64)f.assets.height },
+        { "samples",            (F64)f.samples },
+        { "primitives",         (F64)f.aggregate.getPrimitiveCount() },
+        { "primary_rays",       (F64)primaryRays },
+        { "secondary_rays",     (F64)(rays > primaryRays ? rays - primaryRays : 0) },
+        { "shadow_rays",        (F64)shadowRays },
+        { "mrays_per_second",   result.seconds > 0.0 ? (F64)(rays + shadowRays) / result.seconds * 1e-6 : 0.0 },
+    };
+    return true;
+}
+
+// A benchmark building its scene on first use, so filtered out scenes cost nothing.
+static SceneBenchmark makeSceneBenchmark(const std::function<B32(SceneFixture&)>& build)
+{
+    std::shared_ptr<std::unique_ptr<SceneFixture>> pFixture = std::make_shared<std::unique_ptr<SceneFixture>>();
+    return [=] (BenchmarkResult& result) -> B32 {
+        if (!*pFixture)
+        {
+            std::unique_ptr<SceneFixture> fixture(new SceneFixture());
+            fixture->scene.setAggregate(&fixture->aggregate);
+            if (!build(*fixture))
+                return false;
+            *pFixture = std::move(fixture);
+        }
+        return renderScene(**pFixture, result);
+    };
+}
+
+void addSceneBenchmarks(BenchmarkSuite& suite, const std::vector<std::string>& sceneFiles)
+{
+    suite.addScene("scene_spheres", makeSceneBenchmark(buildSpheres));
+    suite.addScene("scene_mesh", makeSceneBenchmark(buildMesh));
+    suite.addScene("scene_area_light", makeSceneBenchmark(buildAreaLight));
+
+    for (const std::string& filename : sceneFiles)
+    {
+        suite.addScene("scene_file:" + filename, makeSceneBenchmark([=] (SceneFixture& f) -> B32 {
+            Loader loader;
+            if (!loader.load(filename, f.desc) || !loader.build(f.desc, &f.scene, f.assets))
+            {
+                printf("%s\n", loader.getError().c_str());
+                return false;
+            }
+            return true;
+        }));
+    }
+}
+} // rt
\ No newline at end of file
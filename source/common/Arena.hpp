@@ -0,0 +1,146 @@
+// Raytracer.
+#pragma once
+
+#include "common/Memory.hpp"
+#include "common/Types.hpp"
+
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+
+// Index of an object in a TypedArena. It stays valid for the arena's lifetime, and is half
+// the size of a pointer.
+template <typename T>
+struct Handle
+{
+    static const U32 kInvalid = ~0u;
+
+    U32 index = kInvalid;
+
+    B32 isValid() const { return index != kInvalid; }
+};
+
+// Objects of one type, stored in blocks of 2^kBlockShift elements. Blocks are never moved or
+// resized, so objects keep their address, and objects created one after another sit next to
+// each other in memory. Everything is released at once when the arena is cleared. Types that
+// need no destructor cost a free per block, others a destructor call each as well.
+template <typename T, U32 kBlockShift = 10>
+class TypedArena
+{
+public:
+    static const U32 kBlockSize = 1u << kBlockShift;
+
+    TypedArena() : m_count(0) { }
+    ~TypedArena() { clear(); }
+
+    TypedArena(const TypedArena&) = delete;
+    TypedArena& operator=(const TypedArena&) = delete;
+
+    template <typename... Args>
+    Handle<T> create(Args&&... args)
+    {
+        if (m_count == m_blocks.size() * kBlockSize)
+            m_blocks.push_back((T*)alignedAlloc(sizeof(T) * kBlockSize));
+        new (&m_blocks[m_count >> kBlockShift][m_count & (kBlockSize - 1)]) T(std::forward<Args>(args)...);
+        Handle<T> handle;
+        handle.index = m_count++;
+        return handle;
+    }
+
+    T& operator[](Handle<T> handle) { return get(handle.index); }
+    const T& operator[](Handle<T> handle) const { return get(handle.index); }
+
+    T& get(U32 index) { return m_blocks[index >> kBlockShift][index & (kBlockSize - 1)]; }
+    const T& get(U32 index) const { return m_blocks[index >> kBlockShift][index & (kBlockSize - 1)]; }
+
+    U32 size() const { return m_count; }
+
+    void clear()
+    {
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            for (U32 i = 0; i < m_count; ++i)
+                get(i).~T();
+        }
+        for (T* pBlock : m_blocks)
+            alignedFree(pBlock);
+        m_blocks.clear();
+        m_count = 0;
+    }
+
+private:
+    std::vector<T*> m_blocks;
+    U32             m_count;
+};
+
+// Objects of any type, bump allocated from large blocks. Meant for polymorphic objects such as
+// materials and lights, which can't share a TypedArena. Destructors run in reverse order of
+// creation when the arena is cleared, for the types that have one.
+class MemoryArena
+{
+public:
+    explicit MemoryArena(U64 blockSize = 64 * 1024)
+        : m_pCursor(nullptr)
+        , m_pEnd(nullptr)
+        , m_blockSize(blockSize) { }
+    ~MemoryArena() { clear(); }
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    // Alignment must be a power of two, no larger than a cache line.
+    void* allocate(U64 size, U64 alignment)
+    {
+        U8* p = (U8*)(((uintptr_t)m_pCursor + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        if (!m_pCursor || p + size > m_pEnd)
+        {
+            // Anything larger than a block gets a block of its own.
+            U64 blockSize = size > m_blockSize ? size : m_blockSize;
+            p = (U8*)alignedAlloc(blockSize);
+            m_blocks.push_back(p);
+            m_pEnd = p + blockSize;
+        }
+        m_pCursor = p + size;
+        return p;
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        T* p = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            m_destructors.push_back({ p, [] (void* pObject) -> void { ((T*)pObject)->~T(); } });
+        return p;
+    }
+
+    void clear()
+    {
+        for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it)
+            it->destroy(it->pObject);
+        for (U8* pBlock : m_blocks)
+            alignedFree(pBlock);
+        m_destructors.clear();
+        m_blocks.clear();
+        m_pCursor = nullptr;
+        m_pEnd = nullptr;
+    }
+
+private:
+    struct Destructor
+    {
+        void*   pObject;
+        void    (*destroy)(void*);
+    };
+
+    std::vector<U8*>        m_blocks;
+    std::vector<Destructor> m_destructors;
+    U8*                     m_pCursor;
+    U8*                     m_pEnd;
+    U64                     m_blockSize;
+};
+} // rt
\ No newline at end of file
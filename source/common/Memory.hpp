@@ -0,0 +1,38 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace rt {
+
+
+static const U64 kCacheLineSize = 64;
+
+// Allocate memory starting on an alignment boundary, which must be a power of two.
+// Release it with alignedFree.
+inline void* alignedAlloc(U64 size, U64 alignment = kCacheLineSize)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, alignment, size) != 0)
+        return nullptr;
+    return p;
+#endif
+}
+
+inline void alignedFree(void* p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,83 @@
+// Raytracer.
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace rt {
+
+
+F64 getStatsTime()
+{
+    return std::chrono::duration<F64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined STATS_ENABLE
+// Threads with counters, and what the exited ones counted.
+static std::mutex                   s_statsLock;
+static std::vector<ThreadStats*>    s_liveStats;
+static U64                          s_exitedStats[(U32)Stat::Count];
+
+ThreadStats::ThreadStats()
+{
+    for (std::atomic<U64>& counter : m_counters)
+        counter.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(s_statsLock);
+    s_liveStats.push_back(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+    std::lock_guard<std::mutex> guard(s_statsLock);
+    for (U32 i = 0; i < (U32)Stat::Count; ++i)
+        s_exitedStats[i] += get((Stat)i);
+    s_liveStats.erase(std::find(s_liveStats.begin(), s_liveStats.end(), this));
+}
+
+void gatherStats(U64 counters[(U32)Stat::Count])
+{
+    std::lock_guard<std::mutex> guard(s_statsLock);
+    for (U32 i = 0; i < (U32)Stat::Count; ++i)
+    {
+        counters[i] = s_exitedStats[i];
+        for (const ThreadStats* pStats : s_liveStats)
+            counters[i] += pStats->get((Stat)i);
+    }
+}
+#else
+void gatherStats(U64 counters[(U32)Stat::Count])
+{
+    for (U32 i = 0; i < (U32)Stat::Count; ++i)
+        counters[i] = 0;
+}
+#endif
+
+void printFrameStats(const FrameStats& stats, FILE* fp)
+{
+    F64 total = 0.0;
+    for (F64 seconds : stats.phaseSeconds)
+        total += seconds;
+    fprintf(fp, "frame %ux%u: %.3f s (build %.3f, trace %.3f, post %.3f, write %.3f)\n",
+            stats.width, stats.height, total, stats.getSeconds(StatPhase::Build), stats.getSeconds(StatPhase::Trace),
+            stats.getSeconds(StatPhase::Post), stats.getSeconds(StatPhase::Write));
+#if defined STATS_ENABLE
+    fprintf(fp, "  rays %llu (camera %llu, secondary %llu, shadow %llu), %.3f Mrays/s\n",
+            (unsigned long long)stats.getRayCount(), (unsigned long long)stats.get(Stat::CameraRays),
+            (unsigned long long)stats.get(Stat::SecondaryRays), (unsigned long long)stats.get(Stat::ShadowRays),
+            stats.getRaysPerSecond() * 1e-6);
+    fprintf(fp, "  %.2f samples per pixel, %.2f nodes and %.2f primitive tests per ray, %llu hits, %llu shading calls\n",
+            stats.getSamplesPerPixel(), stats.getNodesPerRay(),
+            stats.getRayCount() ? (F64)stats.get(Stat::PrimitiveTests) / (F64)stats.getRayCount() : 0.0,
+            (unsigned long long)stats.get(Stat::Hits), (unsigned long long)stats.get(Stat::ShadingCalls));
+#endif
+    if (stats.tileHits + stats.tileMisses > 0)
+    {
+        fprintf(fp, "  texture tiles: %.1f%% hit rate (%llu hits, %llu misses), %llu evicted, %.1f MB resident\n",
+                stats.getTileHitRate() * 100.0, (unsigned long long)stats.tileHits,
+                (unsigned long long)stats.tileMisses, (unsigned long long)stats.tileEvictions,
+                (F64)stats.tileBytesResident / (1024.0 * 1024.0));
+    }
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,127 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <atomic>
+#include <stdio.h>
+
+namespace rt {
+
+
+// Events counted on the hot paths. Only compiled in with STATS_ENABLE, otherwise RT_STAT_ADD
+// expands to nothing.
+enum class Stat : U32
+{
+    CameraRays,
+    // Closest hit rays spawned at surfaces, such as reflections.
+    SecondaryRays,
+    // Any hit rays, towards lights or for occlusion.
+    ShadowRays,
+    // Aggregate nodes a ray was tested against, zero for aggregates without any.
+    NodesVisited,
+    PrimitiveTests,
+    Hits,
+    // BSDF evaluations, each point of a batch counting once.
+    ShadingCalls,
+    Count
+};
+
+// Parts of a frame that are timed, enabled or not.
+enum class StatPhase : U32
+{
+    // Preparing the scene for the frame, the light hierarchy and material records.
+    Build,
+    Trace,
+    // Denoise, bloom, tonemap and resolve.
+    Post,
+    // Handing the frame to the background writer, encoding overlaps with the next frame.
+    Write,
+    Count
+};
+
+// Counters and timings of one frame.
+struct FrameStats
+{
+    U64 counters[(U32)Stat::Count]          = { };
+    F64 phaseSeconds[(U32)StatPhase::Count] = { };
+    U32 width                               = 0;
+    U32 height                              = 0;
+    // Texture tile cache traffic of the frame, kept whether counters are compiled in or not.
+    // Only lookups past each thread's few most recent tiles reach the cache and are counted.
+    // Resident bytes are what the cache holds at the end of the frame.
+    U64 tileHits                            = 0;
+    U64 tileMisses                          = 0;
+    U64 tileEvictions                       = 0;
+    U64 tileBytesResident                   = 0;
+
+    U64 get(Stat stat) const { return counters[(U32)stat]; }
+    F64 getSeconds(StatPhase phase) const { return phaseSeconds[(U32)phase]; }
+
+    U64 getRayCount() const { return get(Stat::CameraRays) + get(Stat::SecondaryRays) + get(Stat::ShadowRays); }
+    F64 getRaysPerSecond() const
+    {
+        F64 seconds = getSeconds(StatPhase::Trace);
+        return seconds > 0.0 ? (F64)getRayCount() / seconds : 0.0;
+    }
+    F64 getNodesPerRay() const
+    {
+        U64 rays = getRayCount();
+        return rays ? (F64)get(Stat::NodesVisited) / (F64)rays : 0.0;
+    }
+    F64 getSamplesPerPixel() const
+    {
+        U64 pixels = (U64)width * height;
+        return pixels ? (F64)get(Stat::CameraRays) / (F64)pixels : 0.0;
+    }
+    F64 getTileHitRate() const
+    {
+        U64 lookups = tileHits + tileMisses;
+        return lookups ? (F64)tileHits / (F64)lookups : 0.0;
+    }
+};
+
+// Seconds on a monotonic clock, from an arbitrary start.
+F64 getStatsTime();
+
+// Totals of every counter so far, over all threads, live and exited. Frames take the
+// difference of two snapshots. Always zero when counters are compiled out.
+void gatherStats(U64 counters[(U32)Stat::Count]);
+
+// A short report of the frame, the counters only if they were compiled in, and the texture
+// cache only if the frame sampled a texture.
+void printFrameStats(const FrameStats& stats, FILE* fp = stdout);
+
+#if defined STATS_ENABLE
+// Counters of one thread. Only their thread writes them, with plain loads and stores, and
+// gatherStats() reads them from any other. They're added to a global total when the thread
+// exits, so the short lived threads of a dispatch are still counted.
+class ThreadStats
+{
+public:
+    ThreadStats();
+    ~ThreadStats();
+
+    void add(Stat stat, U64 n)
+    {
+        std::atomic<U64>& counter = m_counters[(U32)stat];
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    U64 get(Stat stat) const { return m_counters[(U32)stat].load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<U64> m_counters[(U32)Stat::Count];
+};
+
+inline ThreadStats& getThreadStats()
+{
+    static thread_local ThreadStats s_stats;
+    return s_stats;
+}
+
+#define RT_STAT_ADD(stat, n) rt::getThreadStats().add(stat, n)
+#else
+#define RT_STAT_ADD(stat, n) ((void)0)
+#endif
+} // rt
\ No newline at end of file
@@ -1,7 +1,10 @@
 // Raytracer
 #pragma once
 
+#include "common/Trace.hpp"
 #include "common/Types.hpp"
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <functional>
 #include <vector>
@@ -22,6 +25,8 @@ struct Kernel {
     U32 localX;
     U32 localY;
     U32 localZ;
+    // Names the work of each group, and its threads, on a trace's timeline.
+    const char* name = "dispatch";
 };
 
 // Rudimentary dispatch for parallel work. This is essentially to execute multiple threads within multiple groups,
@@ -42,6 +47,8 @@ static void dispatch(const Kernel& kern, U32 x, U32 y, U32 z)
                 {
                     threads[workX + x * (workY + y * workZ)] =
                     std::thread([=](U64 globalId_1D) -> void {
+                        setTraceThreadName(kern.name);
+                        TraceScope scope(kern.name, "dispatch", "x", (I64)workX, "y", (I64)workY);
                         std::vector<ThreadID> ids(kern.localX * kern.localY * kern.localZ);
                         for (U64 localX = 0; localX < kern.localX; ++localX) 
                         {
@@ -72,4 +79,45 @@ static void dispatch(const Kernel& kern, U32 x, U32 y, U32 z)
     for (U32 i = 0; i < threads.size(); ++i) 
         threads[i].join();
 }
+
+// Split [0, count) into contiguous ranges, one per hardware thread, and run func over them in parallel.
+inline void parallelFor(U32 count, const std::function<void(U32 begin, U32 end)>& func)
+{
+    U32 workers = std::min(count, std::max(std::thread::hardware_concurrency(), 1u));
+    if (workers <= 1)
+    {
+        if (count > 0)
+            func(0, count);
+        return;
+    }
+    U32 chunk = (count + workers - 1) / workers;
+    dispatch({[&] (const ThreadID& id) -> void {
+        U32 begin = id.global.x * chunk;
+        U32 end = std::min(count, begin + chunk);
+        if (begin < end)
+            func(begin, end);
+    }, 1, 1, 1, "parallel for" }, workers, 1, 1);
+}
+
+// Run func over every index in [0, count) on up to workers threads, or one per hardware thread
+// with 0. Indices are handed out one at a time as threads free up, so uneven work such as a
+// frame's tiles balances itself.
+inline void parallelForEach(U32 count, U32 workers, const std::function<void(U32 index)>& func,
+                            const char* pName = "parallel for")
+{
+    if (workers == 0)
+        workers = std::max(std::thread::hardware_concurrency(), 1u);
+    workers = std::min(count, workers);
+    if (workers <= 1)
+    {
+        for (U32 i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+    std::atomic<U32> next{ 0 };
+    dispatch({[&] (const ThreadID&) -> void {
+        for (U32 i = next++; i < count; i = next++)
+            func(i);
+    }, 1, 1, 1, pName }, workers, 1, 1);
+}
 } // rt
\ No newline at end of file
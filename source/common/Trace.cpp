@@ -0,0 +1,193 @@
+// Raytracer.
+#include "Trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+namespace rt {
+
+
+struct TraceEvent
+{
+    const char* pName;
+    const char* pCategory;
+    const char* pArgs[2];
+    I64         args[2];
+    // Nanoseconds since the trace began.
+    U64         start;
+    U64         duration;
+};
+
+// Events of one thread. Kept by the registry after the thread exits, most dispatched threads
+// are gone by the time the trace is written. The lock is only ever contended by endTrace().
+struct TraceBuffer
+{
+    std::mutex              lock;
+    std::vector<TraceEvent> events;
+    std::string             name;
+    U32                     tid;
+};
+
+static std::atomic<U32>                             s_tracing{ 0 };
+static std::atomic<U64>                             s_traceStart{ 0 };
+static std::mutex                                   s_traceLock;
+static std::vector<std::shared_ptr<TraceBuffer>>    s_traceBuffers;
+static U32                                          s_nextTid = 1;
+
+static U64 getTraceNow()
+{
+    return (U64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The calling thread's name, and its buffer once it records anything. Threads that never
+// record while tracing never get a buffer.
+static thread_local const char*                     s_pThreadName = nullptr;
+static thread_local std::shared_ptr<TraceBuffer>    s_pBuffer;
+
+static TraceBuffer& getTraceBuffer()
+{
+    if (!s_pBuffer)
+    {
+        s_pBuffer = std::make_shared<TraceBuffer>();
+        if (s_pThreadName)
+            s_pBuffer->name = s_pThreadName;
+        std::lock_guard<std::mutex> guard(s_traceLock);
+        s_pBuffer->tid = s_nextTid++;
+        s_traceBuffers.push_back(s_pBuffer);
+    }
+    return *s_pBuffer;
+}
+
+void beginTrace()
+{
+    std::lock_guard<std::mutex> guard(s_traceLock);
+    // Buffers only the registry still holds belong to threads that exited.
+    std::vector<std::shared_ptr<TraceBuffer>> live;
+    for (std::shared_ptr<TraceBuffer>& pBuffer : s_traceBuffers)
+    {
+        if (pBuffer.use_count() > 1)
+        {
+            std::lock_guard<std::mutex> bufferGuard(pBuffer->lock);
+            pBuffer->events.clear();
+            live.push_back(pBuffer);
+        }
+    }
+    s_traceBuffers.swap(live);
+    s_traceStart = getTraceNow();
+    s_tracing = 1;
+}
+
+B32 isTracing()
+{
+    return s_tracing.load(std::memory_order_relaxed) != 0;
+}
+
+void setTraceThreadName(const char* pName)
+{
+    s_pThreadName = pName;
+    if (s_pBuffer)
+    {
+        std::lock_guard<std::mutex> guard(s_pBuffer->lock);
+        s_pBuffer->name = pName;
+    }
+}
+
+TraceScope::TraceScope(const char* pName, const char* pCategory, const char* pArg0, I64 arg0,
+                       const char* pArg1, I64 arg1)
+    : m_pName(pName)
+    , m_pCategory(pCategory)
+    , m_pArgs{ pArg0, pArg1 }
+    , m_args{ arg0, arg1 }
+    , m_start(0)
+    , m_active(isTracing())
+{
+    if (m_active)
+        m_start = getTraceNow();
+}
+
+TraceScope::~TraceScope()
+{
+    if (!m_active || !isTracing())
+        return;
+    U64 end = getTraceNow();
+    U64 traceStart = s_traceStart.load(std::memory_order_relaxed);
+    U64 start = m_start > traceStart ? m_start - traceStart : 0;
+    TraceEvent event = { m_pName, m_pCategory, { m_pArgs[0], m_pArgs[1] }, { m_args[0], m_args[1] },
+                         start, end - m_start };
+    TraceBuffer& buffer = getTraceBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.events.push_back(event);
+}
+
+static void writeTraceString(FILE* fp, const char* pString)
+{
+    fputc('"', fp);
+    for (const char* p = pString; *p; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(fp, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)*p);
+        else
+            fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+B32 endTrace(const std::string& filename)
+{
+    s_tracing = 0;
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (!fp)
+        return false;
+
+    // Timestamps are in microseconds, a thread's events are sorted by the viewer.
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"RayTracer\"}}");
+    std::lock_guard<std::mutex> guard(s_traceLock);
+    for (std::shared_ptr<TraceBuffer>& pBuffer : s_traceBuffers)
+    {
+        std::lock_guard<std::mutex> bufferGuard(pBuffer->lock);
+        if (pBuffer->events.empty())
+            continue;
+        if (!pBuffer->name.empty())
+        {
+            fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", pBuffer->tid);
+            writeTraceString(fp, pBuffer->name.c_str());
+            fprintf(fp, "}}");
+        }
+        for (const TraceEvent& event : pBuffer->events)
+        {
+            fprintf(fp, ",\n{\"name\":");
+            writeTraceString(fp, event.pName);
+            fprintf(fp, ",\"cat\":");
+            writeTraceString(fp, event.pCategory);
+            fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", pBuffer->tid,
+                    (F64)event.start * 1e-3, (F64)event.duration * 1e-3);
+            if (event.pArgs[0])
+            {
+                fprintf(fp, ",\"args\":{");
+                writeTraceString(fp, event.pArgs[0]);
+                fprintf(fp, ":%lld", (long long)event.args[0]);
+                if (event.pArgs[1])
+                {
+                    fprintf(fp, ",");
+                    writeTraceString(fp, event.pArgs[1]);
+                    fprintf(fp, ":%lld", (long long)event.args[1]);
+                }
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "}");
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    B32 ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+} // rt
\ No newline at end of file
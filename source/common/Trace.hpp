@@ -0,0 +1,54 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <string>
+
+namespace rt {
+
+
+// Timeline of scoped events over every thread, written out in the Chrome trace event format
+// that chrome://tracing and Perfetto open. Scopes cost a clock read and a flag check while
+// no trace is being recorded, so they're meant for coarse work such as phases and tiles.
+
+// Start recording, dropping whatever was recorded before.
+void beginTrace();
+
+// Stop recording, and write the events as JSON. Threads still running should be idle.
+B32 endTrace(const std::string& filename);
+
+B32 isTracing();
+
+// Name shown for the calling thread's row on the timeline. Must outlive the thread.
+void setTraceThreadName(const char* pName);
+
+// Records the time between its construction and destruction as one event on the calling
+// thread. Names and argument names must outlive the trace, string literals are best.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* pName, const char* pCategory = "render")
+        : TraceScope(pName, pCategory, nullptr, 0, nullptr, 0) { }
+
+    // With up to two integer arguments shown with the event, such as a tile's coordinates.
+    TraceScope(const char* pName, const char* pCategory, const char* pArg0, I64 arg0,
+               const char* pArg1 = nullptr, I64 arg1 = 0);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_pName;
+    const char* m_pCategory;
+    const char* m_pArgs[2];
+    I64         m_args[2];
+    U64         m_start;
+    B32         m_active;
+};
+
+#define RT_TRACE_CONCAT_(a, b) a##b
+#define RT_TRACE_CONCAT(a, b) RT_TRACE_CONCAT_(a, b)
+#define RT_TRACE_SCOPE(...) rt::TraceScope RT_TRACE_CONCAT(traceScope_, __LINE__)(__VA_ARGS__)
+} // rt
\ No newline at end of file
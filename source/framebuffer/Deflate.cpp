@@ -0,0 +1,573 @@
+// Raytracer.
+#include "Deflate.hpp"
+
+#include "common/Threading.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <string.h>
+
+namespace rt {
+
+
+static const U32 kAdlerBase         = 65521;
+static const U32 kWindowSize        = 32768;
+static const U32 kHashBits          = 15;
+static const U32 kMaxChain          = 32;
+// Stop searching once a match is this long, it's unlikely to get much better.
+static const U32 kNiceMatch         = 128;
+static const U32 kMinMatch          = 3;
+static const U32 kMaxMatch          = 258;
+static const U32 kMaxBlockTokens    = 1 << 16;
+static const U32 kMaxStoredBlock    = 65535;
+static const U64 kStripeSize        = 1 << 20;
+
+static const U32 kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const U32 kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const U32 kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const U32 kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// Order the code length code lengths are stored in.
+static const U32 kCodeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// A literal if dist is 0, otherwise a match of length litLen.
+struct Token
+{
+    U16 litLen;
+    U16 dist;
+};
+
+struct HuffmanCode
+{
+    U16 codes[288];
+    U8  lengths[288];
+};
+
+class BitWriter
+{
+public:
+    BitWriter(std::vector<U8>& out)
+        : m_out(out), m_bits(0), m_count(0) { }
+
+    void put(U32 value, U32 n)
+    {
+        m_bits |= (U64)value << m_count;
+        m_count += n;
+        while (m_count >= 8)
+        {
+            m_out.push_back((U8)(m_bits & 0xff));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void align()
+    {
+        if (m_count > 0)
+            put(0, 8 - m_count);
+    }
+
+private:
+    std::vector<U8>&    m_out;
+    U64                 m_bits;
+    U32                 m_count;
+};
+
+static U32 lengthSymbol(U32 length)
+{
+    U32 i = 28;
+    while (kLengthBase[i] > length) --i;
+    return i;
+}
+
+static U32 distSymbol(U32 dist)
+{
+    U32 i = 29;
+    while (kDistBase[i] > dist) --i;
+    return i;
+}
+
+static U32 reverseBits(U32 code, U32 length)
+{
+    U32 r = 0;
+    for (U32 i = 0; i < length; ++i)
+    {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+// Canonical codes from code lengths, bit reversed since deflate writes codes from the top bit down.
+static void buildCodes(const U8* lengths, U32 n, U16* codes)
+{
+    U32 blCount[16] = { };
+    for (U32 i = 0; i < n; ++i)
+        blCount[(unsigned char)lengths[i]]++;
+    blCount[0] = 0;
+    U32 nextCode[16] = { };
+    U32 code = 0;
+    for (U32 bits = 1; bits < 16; ++bits)
+    {
+        code = (code + blCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+    for (U32 i = 0; i < n; ++i)
+        codes[i] = lengths[i] ? (U16)reverseBits(nextCode[(unsigned char)lengths[i]]++, lengths[i]) : 0;
+}
+
+// Huffman code lengths limited to maxLength bits. If the tree comes out too deep, the
+// frequencies are flattened and it's built again, which converges quickly in practice.
+static void buildLengths(const U32* freqs, U32 n, U32 maxLength, U8* lengths)
+{
+    std::vector<U32> f(freqs, freqs + n);
+    // Make sure there are always two codes, so the code is complete.
+    U32 used = 0;
+    for (U32 i = 0; i < n; ++i)
+        used += f[i] ? 1 : 0;
+    for (U32 i = 0; i < n && used < 2; ++i)
+    {
+        if (!f[i])
+        {
+            f[i] = 1;
+            ++used;
+        }
+    }
+
+    std::vector<I32> parent(2 * n);
+    while (true)
+    {
+        typedef std::pair<U64, I32> Node;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+        for (U32 i = 0; i < n; ++i)
+            if (f[i]) heap.push(Node(f[i], (I32)i));
+        I32 next = (I32)n;
+        while (heap.size() > 1)
+        {
+            Node a = heap.top(); heap.pop();
+            Node b = heap.top(); heap.pop();
+            parent[a.second] = next;
+            parent[b.second] = next;
+            heap.push(Node(a.first + b.first, next++));
+        }
+        I32 root = heap.top().second;
+
+        U32 maxDepth = 0;
+        for (U32 i = 0; i < n; ++i)
+        {
+            U32 depth = 0;
+            if (f[i])
+                for (I32 node = (I32)i; node != root; node = parent[node])
+                    ++depth;
+            lengths[i] = (U8)depth;
+            maxDepth = std::max(maxDepth, depth);
+        }
+        if (maxDepth <= maxLength)
+            break;
+        for (U32 i = 0; i < n; ++i)
+            if (f[i]) f[i] = (f[i] + 1) / 2;
+    }
+}
+
+static const HuffmanCode& getFixedLitCode()
+{
+    static HuffmanCode code = [] () -> HuffmanCode {
+        HuffmanCode c = { };
+        for (U32 i = 0; i < 288; ++i)
+            c.lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+        buildCodes(c.lengths, 288, c.codes);
+        return c;
+    } ();
+    return code;
+}
+
+static const HuffmanCode& getFixedDistCode()
+{
+    static HuffmanCode code = [] () -> HuffmanCode {
+        HuffmanCode c = { };
+        for (U32 i = 0; i < 30; ++i)
+            c.lengths[i] = 5;
+        buildCodes(c.lengths, 30, c.codes);
+        return c;
+    } ();
+    return code;
+}
+
+static void writeTokens(BitWriter& bw, const std::vector<Token>& tokens,
+                        const HuffmanCode& lit, const HuffmanCode& dist)
+{
+    for (const Token& token : tokens)
+    {
+        if (token.dist == 0)
+        {
+            bw.put(lit.codes[token.litLen], lit.lengths[token.litLen]);
+            continue;
+        }
+        U32 ls = lengthSymbol(token.litLen);
+        bw.put(lit.codes[257 + ls], lit.lengths[257 + ls]);
+        bw.put(token.litLen - kLengthBase[ls], kLengthExtra[ls]);
+        U32 ds = distSymbol(token.dist);
+        bw.put(dist.codes[ds], dist.lengths[ds]);
+        bw.put(token.dist - kDistBase[ds], kDistExtra[ds]);
+    }
+    bw.put(lit.codes[256], lit.lengths[256]);
+}
+
+static void writeStored(BitWriter& bw, const U8* pData, U64 size, B32 final)
+{
+    do
+    {
+        U32 n = (U32)std::min<U64>(size, kMaxStoredBlock);
+        size -= n;
+        bw.put(final && size == 0 ? 1 : 0, 1);
+        bw.put(0, 2);
+        bw.align();
+        bw.put(n & 0xffff, 16);
+        bw.put(~n & 0xffff, 16);
+        for (U32 i = 0; i < n; ++i)
+            bw.put((unsigned char)pData[i], 8);
+        pData += n;
+    } while (size > 0);
+}
+
+// Write a block covering pData[0, size), picking whichever of dynamic, fixed or stored is smallest.
+static void writeBlock(BitWriter& bw, const std::vector<Token>& tokens, const U8* pData, U64 size, B32 final)
+{
+    U32 litFreq[286] = { };
+    U32 distFreq[30] = { };
+    U64 extraBits = 0;
+    for (const Token& token : tokens)
+    {
+        if (token.dist == 0)
+        {
+            litFreq[token.litLen]++;
+            continue;
+        }
+        U32 ls = lengthSymbol(token.litLen);
+        U32 ds = distSymbol(token.dist);
+        litFreq[257 + ls]++;
+        distFreq[ds]++;
+        extraBits += kLengthExtra[ls] + kDistExtra[ds];
+    }
+    litFreq[256] = 1;
+
+    HuffmanCode lit = { };
+    HuffmanCode dist = { };
+    buildLengths(litFreq, 286, 15, lit.lengths);
+    buildLengths(distFreq, 30, 15, dist.lengths);
+    buildCodes(lit.lengths, 286, lit.codes);
+    buildCodes(dist.lengths, 30, dist.codes);
+
+    U32 hlit = 286;
+    while (hlit > 257 && lit.lengths[hlit - 1] == 0) --hlit;
+    U32 hdist = 30;
+    while (hdist > 1 && dist.lengths[hdist - 1] == 0) --hdist;
+
+    // Run length encode the code lengths, with 16 repeating the previous length
+    // 3-6 times, and 17, 18 runs of 3-10 and 11-138 zeros.
+    U8 all[286 + 30];
+    U32 count = 0;
+    for (U32 i = 0; i < hlit; ++i) all[count++] = lit.lengths[i];
+    for (U32 i = 0; i < hdist; ++i) all[count++] = dist.lengths[i];
+    std::vector<U32> rle;
+    U32 clFreq[19] = { };
+    for (U32 i = 0; i < count;)
+    {
+        U32 run = 1;
+        while (i + run < count && all[i + run] == all[i]) ++run;
+        if (all[i] == 0 && run >= 3)
+        {
+            run = std::min<U32>(run, 138);
+            U32 sym = run >= 11 ? 18 : 17;
+            rle.push_back(sym | ((run - (sym == 18 ? 11 : 3)) << 8));
+            clFreq[sym]++;
+        }
+        else if (all[i] != 0 && run >= 4)
+        {
+            run = std::min<U32>(run, 7);
+            rle.push_back(all[i]);
+            rle.push_back(16 | ((run - 4) << 8));
+            clFreq[(unsigned char)all[i]]++;
+            clFreq[16]++;
+        }
+        else
+        {
+            run = 1;
+            rle.push_back(all[i]);
+            clFreq[(unsigned char)all[i]]++;
+        }
+        i += run;
+    }
+    HuffmanCode cl = { };
+    buildLengths(clFreq, 19, 7, cl.lengths);
+    buildCodes(cl.lengths, 19, cl.codes);
+    U32 hclen = 19;
+    while (hclen > 4 && cl.lengths[kCodeLengthOrder[hclen - 1]] == 0) --hclen;
+
+    const HuffmanCode& fixedLit = getFixedLitCode();
+    const HuffmanCode& fixedDist = getFixedDistCode();
+    U64 dynamicBits = 3 + 14 + 3 * hclen + extraBits;
+    U64 fixedBits = 3 + extraBits;
+    for (U32 sym : rle)
+    {
+        U32 s = sym & 0xff;
+        dynamicBits += cl.lengths[s] + (s == 16 ? 2 : (s == 17 ? 3 : (s == 18 ? 7 : 0)));
+    }
+    for (U32 i = 0; i < 286; ++i)
+    {
+        dynamicBits += (U64)litFreq[i] * lit.lengths[i];
+        fixedBits += (U64)litFreq[i] * fixedLit.lengths[i];
+    }
+    for (U32 i = 0; i < 30; ++i)
+    {
+        dynamicBits += (U64)distFreq[i] * dist.lengths[i];
+        fixedBits += (U64)distFreq[i] * fixedDist.lengths[i];
+    }
+    U64 storedBits = (size + 5 * (size / kMaxStoredBlock + 1)) * 8 + 7;
+
+    if (storedBits < dynamicBits && storedBits < fixedBits)
+    {
+        writeStored(bw, pData, size, final);
+    }
+    else if (fixedBits <= dynamicBits)
+    {
+        bw.put(final ? 1 : 0, 1);
+        bw.put(1, 2);
+        writeTokens(bw, tokens, fixedLit, fixedDist);
+    }
+    else
+    {
+        bw.put(final ? 1 : 0, 1);
+        bw.put(2, 2);
+        bw.put(hlit - 257, 5);
+        bw.put(hdist - 1, 5);
+        bw.put(hclen - 4, 4);
+        for (U32 i = 0; i < hclen; ++i)
+            bw.put(cl.lengths[kCodeLengthOrder[i]], 3);
+        for (U32 sym : rle)
+        {
+            U32 s = sym & 0xff;
+            bw.put(cl.codes[s], cl.lengths[s]);
+            if (s == 16) bw.put(sym >> 8, 2);
+            else if (s == 17) bw.put(sym >> 8, 3);
+            else if (s == 18) bw.put(sym >> 8, 7);
+        }
+        writeTokens(bw, tokens, lit, dist);
+    }
+}
+
+static U32 hash3(const unsigned char* p)
+{
+    U32 v = ((U32)p[0] << 16) | ((U32)p[1] << 8) | (U32)p[2];
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+U32 adler32(U32 adler, const U8* pData, U64 size)
+{
+    const unsigned char* p = (const unsigned char*)pData;
+    U32 a = adler & 0xffff;
+    U32 b = adler >> 16;
+    while (size > 0)
+    {
+        // Largest run that can't overflow 32 bits before taking the modulo.
+        U64 n = std::min<U64>(size, 5552);
+        size -= n;
+        for (U64 i = 0; i < n; ++i)
+        {
+            a += p[i];
+            b += a;
+        }
+        p += n;
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+    }
+    return (b << 16) | a;
+}
+
+U32 adler32Combine(U32 adler1, U32 adler2, U64 size2)
+{
+    U32 rem = (U32)(size2 % kAdlerBase);
+    U32 sum1 = adler1 & 0xffff;
+    U32 sum2 = (U32)(((U64)rem * sum1) % kAdlerBase);
+    sum1 += (adler2 & 0xffff) + kAdlerBase - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - rem;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum2 >= (kAdlerBase << 1)) sum2 -= (kAdlerBase << 1);
+    if (sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return (sum2 << 16) | sum1;
+}
+
+U32 crc32(U32 crc, const U8* pData, U64 size)
+{
+    static const std::vector<U32> table = [] () -> std::vector<U32> {
+        std::vector<U32> t(256);
+        for (U32 n = 0; n < 256; ++n)
+        {
+            U32 c = n;
+            for (U32 k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    } ();
+    const unsigned char* p = (const unsigned char*)pData;
+    crc = ~crc;
+    for (U64 i = 0; i < size; ++i)
+        crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void deflateStripe(const U8* pData, U64 size, B32 last, std::vector<U8>& out)
+{
+    BitWriter bw(out);
+    if (size == 0)
+    {
+        if (last)
+        {
+            // Final fixed block holding only the end of block code.
+            bw.put(1, 1);
+            bw.put(1, 2);
+            bw.put(0, 7);
+        }
+    }
+    else
+    {
+        const unsigned char* p = (const unsigned char*)pData;
+        std::vector<I32> head(1 << kHashBits, -1);
+        std::vector<I32> prev(size);
+        std::vector<Token> tokens;
+        tokens.reserve(kMaxBlockTokens);
+        U64 blockStart = 0;
+
+        auto insert = [&] (U64 i) -> void {
+            if (i + kMinMatch > size)
+                return;
+            U32 h = hash3(p + i);
+            prev[i] = head[h];
+            head[h] = (I32)i;
+        };
+
+        for (U64 i = 0; i < size;)
+        {
+            U32 bestLength = 0;
+            U32 bestDist = 0;
+            if (i + kMinMatch <= size)
+            {
+                U32 maxLength = (U32)std::min<U64>(kMaxMatch, size - i);
+                I32 candidate = head[hash3(p + i)];
+                for (U32 chain = 0; candidate >= 0 && chain < kMaxChain; ++chain)
+                {
+                    U64 dist = i - (U64)candidate;
+                    if (dist > kWindowSize)
+                        break;
+                    const unsigned char* a = p + candidate;
+                    const unsigned char* b = p + i;
+                    if (a[bestLength] == b[bestLength])
+                    {
+                        U32 length = 0;
+                        while (length < maxLength && a[length] == b[length]) ++length;
+                        if (length > bestLength)
+                        {
+                            bestLength = length;
+                            bestDist = (U32)dist;
+                            if (length >= kNiceMatch || length == maxLength)
+                                break;
+                        }
+                    }
+                    candidate = prev[candidate];
+                }
+            }
+
+            if (bestLength >= kMinMatch)
+            {
+                tokens.push_back({ (U16)bestLength, (U16)bestDist });
+                for (U64 j = 0; j < bestLength; ++j)
+                    insert(i + j);
+                i += bestLength;
+            }
+            else
+            {
+                tokens.push_back({ (U16)p[i], 0 });
+                insert(i);
+                ++i;
+            }
+
+            if (tokens.size() >= kMaxBlockTokens || i == size)
+            {
+                writeBlock(bw, tokens, pData + blockStart, i - blockStart, last && i == size);
+                tokens.clear();
+                blockStart = i;
+            }
+        }
+    }
+
+    if (!last)
+    {
+        // Sync flush, an empty stored block that leaves us on a byte boundary.
+        bw.put(0, 1);
+        bw.put(0, 2);
+        bw.align();
+        bw.put(0x0000, 16);
+        bw.put(0xffff, 16);
+    }
+    bw.align();
+}
+
+void zlibBegin(std::vector<U8>& out)
+{
+    // Deflate with a 32K window, no preset dictionary.
+    out.push_back((U8)0x78);
+    out.push_back((U8)0x5e);
+}
+
+void zlibEnd(U32 adler, std::vector<U8>& out)
+{
+    out.push_back((U8)(adler >> 24));
+    out.push_back((U8)(adler >> 16));
+    out.push_back((U8)(adler >> 8));
+    out.push_back((U8)adler);
+}
+
+void zlibCompress(const U8* pData, U64 size, std::vector<U8>& out)
+{
+    U32 stripeCount = (U32)std::max<U64>((size + kStripeSize - 1) / kStripeSize, 1);
+    std::vector<std::vector<U8>> stripes(stripeCount);
+    std::vector<U32> adlers(stripeCount);
+
+    U32 workerCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), stripeCount);
+    dispatch({[&] (const ThreadID& id) -> void {
+        for (U32 i = (U32)id.global.x; i < stripeCount; i += workerCount)
+        {
+            U64 begin = (U64)i * kStripeSize;
+            U64 n = std::min(kStripeSize, size - std::min(size, begin));
+            adlers[i] = adler32(1, pData + begin, n);
+            deflateStripe(pData + begin, n, i == stripeCount - 1, stripes[i]);
+        }
+    }, 1, 1, 1 }, workerCount, 1, 1);
+
+    zlibBegin(out);
+    U32 adler = adlers[0];
+    out.insert(out.end(), stripes[0].begin(), stripes[0].end());
+    for (U32 i = 1; i < stripeCount; ++i)
+    {
+        U64 n = std::min(kStripeSize, size - (U64)i * kStripeSize);
+        adler = adler32Combine(adler, adlers[i], n);
+        out.insert(out.end(), stripes[i].begin(), stripes[i].end());
+    }
+    zlibEnd(adler, out);
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,34 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <vector>
+
+namespace rt {
+
+
+// Zlib compatible compression, split into stripes that can be compressed independently.
+// Every stripe but the last ends on a byte boundary with an empty stored block (a sync flush),
+// so stripes compressed on different threads only need to be concatenated between a zlib
+// header and the adler32 of the whole input. Stripes don't share their match window,
+// which costs a little compression at the seams.
+
+// Checksums. Start adler32 at 1, and crc32 at 0.
+U32     adler32(U32 adler, const U8* pData, U64 size);
+U32     crc32(U32 crc, const U8* pData, U64 size);
+
+// Adler32 of two buffers back to back, from the checksum of each and the size of the second.
+U32     adler32Combine(U32 adler1, U32 adler2, U64 size2);
+
+// Compress a stripe into raw deflate blocks, appended to out. Only the last
+// stripe of a stream marks its final block.
+void    deflateStripe(const U8* pData, U64 size, B32 last, std::vector<U8>& out);
+
+// Zlib framing around the stripes.
+void    zlibBegin(std::vector<U8>& out);
+void    zlibEnd(U32 adler, std::vector<U8>& out);
+
+// Compress a whole buffer into a zlib stream, splitting it over several threads if it is large.
+void    zlibCompress(const U8* pData, U64 size, std::vector<U8>& out);
+} // rt
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "math/Float.hpp"
 
 #include <string>
+#include <vector>
 
 namespace rt {
 
@@ -19,7 +20,8 @@ public:
 
     virtual ~Image() { }
 
-    virtual void saveBuffer(const ImageBuffer* pBuf, U32 width, U32 height, U32 channels) = 0;
+    // False if the file couldn't be written.
+    virtual B32 saveBuffer(const ImageBuffer* pBuf, U32 width, U32 height, U32 channels) = 0;
 
     const std::string& getFilename() const { return m_filename; }
 private:
@@ -27,10 +29,28 @@ private:
 };
 
 
+enum class ImageFormat
+{
+    PNG,
+    // Half float OpenEXR, zip compressed. The integrator writes its HDR radiance.
+    EXR
+};
+
 Image* createTGA();
 Image* createPNG(const std::string& filename);
+Image* createEXR(const std::string& filename);
 Image* createJPG();
 
+// Create a writer for the given format.
+Image*      createImage(ImageFormat format, const std::string& filename);
+
+// Guess the format from the file extension, PNG if it isn't one we know.
+ImageFormat getImageFormat(const std::string& filename);
+
+// Read a Radiance RGBE (.hdr) image into linear float RGB, top row first.
+// Returns false if the file can not be read or is not an RGBE image.
+B32     loadHDR(const std::string& filename, U32& width, U32& height, std::vector<Float3>& pixels);
+
 static void    destroyImage(Image* image)
 {
     if (image)
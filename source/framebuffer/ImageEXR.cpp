@@ -0,0 +1,433 @@
+// Raytracer.
+#include "ImageEXR.hpp"
+#include "Image.hpp"
+#include "Deflate.hpp"
+#include "RenderTarget.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+namespace rt {
+
+
+static const U32 kExrMagic          = 20000630;
+static const U32 kExrVersion        = 2;
+static const U32 kExrTiledFlag      = 0x200;
+static const U8  kExrNoCompression  = 0;
+static const U8  kExrZipCompression = 3;
+static const U8  kExrIncreasingY    = 0;
+static const U8  kExrRandomY        = 2;
+static const U32 kExrZipLines       = 16;
+
+static B32 seekFile(FILE* fp, U64 offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(fp, (I64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// All integers in an EXR file are little endian.
+static void putU32(std::vector<U8>& out, U32 v)
+{
+    for (U32 i = 0; i < 4; ++i)
+        out.push_back((U8)(v >> (i * 8)));
+}
+
+static void putF32(std::vector<U8>& out, F32 f)
+{
+    U32 v;
+    memcpy(&v, &f, sizeof(F32));
+    putU32(out, v);
+}
+
+static void putString(std::vector<U8>& out, const std::string& s)
+{
+    out.insert(out.end(), s.begin(), s.end());
+    out.push_back(0);
+}
+
+static void putAttribute(std::vector<U8>& out, const char* name, const char* type, const std::vector<U8>& value)
+{
+    putString(out, name);
+    putString(out, type);
+    putU32(out, (U32)value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+static std::vector<U8> makeBox(U32 width, U32 height)
+{
+    std::vector<U8> box;
+    putU32(box, 0);
+    putU32(box, 0);
+    putU32(box, width - 1);
+    putU32(box, height - 1);
+    return box;
+}
+
+U16 floatToHalf(F32 f)
+{
+    U32 x;
+    memcpy(&x, &f, sizeof(F32));
+    U32 sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    U32 h;
+    if (x >= 0x47800000)
+    {
+        // Too large for a half, or already infinite or NaN.
+        h = x > 0x7f800000 ? 0x7e00 : 0x7c00;
+    }
+    else if (x < 0x38800000)
+    {
+        // Denormal or zero. Adding 0.5 lines the mantissa up with the half's,
+        // and lets the fpu do the rounding.
+        F32 a;
+        memcpy(&a, &x, sizeof(F32));
+        a += 0.5f;
+        memcpy(&h, &a, sizeof(F32));
+        h -= 0x3f000000;
+    }
+    else
+    {
+        U32 mantissaOdd = (x >> 13) & 1;
+        // Rebias the exponent, then round to nearest even.
+        x -= 112u << 23;
+        x += 0xfff + mantissaOdd;
+        h = x >> 13;
+    }
+    return (U16)(h | sign);
+}
+
+ExrWriter::ExrWriter()
+    : m_file(nullptr)
+    , m_width(0)
+    , m_height(0)
+    , m_tileSize(0)
+    , m_linesPerChunk(1)
+    , m_compression(ExrCompression::None)
+    , m_pixelSize(0)
+    , m_offsetTablePos(0)
+    , m_fileEnd(0)
+    , m_nextLine(0)
+{
+}
+
+ExrWriter::~ExrWriter()
+{
+    close();
+}
+
+B32 ExrWriter::open(const std::string& filename, U32 width, U32 height, const std::vector<std::string>& channels,
+                    ExrCompression compression, U32 tileSize, const std::vector<ExrPixelType>& types)
+{
+    close();
+    if (width == 0 || height == 0 || channels.empty())
+        return false;
+
+    m_file = fopen(filename.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_tileSize = tileSize;
+    m_compression = compression;
+    m_linesPerChunk = (compression == ExrCompression::Zip) ? kExrZipLines : 1;
+    m_nextLine = 0;
+    m_pendingLines.clear();
+
+    // The file stores channels in alphabetical order.
+    m_channelSource.resize(channels.size());
+    std::iota(m_channelSource.begin(), m_channelSource.end(), 0u);
+    std::sort(m_channelSource.begin(), m_channelSource.end(),
+              [&] (U32 a, U32 b) -> bool { return channels[a] < channels[b]; });
+    m_channels.clear();
+    m_types.clear();
+    m_pixelSize = 0;
+    for (U32 source : m_channelSource)
+    {
+        m_channels.push_back(channels[source]);
+        m_types.push_back(source < types.size() ? types[source] : ExrPixelType::Half);
+        m_pixelSize += m_types.back() == ExrPixelType::Half ? 2 : 4;
+    }
+
+    std::vector<U8> header;
+    putU32(header, kExrMagic);
+    putU32(header, kExrVersion | (isTiled() ? kExrTiledFlag : 0));
+
+    std::vector<U8> chlist;
+    for (U32 c = 0; c < m_channels.size(); ++c)
+    {
+        putString(chlist, m_channels[c]);
+        putU32(chlist, (U32)m_types[c]);
+        putU32(chlist, 0);  // pLinear and reserved.
+        putU32(chlist, 1);  // x sampling.
+        putU32(chlist, 1);  // y sampling.
+    }
+    chlist.push_back(0);
+    putAttribute(header, "channels", "chlist", chlist);
+    putAttribute(header, "compression", "compression",
+                 { (U8)(compression == ExrCompression::Zip ? kExrZipCompression : kExrNoCompression) });
+    putAttribute(header, "dataWindow", "box2i", makeBox(width, height));
+    putAttribute(header, "displayWindow", "box2i", makeBox(width, height));
+    // Tiles land in whatever order they finish in.
+    putAttribute(header, "lineOrder", "lineOrder", { isTiled() ? kExrRandomY : kExrIncreasingY });
+    std::vector<U8> one;
+    putF32(one, 1.f);
+    putAttribute(header, "pixelAspectRatio", "float", one);
+    std::vector<U8> center;
+    putF32(center, 0.f);
+    putF32(center, 0.f);
+    putAttribute(header, "screenWindowCenter", "v2f", center);
+    putAttribute(header, "screenWindowWidth", "float", one);
+    if (isTiled())
+    {
+        std::vector<U8> tiles;
+        putU32(tiles, tileSize);
+        putU32(tiles, tileSize);
+        tiles.push_back(0); // One level, round down.
+        putAttribute(header, "tiles", "tiledesc", tiles);
+    }
+    header.push_back(0);
+
+    U32 chunkCount = isTiled() ? getTilesX() * getTilesY() : (height + m_linesPerChunk - 1) / m_linesPerChunk;
+    m_offsets.assign(chunkCount, 0);
+    m_offsetTablePos = header.size();
+    // Room for the offsets, filled in once every chunk is written.
+    header.resize(header.size() + chunkCount * sizeof(U64), 0);
+    m_fileEnd = header.size();
+    if (fwrite(header.data(), 1, header.size(), m_file) != header.size())
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ExrWriter::encode(const F32* pPixels, U32 width, U32 height, std::vector<U8>& out) const
+{
+    U32 channelCount = (U32)m_channels.size();
+    std::vector<U8> raw((U64)width * height * m_pixelSize);
+    U8* p = raw.data();
+    // Each line holds every channel in turn, one after another.
+    for (U32 y = 0; y < height; ++y)
+    {
+        for (U32 c = 0; c < channelCount; ++c)
+        {
+            const F32* pLine = pPixels + (U64)y * width * channelCount + m_channelSource[c];
+            for (U32 x = 0; x < width; ++x)
+            {
+                F32 f = pLine[(U64)x * channelCount];
+                if (m_types[c] == ExrPixelType::Half)
+                {
+                    U16 h = floatToHalf(f);
+                    *p++ = (U8)(h & 0xff);
+                    *p++ = (U8)(h >> 8);
+                }
+                else
+                {
+                    U32 v;
+                    memcpy(&v, &f, sizeof(F32));
+                    for (U32 i = 0; i < 4; ++i)
+                        *p++ = (U8)(v >> (i * 8));
+                }
+            }
+        }
+    }
+
+    if (m_compression == ExrCompression::None)
+    {
+        out.swap(raw);
+        return;
+    }
+
+    // Split low and high bytes into two halves, then delta code them, which
+    // turns smooth half floats into long runs for the compressor.
+    U64 size = raw.size();
+    std::vector<U8> reordered(size);
+    U64 half = (size + 1) / 2;
+    for (U64 i = 0; i < size; ++i)
+        reordered[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+    unsigned char prev = (unsigned char)reordered[0];
+    for (U64 i = 1; i < size; ++i)
+    {
+        unsigned char v = (unsigned char)reordered[i];
+        reordered[i] = (U8)(unsigned char)(v - prev + 128);
+        prev = v;
+    }
+
+    std::vector<U8> compressed;
+    zlibBegin(compressed);
+    deflateStripe(reordered.data(), size, true, compressed);
+    zlibEnd(adler32(1, reordered.data(), size), compressed);
+    // Readers take data as stored whenever it isn't any smaller.
+    if (compressed.size() < size)
+        out.swap(compressed);
+    else
+        out.swap(raw);
+}
+
+B32 ExrWriter::writeChunk(U32 chunk, const std::vector<U8>& header, const std::vector<U8>& data)
+{
+    std::vector<U8> prefix(header);
+    putU32(prefix, (U32)data.size());
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_file || chunk >= m_offsets.size())
+        return false;
+    if (!seekFile(m_file, m_fileEnd))
+        return false;
+    B32 ok = fwrite(prefix.data(), 1, prefix.size(), m_file) == prefix.size() &&
+             fwrite(data.data(), 1, data.size(), m_file) == data.size();
+    if (ok)
+    {
+        m_offsets[chunk] = m_fileEnd;
+        m_fileEnd += prefix.size() + data.size();
+    }
+    return ok;
+}
+
+B32 ExrWriter::writeTile(U32 tileX, U32 tileY, const F32* pPixels)
+{
+    if (!isTiled() || tileX >= getTilesX() || tileY >= getTilesY() || !pPixels)
+        return false;
+
+    U32 width = std::min(m_tileSize, m_width - tileX * m_tileSize);
+    U32 height = std::min(m_tileSize, m_height - tileY * m_tileSize);
+    std::vector<U8> data;
+    encode(pPixels, width, height, data);
+
+    std::vector<U8> header;
+    putU32(header, tileX);
+    putU32(header, tileY);
+    putU32(header, 0);  // Level x.
+    putU32(header, 0);  // Level y.
+    return writeChunk(tileY * getTilesX() + tileX, header, data);
+}
+
+B32 ExrWriter::writeScanlines(U32 y, U32 count, const F32* pPixels)
+{
+    if (isTiled() || y != m_nextLine || y + count > m_height || !pPixels)
+        return false;
+
+    U64 lineFloats = (U64)m_width * m_channels.size();
+    m_pendingLines.insert(m_pendingLines.end(), pPixels, pPixels + lineFloats * count);
+    m_nextLine += count;
+
+    U32 chunkStart = m_nextLine - (U32)(m_pendingLines.size() / lineFloats);
+    U32 written = 0;
+    while (m_pendingLines.size() / lineFloats - written >= m_linesPerChunk)
+    {
+        std::vector<U8> data;
+        encode(m_pendingLines.data() + written * lineFloats, m_width, m_linesPerChunk, data);
+        std::vector<U8> header;
+        putU32(header, chunkStart + written);
+        if (!writeChunk((chunkStart + written) / m_linesPerChunk, header, data))
+            return false;
+        written += m_linesPerChunk;
+    }
+    m_pendingLines.erase(m_pendingLines.begin(), m_pendingLines.begin() + written * lineFloats);
+    if (m_nextLine == m_height)
+        return flushScanlines();
+    return true;
+}
+
+B32 ExrWriter::flushScanlines()
+{
+    if (m_pendingLines.empty())
+        return true;
+    U64 lineFloats = (U64)m_width * m_channels.size();
+    U32 lines = (U32)(m_pendingLines.size() / lineFloats);
+    U32 y = m_nextLine - lines;
+    std::vector<U8> data;
+    encode(m_pendingLines.data(), m_width, lines, data);
+    m_pendingLines.clear();
+    std::vector<U8> header;
+    putU32(header, y);
+    return writeChunk(y / m_linesPerChunk, header, data);
+}
+
+B32 ExrWriter::close()
+{
+    if (!m_file)
+        return false;
+
+    B32 ok = true;
+    if (!isTiled())
+        ok = flushScanlines();
+
+    // A chunk left out would make the file unreadable, so fill the gaps with black.
+    for (U32 chunk = 0; chunk < m_offsets.size(); ++chunk)
+    {
+        if (m_offsets[chunk] != 0)
+            continue;
+        if (isTiled())
+        {
+            std::vector<F32> zeros((U64)m_tileSize * m_tileSize * m_channels.size(), 0.f);
+            ok = writeTile(chunk % getTilesX(), chunk / getTilesX(), zeros.data()) && ok;
+        }
+        else
+        {
+            U32 y = chunk * m_linesPerChunk;
+            U32 lines = std::min(m_linesPerChunk, m_height - y);
+            std::vector<F32> zeros((U64)m_width * lines * m_channels.size(), 0.f);
+            std::vector<U8> data;
+            encode(zeros.data(), m_width, lines, data);
+            std::vector<U8> header;
+            putU32(header, y);
+            ok = writeChunk(chunk, header, data) && ok;
+        }
+    }
+
+    std::vector<U8> table;
+    for (U64 offset : m_offsets)
+    {
+        putU32(table, (U32)offset);
+        putU32(table, (U32)(offset >> 32));
+    }
+    ok = ok && seekFile(m_file, m_offsetTablePos) && fwrite(table.data(), 1, table.size(), m_file) == table.size();
+    ok = (fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+    m_offsets.clear();
+    return ok;
+}
+
+// Writes an 8 bit display buffer as half floats in [0, 1]. Only for display buffers handed to
+// the image writer, frames rendered to EXR are written from their HDR radiance instead.
+class ImageEXR : public Image
+{
+public:
+    ImageEXR(const std::string& filename = "")
+        : Image(filename) { }
+
+    B32 saveBuffer(const ImageBuffer* pBuf, U32 width, U32 height, U32 channels) override
+    {
+        static const char* kNames[4] = { "R", "G", "B", "A" };
+        if (!pBuf || channels == 0 || channels > 4)
+            return false;
+        ExrWriter writer;
+        if (!writer.open(getFilename(), width, height,
+                         std::vector<std::string>(kNames, kNames + channels), ExrCompression::Zip))
+            return false;
+
+        const unsigned char* pPixels = (const unsigned char*)pBuf->getRaw();
+        std::vector<F32> line((U64)width * channels);
+        B32 ok = true;
+        for (U32 y = 0; y < height && ok; ++y)
+        {
+            for (U64 i = 0; i < line.size(); ++i)
+                line[i] = pPixels[(U64)y * width * channels + i] * (1.f / 255.f);
+            ok = writer.writeScanlines(y, 1, line.data());
+        }
+        return writer.close() && ok;
+    }
+};
+
+Image* createEXR(const std::string& filename)
+{
+    return new ImageEXR(filename);
+}
+} // rt
\ No newline at end of file
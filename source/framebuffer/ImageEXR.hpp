@@ -0,0 +1,93 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+
+enum class ExrCompression
+{
+    None,
+    // Zlib over 16 scanlines or one tile at a time, after a byte delta predictor.
+    Zip
+};
+
+// How a channel is stored in the file, values match the EXR pixel types.
+enum class ExrPixelType
+{
+    // Takes the bits of the float it is given as they are, so ids can pass through untouched.
+    UInt    = 0,
+    Half    = 1,
+    Float   = 2
+};
+
+// Streams a half float OpenEXR image to disk while it is being rendered, so nothing
+// close to the full image is ever held in memory, raw or encoded.
+//
+// Pixels are handed over as interleaved floats, in the channel order given to open(). In
+// tiled mode tiles can be written in any order and from any thread, they are encoded on the
+// caller's thread and appended as they come. In scanline mode lines must be written top to
+// bottom from a single thread, they are buffered until a whole chunk is ready.
+class ExrWriter
+{
+public:
+    ExrWriter();
+    ~ExrWriter();
+
+    // Tile size of 0 writes scanlines instead of tiles. Channels are stored as half
+    // floats, unless given a type of their own.
+    B32 open(const std::string& filename, U32 width, U32 height, const std::vector<std::string>& channels,
+             ExrCompression compression = ExrCompression::Zip, U32 tileSize = 0,
+             const std::vector<ExrPixelType>& types = std::vector<ExrPixelType>());
+
+    // Write the tile at tile coordinates (tileX, tileY). Tiles on the right and bottom
+    // edges are cropped to the image, and hold only the pixels that are inside it.
+    B32 writeTile(U32 tileX, U32 tileY, const F32* pPixels);
+
+    // Write count lines starting at y, which must follow the lines written so far.
+    B32 writeScanlines(U32 y, U32 count, const F32* pPixels);
+
+    // Write the chunk offsets and close the file. Tiles never written are filled with zeros.
+    B32 close();
+
+    B32 isTiled() const { return m_tileSize > 0; }
+    U32 getTileSize() const { return m_tileSize; }
+    U32 getTilesX() const { return m_tileSize ? (m_width + m_tileSize - 1) / m_tileSize : 0; }
+    U32 getTilesY() const { return m_tileSize ? (m_height + m_tileSize - 1) / m_tileSize : 0; }
+
+private:
+    // Convert, reorder and compress a block of pixels into the data of one chunk.
+    void encode(const F32* pPixels, U32 width, U32 height, std::vector<U8>& out) const;
+    B32 writeChunk(U32 chunk, const std::vector<U8>& header, const std::vector<U8>& data);
+    B32 flushScanlines();
+
+    FILE*                       m_file;
+    std::mutex                  m_lock;
+    U32                         m_width;
+    U32                         m_height;
+    U32                         m_tileSize;
+    U32                         m_linesPerChunk;
+    ExrCompression              m_compression;
+    // Channels sorted by name, as the file stores them, and where each
+    // one sits in the caller's interleaved pixels.
+    std::vector<std::string>    m_channels;
+    std::vector<ExrPixelType>   m_types;
+    std::vector<U32>            m_channelSource;
+    U32                         m_pixelSize;
+    U64                         m_offsetTablePos;
+    U64                         m_fileEnd;
+    std::vector<U64>            m_offsets;
+    // Lines waiting on the rest of their chunk.
+    std::vector<F32>            m_pendingLines;
+    U32                         m_nextLine;
+};
+
+// Float to half, rounding to nearest even.
+U16 floatToHalf(F32 f);
+} // rt
\ No newline at end of file
@@ -0,0 +1,129 @@
+// Raytracer.
+#include "Image.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace rt {
+
+
+static Float3 rgbeToFloat(const U8* rgbe)
+{
+    if (rgbe[3] == 0)
+        return Float3();
+    F32 f = ldexpf(1.0f, (I32)(unsigned char)rgbe[3] - (128 + 8));
+    return Float3((unsigned char)rgbe[0] * f, (unsigned char)rgbe[1] * f, (unsigned char)rgbe[2] * f);
+}
+
+static B32 readLine(FILE* fp, char* line, I32 maxLen)
+{
+    if (!fgets(line, maxLen, fp))
+        return false;
+    // Strip the new line.
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = '\0';
+    return true;
+}
+
+// Decode one scanline, either flat or with the adaptive run length encoding that
+// stores each of the four components separately.
+static B32 readScanline(FILE* fp, U32 width, std::vector<U8>& scanline)
+{
+    U8 header[4];
+    if (fread(header, 1, 4, fp) != 4)
+        return false;
+
+    B32 rle = width >= 8 && width < 0x8000 && header[0] == 2 && header[1] == 2 && 
+              (((unsigned char)header[2] << 8) | (unsigned char)header[3]) == (I32)width;
+    if (!rle)
+    {
+        memcpy(&scanline[0], header, 4);
+        return fread(&scanline[4], 1, (width - 1) * 4, fp) == (width - 1) * 4;
+    }
+
+    for (U32 c = 0; c < 4; ++c)
+    {
+        U32 x = 0;
+        while (x < width)
+        {
+            I32 count = fgetc(fp);
+            if (count == EOF)
+                return false;
+            if (count > 128)
+            {
+                // Run of a single value.
+                count -= 128;
+                I32 value = fgetc(fp);
+                if (value == EOF || x + count > width)
+                    return false;
+                for (I32 i = 0; i < count; ++i)
+                    scanline[(x++) * 4 + c] = (U8)value;
+            }
+            else
+            {
+                // Run of literal values.
+                if (count == 0 || x + count > width)
+                    return false;
+                for (I32 i = 0; i < count; ++i)
+                {
+                    I32 value = fgetc(fp);
+                    if (value == EOF)
+                        return false;
+                    scanline[(x++) * 4 + c] = (U8)value;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+B32 loadHDR(const std::string& filename, U32& width, U32& height, std::vector<Float3>& pixels)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    char line[512];
+    if (!readLine(fp, line, sizeof(line)) || 
+        (strncmp(line, "#?RADIANCE", 10) != 0 && strncmp(line, "#?RGBE", 6) != 0))
+    {
+        fclose(fp);
+        return false;
+    }
+
+    // Header ends with an empty line. We only support the RGBE pixel format.
+    B32 validFormat = true;
+    while (readLine(fp, line, sizeof(line)) && line[0] != '\0')
+    {
+        if (strncmp(line, "FORMAT=", 7) == 0 && strcmp(line + 7, "32-bit_rle_rgbe") != 0)
+            validFormat = false;
+    }
+
+    I32 w = 0, h = 0;
+    if (!validFormat || !readLine(fp, line, sizeof(line)) || 
+        sscanf(line, "-Y %d +X %d", &h, &w) != 2 || w <= 0 || h <= 0)
+    {
+        fclose(fp);
+        return false;
+    }
+
+    width = (U32)w;
+    height = (U32)h;
+    pixels.resize((U64)width * height);
+    std::vector<U8> scanline((U64)width * 4);
+    for (U32 y = 0; y < height; ++y)
+    {
+        if (!readScanline(fp, width, scanline))
+        {
+            fclose(fp);
+            return false;
+        }
+        for (U32 x = 0; x < width; ++x)
+            pixels[(U64)y * width + x] = rgbeToFloat(&scanline[(U64)x * 4]);
+    }
+    fclose(fp);
+    return true;
+}
+} // rt
\ No newline at end of file
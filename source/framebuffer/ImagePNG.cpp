@@ -1,23 +1,160 @@
 // Raytracer.
 #include "Image.hpp"
+#include "Deflate.hpp"
 
 #include "RenderTarget.hpp"
+#include "common/Threading.hpp"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION 1
-#include "stb_image_write.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
 
-namespace rt 
+namespace rt
 {
 
+// Fewest rows we bother compressing on their own thread.
+static const U32 kMinStripeRows = 16;
+
+static void putU32(std::vector<U8>& out, U32 v)
+{
+    out.push_back((U8)(v >> 24));
+    out.push_back((U8)(v >> 16));
+    out.push_back((U8)(v >> 8));
+    out.push_back((U8)v);
+}
+
+static void writeChunk(FILE* fp, const char* type, const std::vector<U8>& data)
+{
+    std::vector<U8> header;
+    putU32(header, (U32)data.size());
+    header.insert(header.end(), type, type + 4);
+    U32 crc = crc32(0, header.data() + 4, 4);
+    crc = crc32(crc, data.data(), data.size());
+    std::vector<U8> footer;
+    putU32(footer, crc);
+    fwrite(header.data(), 1, header.size(), fp);
+    fwrite(data.data(), 1, data.size(), fp);
+    fwrite(footer.data(), 1, footer.size(), fp);
+}
+
+static U32 paeth(I32 a, I32 b, I32 c)
+{
+    I32 p = a + b - c;
+    I32 pa = abs(p - a);
+    I32 pb = abs(p - b);
+    I32 pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (U32)a;
+    if (pb <= pc) return (U32)b;
+    return (U32)c;
+}
+
+// Filter a row with each of the five png filters, and keep the one with the smallest
+// sum of absolute values, which usually compresses best.
+static void filterRow(const unsigned char* row, const unsigned char* prevRow, U32 rowBytes, U32 bpp, U8* pOut)
+{
+    std::vector<U8> candidate(rowBytes);
+    U64 bestScore = ~0ULL;
+    for (U32 filter = 0; filter < 5; ++filter)
+    {
+        U64 score = 0;
+        for (U32 i = 0; i < rowBytes; ++i)
+        {
+            I32 a = i >= bpp ? row[i - bpp] : 0;
+            I32 b = prevRow ? prevRow[i] : 0;
+            I32 c = (prevRow && i >= bpp) ? prevRow[i - bpp] : 0;
+            U32 predict = 0;
+            switch (filter)
+            {
+            case 1: predict = (U32)a; break;
+            case 2: predict = (U32)b; break;
+            case 3: predict = (U32)((a + b) / 2); break;
+            case 4: predict = paeth(a, b, c); break;
+            default: break;
+            }
+            unsigned char v = (unsigned char)(row[i] - predict);
+            candidate[i] = (U8)v;
+            score += v < 128 ? v : 256 - v;
+        }
+        if (score < bestScore)
+        {
+            bestScore = score;
+            pOut[0] = (U8)filter;
+            std::copy(candidate.begin(), candidate.end(), pOut + 1);
+        }
+    }
+}
+
 class ImagePNG : public Image
 {
 public:
     ImagePNG(const std::string& filename = "")
         : Image(filename) { }
 
-    void saveBuffer(const ImageBuffer* pBuf, U32 width, U32 height, U32 channels) override
+    // Rows are split into stripes, which are filtered and deflated on separate threads
+    // and then stitched into one zlib stream.
+    B32 saveBuffer(const ImageBuffer* pBuf, U32 width, U32 height, U32 channels) override
     {
-        int err = stbi_write_png(getFilename().c_str(), width, height, channels, pBuf->getRaw(), width * channels);
+        if (!pBuf || width == 0 || height == 0 || channels == 0 || channels > 4)
+            return false;
+
+        FILE* fp = fopen(getFilename().c_str(), "wb");
+        if (!fp)
+            return false;
+
+        U32 rowBytes = width * channels;
+        U32 workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+        U32 stripeRows = std::max((height + workerCount - 1) / workerCount, kMinStripeRows);
+        U32 stripeCount = (height + stripeRows - 1) / stripeRows;
+        std::vector<std::vector<U8>> stripes(stripeCount);
+        std::vector<U32> adlers(stripeCount);
+        const unsigned char* pPixels = (const unsigned char*)pBuf->getRaw();
+
+        dispatch({[&] (const ThreadID& id) -> void {
+            U32 stripe = id.global.x;
+            U32 y0 = stripe * stripeRows;
+            U32 y1 = std::min(y0 + stripeRows, height);
+            std::vector<U8> filtered((U64)(y1 - y0) * (rowBytes + 1));
+            for (U32 y = y0; y < y1; ++y)
+            {
+                const unsigned char* row = pPixels + (U64)y * rowBytes;
+                filterRow(row, y > 0 ? row - rowBytes : nullptr, rowBytes, channels,
+                          &filtered[(U64)(y - y0) * (rowBytes + 1)]);
+            }
+            adlers[stripe] = adler32(1, filtered.data(), filtered.size());
+            deflateStripe(filtered.data(), filtered.size(), stripe == stripeCount - 1, stripes[stripe]);
+        }, 1, 1, 1 }, stripeCount, 1, 1);
+
+        static const U8 kSignature[8] = { (U8)0x89, 'P', 'N', 'G', '\r', '\n', (U8)0x1a, '\n' };
+        static const U8 kColorType[5] = { 0, 0, 4, 2, 6 };
+        fwrite(kSignature, 1, 8, fp);
+
+        std::vector<U8> ihdr;
+        putU32(ihdr, width);
+        putU32(ihdr, height);
+        ihdr.push_back(8);  // Bit depth.
+        ihdr.push_back((U8)kColorType[channels]);
+        ihdr.push_back(0);  // Deflate.
+        ihdr.push_back(0);  // Adaptive filtering.
+        ihdr.push_back(0);  // No interlace.
+        writeChunk(fp, "IHDR", ihdr);
+
+        // One IDAT per stripe, the decoder joins them back into a single stream.
+        U32 adler = adlers[0];
+        for (U32 i = 1; i < stripeCount; ++i)
+        {
+            U32 rows = std::min(stripeRows, height - i * stripeRows);
+            adler = adler32Combine(adler, adlers[i], (U64)rows * (rowBytes + 1));
+        }
+        std::vector<U8> first;
+        zlibBegin(first);
+        stripes[0].insert(stripes[0].begin(), first.begin(), first.end());
+        zlibEnd(adler, stripes.back());
+        for (U32 i = 0; i < stripeCount; ++i)
+            writeChunk(fp, "IDAT", stripes[i]);
+
+        writeChunk(fp, "IEND", std::vector<U8>());
+        B32 ok = ferror(fp) == 0;
+        return (fclose(fp) == 0) && ok;
     }
 };
 
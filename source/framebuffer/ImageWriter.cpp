@@ -0,0 +1,205 @@
+// Raytracer.
+#include "ImageWriter.hpp"
+#include "ImageEXR.hpp"
+#include "RenderTarget.hpp"
+
+#include "common/Trace.hpp"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace rt {
+
+
+Image* createImage(ImageFormat format, const std::string& filename)
+{
+    switch (format)
+    {
+    case ImageFormat::EXR:
+        return createEXR(filename);
+    case ImageFormat::PNG:
+    default:
+        return createPNG(filename);
+    }
+}
+
+ImageFormat getImageFormat(const std::string& filename)
+{
+    std::string::size_type dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+        return ImageFormat::PNG;
+    std::string extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [] (char c) -> char { return (char)tolower((unsigned char)c); });
+    if (extension == "exr")
+        return ImageFormat::EXR;
+    return ImageFormat::PNG;
+}
+
+// Interleave every plane's channels a line at a time, and stream them into a scanline EXR.
+static B32 writePlanes(const std::string& filename, const std::vector<RenderPlane>& planes)
+{
+    U32 width = planes[0].getWidth();
+    U32 height = planes[0].getHeight();
+    std::vector<std::string> channels;
+    std::vector<ExrPixelType> types;
+    for (const RenderPlane& plane : planes)
+    {
+        for (const std::string& name : plane.getChannels())
+        {
+            channels.push_back(name);
+            types.push_back(plane.getFormat() == PlaneFormat::U32 ? ExrPixelType::UInt : ExrPixelType::Half);
+        }
+    }
+
+    ExrWriter writer;
+    if (!writer.open(filename, width, height, channels, ExrCompression::Zip, 0, types))
+        return false;
+
+    std::vector<F32> line((U64)width * channels.size());
+    B32 ok = true;
+    for (U32 y = 0; y < height && ok; ++y)
+    {
+        U32 offset = 0;
+        for (const RenderPlane& plane : planes)
+        {
+            U32 planeChannels = (U32)plane.getChannels().size();
+            U64 row = (U64)y * width * planeChannels;
+            for (U32 x = 0; x < width; ++x)
+            {
+                F32* pOut = &line[(U64)x * channels.size() + offset];
+                if (plane.getFormat() == PlaneFormat::U32)
+                    memcpy(pOut, &plane.getU32()[row + (U64)x * planeChannels], sizeof(U32) * planeChannels);
+                else
+                    memcpy(pOut, &plane.getF32()[row + (U64)x * planeChannels], sizeof(F32) * planeChannels);
+            }
+            offset += planeChannels;
+        }
+        ok = writer.writeScanlines(y, 1, line.data());
+    }
+    return writer.close() && ok;
+}
+
+ImageWriter::ImageWriter()
+    : m_busy(false)
+    , m_quit(false)
+    , m_failures(0)
+{
+    m_thread = std::thread([this] () -> void { run(); });
+}
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void ImageWriter::submit(const std::string& filename, ImageFormat format,
+                         const ImageBuffer* pBuf, U32 width, U32 height, U32 channels)
+{
+    if (!pBuf)
+        return;
+
+    Job job;
+    job.filename = filename;
+    job.format = format;
+    job.pBuf.reset(new ImageBuffer(width, height));
+    job.width = width;
+    job.height = height;
+    job.channels = channels;
+    memcpy(job.pBuf->getRaw(), pBuf->getRaw(), std::min(pBuf->getSizeInBytes(), job.pBuf->getSizeInBytes()));
+    push(std::move(job));
+}
+
+void ImageWriter::submit(const std::string& filename, const std::vector<const RenderPlane*>& planes)
+{
+    Job job;
+    job.filename = filename;
+    job.format = ImageFormat::EXR;
+    job.width = 0;
+    job.height = 0;
+    job.channels = 0;
+    for (const RenderPlane* pPlane : planes)
+    {
+        // Every layer of a file shares its size.
+        if (pPlane && (job.planes.empty() || (pPlane->getWidth() == job.planes[0].getWidth() && 
+                                              pPlane->getHeight() == job.planes[0].getHeight())))
+            job.planes.push_back(*pPlane);
+    }
+    if (job.planes.empty())
+        return;
+    push(std::move(job));
+}
+
+void ImageWriter::push(Job&& job)
+{
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_idle.wait(guard, [this] () -> bool { return m_jobs.size() < kMaxQueuedJobs; });
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+B32 ImageWriter::flush()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_idle.wait(guard, [this] () -> bool { return m_jobs.empty() && !m_busy; });
+    B32 ok = m_failures == 0;
+    m_failures = 0;
+    return ok;
+}
+
+void ImageWriter::run()
+{
+    setTraceThreadName("image writer");
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_wake.wait(guard, [this] () -> bool { return m_quit || !m_jobs.empty(); });
+            // Drain what's queued before quitting, so no frame is lost.
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_busy = true;
+        }
+        // There's room in the queue again.
+        m_idle.notify_all();
+
+        B32 ok = false;
+        {
+            RT_TRACE_SCOPE("encode", "write");
+            if (!job.planes.empty())
+            {
+                ok = writePlanes(job.filename, job.planes);
+            }
+            else
+            {
+                Image* pImage = createImage(job.format, job.filename);
+                if (pImage)
+                    ok = pImage->saveBuffer(job.pBuf.get(), job.width, job.height, job.channels);
+                destroyImage(pImage);
+            }
+        }
+        if (!ok)
+            fprintf(stderr, "can't write %s\n", job.filename.c_str());
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_busy = false;
+            if (!ok)
+                ++m_failures;
+        }
+        m_idle.notify_all();
+    }
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,68 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "framebuffer/Image.hpp"
+#include "framebuffer/RenderTarget.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rt {
+
+
+// Encodes and writes finished frames on a background thread, so rendering of the next
+// frame doesn't wait on compression and disk. Each submitted frame is copied, the caller
+// is free to reuse its buffer as soon as submit returns. Frames are written in order.
+// Only a few frames are queued at once, past that submit waits for the oldest to be written.
+class ImageWriter
+{
+public:
+    static const U32 kMaxQueuedJobs = 4;
+
+    ImageWriter();
+    // Waits for every queued frame to be written.
+    ~ImageWriter();
+
+    void submit(const std::string& filename, ImageFormat format,
+                const ImageBuffer* pBuf, U32 width, U32 height, U32 channels);
+
+    // Queue copies of render planes, written together as the layers of one EXR file.
+    void submit(const std::string& filename, const std::vector<const RenderPlane*>& planes);
+
+    // Block until every queued frame is on disk. False if any frame written since the last
+    // flush failed, each failure is also reported on stderr as it happens.
+    B32 flush();
+
+private:
+    struct Job
+    {
+        std::string                     filename;
+        ImageFormat                     format;
+        std::unique_ptr<ImageBuffer>    pBuf;
+        U32                             width;
+        U32                             height;
+        U32                             channels;
+        // Set instead of pBuf for layered output.
+        std::vector<RenderPlane>        planes;
+    };
+
+    // Wait for room in the queue, then add the job.
+    void push(Job&& job);
+    void run();
+
+    std::thread                 m_thread;
+    std::mutex                  m_lock;
+    std::condition_variable     m_wake;
+    std::condition_variable     m_idle;
+    std::deque<Job>             m_jobs;
+    B32                         m_busy;
+    B32                         m_quit;
+    U32                         m_failures;
+};
+} // rt
\ No newline at end of file
@@ -6,11 +6,89 @@ namespace rt {
 
 void RenderTarget::storeColor(U32 x, U32 y, const Float3& color)
 {
+    if (colorTiles.isAllocated())
+    {
+        U8* pPixel = colorTiles.getPixel(x, y);
+        pPixel[0] = U8(color.x * 255.999f);
+        pPixel[1] = U8(color.y * 255.999f);
+        pPixel[2] = U8(color.z * 255.999f);
+        pPixel[3] = U8(255);
+        return;
+    }
     if (!surface)
         return;
-    (*surface)[(U64(width) * U64(y) + U64(x)) * 3 + 0] = U8(color.x * 255.999f);
-    (*surface)[(U64(width) * U64(y) + U64(x)) * 3 + 1] = U8(color.y * 255.999f);
-    (*surface)[(U64(width) * U64(y) + U64(x)) * 3 + 2] = U8(color.z * 255.999f);
-    
+    U8* pPixel = surface->getRaw() + (U64(width) * U64(y) + U64(x)) * 3;
+    pPixel[0] = U8(color.x * 255.999f);
+    pPixel[1] = U8(color.y * 255.999f);
+    pPixel[2] = U8(color.z * 255.999f);
+}
+
+void RenderTarget::enableTiling()
+{
+    radianceTiles.resize(width, height, sizeof(F32) * 4);
+    colorTiles.resize(width, height, 4);
+}
+
+void RenderTarget::resolve()
+{
+    if (colorTiles.isAllocated() && surface)
+        detileRGBA8ToRGB8(colorTiles, surface->getRaw());
+}
+
+RenderPlane::RenderPlane(const std::string& name, PlaneFormat format, const std::vector<std::string>& channels,
+                         U32 width, U32 height)
+    : m_name(name)
+    , m_format(format)
+    , m_channels(channels)
+    , m_width(width)
+    , m_height(height)
+{
+    U64 count = (U64)width * height * channels.size();
+    if (format == PlaneFormat::F32)
+        m_f32.resize(count, 0.f);
+    else
+        m_u32.resize(count, 0u);
+}
+
+RenderPlane* RenderTarget::enableAOV(AOV aov)
+{
+    std::unique_ptr<RenderPlane>& plane = aovs[(U32)aov];
+    if (plane)
+        return plane.get();
+
+    switch (aov)
+    {
+    case AOV::Depth:
+        plane.reset(new RenderPlane("depth", PlaneFormat::F32, { "Z" }, width, height));
+        break;
+    case AOV::Normal:
+        plane.reset(new RenderPlane("normal", PlaneFormat::F32, { "N.X", "N.Y", "N.Z" }, width, height));
+        break;
+    case AOV::Albedo:
+        plane.reset(new RenderPlane("albedo", PlaneFormat::F32, { "albedo.R", "albedo.G", "albedo.B" }, width, height));
+        break;
+    case AOV::PrimitiveId:
+        plane.reset(new RenderPlane("primitiveId", PlaneFormat::U32, { "id" }, width, height));
+        break;
+    case AOV::Direct:
+        plane.reset(new RenderPlane("direct", PlaneFormat::F32, { "direct.R", "direct.G", "direct.B" }, width, height));
+        break;
+    case AOV::Indirect:
+        plane.reset(new RenderPlane("indirect", PlaneFormat::F32, { "indirect.R", "indirect.G", "indirect.B" }, width, height));
+        break;
+    case AOV::Cost:
+        plane.reset(new RenderPlane("cost", PlaneFormat::F32, { "cost" }, width, height));
+        break;
+    default:
+        break;
+    }
+    return plane.get();
+}
+
+B32 RenderTarget::hasAOVs() const
+{
+    for (U32 i = 0; i < (U32)AOV::Count; ++i)
+        if (aovs[i]) return true;
+    return false;
 }
 } // rt
\ No newline at end of file
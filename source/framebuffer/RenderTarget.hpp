@@ -3,6 +3,11 @@
 
 #include "common/Types.hpp"
 #include "math/Float.hpp"
+#include "framebuffer/TiledBuffer.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace rt {
 
@@ -28,15 +33,84 @@ public:
         m_sizeInBytes = 0ULL;
     }
 
+    // Owns its memory, copies have to go through getRaw().
+    ImageBuffer(const ImageBuffer&) = delete;
+    ImageBuffer& operator=(const ImageBuffer&) = delete;
+
     U8& operator[](U64 i) { return m_raw[i]; }
 
+    U8* getRaw() { return m_raw; }
     const U8* getRaw() const { return m_raw; }
+    U64 getSizeInBytes() const { return m_sizeInBytes; }
 
 private:
     U8* m_raw;
     U64 m_sizeInBytes;
 };
 
+// Arbitrary output variables, extra layers written in the same pass as the color.
+enum class AOV
+{
+    // Distance from the camera to the first hit, the nearest of the pixel's samples.
+    Depth,
+    // World space normal at the first hit.
+    Normal,
+    // Surface color at the first hit, before any lighting.
+    Albedo,
+    // Index of the first primitive hit, ~0 where the camera sees nothing.
+    PrimitiveId,
+    // Light reaching the camera straight from emitters, or after a single scattering event.
+    Direct,
+    // Light reaching the camera after bouncing around the scene.
+    Indirect,
+    // Traversal cost of the camera rays, written by the heatmap integrator.
+    Cost,
+    Count
+};
+
+enum class PlaneFormat
+{
+    F32,
+    U32
+};
+
+// A named layer of per pixel values, with 1 to 4 channels of the same format.
+// Channel names follow the EXR convention of layer.channel, e.g. N.X.
+class RenderPlane
+{
+public:
+    RenderPlane(const std::string& name, PlaneFormat format, const std::vector<std::string>& channels,
+                U32 width, U32 height);
+
+    void store(U32 x, U32 y, const F32* pValues)
+    {
+        U64 i = ((U64)y * m_width + x) * m_channels.size();
+        for (U32 c = 0; c < m_channels.size(); ++c)
+            m_f32[i + c] = pValues[c];
+    }
+
+    void store(U32 x, U32 y, U32 value) { m_u32[(U64)y * m_width + x] = value; }
+
+    const std::string&              getName() const { return m_name; }
+    PlaneFormat                     getFormat() const { return m_format; }
+    const std::vector<std::string>& getChannels() const { return m_channels; }
+    U32                             getWidth() const { return m_width; }
+    U32                             getHeight() const { return m_height; }
+
+    // Only the one matching the plane's format holds data.
+    const std::vector<F32>&         getF32() const { return m_f32; }
+    const std::vector<U32>&         getU32() const { return m_u32; }
+
+private:
+    std::string                 m_name;
+    PlaneFormat                 m_format;
+    std::vector<std::string>    m_channels;
+    U32                         m_width;
+    U32                         m_height;
+    std::vector<F32>            m_f32;
+    std::vector<U32>            m_u32;
+};
+
 struct RenderTarget
 {
     // Surface buffer.
@@ -50,5 +124,34 @@ struct RenderTarget
     ImageBuffer*    getBuffer() { return surface; }
 
     void storeColor(U32 x, U32 y, const Float3& color);
+
+    // Store linear radiance, to be tonemapped into the color once the frame is done.
+    void storeRadiance(U32 x, U32 y, const Float3& radiance)
+    {
+        F32* pPixel = (F32*)radianceTiles.getPixel(x, y);
+        pPixel[0] = radiance.x;
+        pPixel[1] = radiance.y;
+        pPixel[2] = radiance.z;
+        pPixel[3] = 1.f;
+    }
+
+    // Store radiance and color tile by tile while rendering, so threads never share cache lines. 
+    // Width and height must be set first. The surface only gets the pixels once resolve() is called.
+    void            enableTiling();
+    // Copy the tiled color into the surface, if tiling is enabled.
+    void            resolve();
+
+    // Allocate the plane for an output variable, at the target's size. Width and 
+    // height must be set first. Enabling a variable twice returns the same plane.
+    RenderPlane*    enableAOV(AOV aov);
+    // Null if the variable isn't enabled.
+    RenderPlane*    getAOV(AOV aov) const { return aovs[(U32)aov].get(); }
+    B32             hasAOVs() const;
+
+    std::unique_ptr<RenderPlane> aovs[(U32)AOV::Count];
+
+    // RGBA32F radiance and RGBA8 color, when tiling is enabled.
+    TiledBuffer     radianceTiles;
+    TiledBuffer     colorTiles;
 };
 } // rt
\ No newline at end of file
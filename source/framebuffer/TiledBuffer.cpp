@@ -0,0 +1,98 @@
+// Raytracer.
+#include "TiledBuffer.hpp"
+
+#include "common/Memory.hpp"
+#include "common/Threading.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined SIMD_ENABLE
+#include <immintrin.h>
+#endif
+
+namespace rt {
+
+
+TiledBuffer::~TiledBuffer()
+{
+    release();
+}
+
+void TiledBuffer::resize(U32 width, U32 height, U32 pixelSize)
+{
+    release();
+    m_width = width;
+    m_height = height;
+    m_pixelSize = pixelSize;
+    m_tilesX = (width + kTileMask) >> kTileShift;
+    m_tilesY = (height + kTileMask) >> kTileShift;
+    // Whole tiles are always a multiple of the cache line size.
+    m_tileBytes = (U64)kTileSize * kTileSize * pixelSize;
+    U64 size = m_tileBytes * m_tilesX * m_tilesY;
+    if (size == 0)
+        return;
+    m_pData = (U8*)alignedAlloc(size, kCacheLineSize);
+    if (m_pData)
+        memset(m_pData, 0, size);
+}
+
+void TiledBuffer::release()
+{
+    if (m_pData)
+        alignedFree(m_pData);
+    m_pData = nullptr;
+}
+
+// Copy count RGBA8 pixels to RGB8.
+static void packRGBA8ToRGB8(const U8* pSrc, U8* pDst, U32 count)
+{
+    U32 i = 0;
+#if defined SIMD_ENABLE
+    // Sixteen pixels at a time: drop alpha from each group of four, then slide
+    // the four 12 byte results together into three 16 byte stores.
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + i * 4)), shuffle);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + i * 4 + 16)), shuffle);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + i * 4 + 32)), shuffle);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pSrc + i * 4 + 48)), shuffle);
+        _mm_storeu_si128((__m128i*)(pDst + i * 3), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(pDst + i * 3 + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(pDst + i * 3 + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        pDst[i * 3 + 0] = pSrc[i * 4 + 0];
+        pDst[i * 3 + 1] = pSrc[i * 4 + 1];
+        pDst[i * 3 + 2] = pSrc[i * 4 + 2];
+    }
+}
+
+void detileRGBA8ToRGB8(const TiledBuffer& src, U8* pDst)
+{
+    if (!src.isAllocated() || src.getPixelSize() != 4 || !pDst)
+        return;
+
+    U32 width = src.getWidth();
+    U32 height = src.getHeight();
+    // One thread per row of tiles, each writing its own band of scanlines.
+    dispatch({[&] (const ThreadID& id) -> void {
+        U32 tileY = id.global.x;
+        U32 rows = std::min(TiledBuffer::kTileSize, height - tileY * TiledBuffer::kTileSize);
+        for (U32 tileX = 0; tileX < src.getTilesX(); ++tileX)
+        {
+            const U8* pTile = src.getTile(tileX, tileY);
+            U32 columns = std::min(TiledBuffer::kTileSize, width - tileX * TiledBuffer::kTileSize);
+            for (U32 row = 0; row < rows; ++row)
+            {
+                U64 y = (U64)tileY * TiledBuffer::kTileSize + row;
+                U64 x = (U64)tileX * TiledBuffer::kTileSize;
+                packRGBA8ToRGB8(pTile + (U64)row * TiledBuffer::kTileSize * 4, pDst + (y * width + x) * 3, columns);
+            }
+        }
+    }, 1, 1, 1 }, src.getTilesY(), 1, 1);
+}
+} // rt
\ No newline at end of file
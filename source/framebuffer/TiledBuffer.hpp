@@ -0,0 +1,63 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+namespace rt {
+
+
+// Pixel storage where each tile is contiguous and starts on its own cache line. Render
+// threads each work on whole tiles, so no two threads ever write to the same line, and
+// finding a pixel is a few shifts and masks instead of a multiply per row.
+class TiledBuffer
+{
+public:
+    static const U32 kTileShift = 6;
+    // Also the integrator's default tile size, so each thread writes whole tiles.
+    static const U32 kTileSize  = 1 << kTileShift;
+    static const U32 kTileMask  = kTileSize - 1;
+
+    TiledBuffer()
+        : m_pData(nullptr), m_width(0), m_height(0), m_pixelSize(0), m_tilesX(0), m_tilesY(0), m_tileBytes(0) { }
+    ~TiledBuffer();
+
+    TiledBuffer(const TiledBuffer&) = delete;
+    TiledBuffer& operator=(const TiledBuffer&) = delete;
+
+    // Reallocate for an image of width x height, with pixelSize bytes per pixel. Contents are cleared.
+    void resize(U32 width, U32 height, U32 pixelSize);
+    void release();
+
+    U8* getPixel(U32 x, U32 y)
+    {
+        U64 tile = (U64)(y >> kTileShift) * m_tilesX + (x >> kTileShift);
+        U32 local = ((y & kTileMask) << kTileShift) | (x & kTileMask);
+        return m_pData + tile * m_tileBytes + (U64)local * m_pixelSize;
+    }
+
+    const U8* getPixel(U32 x, U32 y) const { return const_cast<TiledBuffer*>(this)->getPixel(x, y); }
+
+    // Tiles on the right and bottom edges are stored whole, pixels past the image are unused.
+    U8* getTile(U32 tileX, U32 tileY) { return m_pData + ((U64)tileY * m_tilesX + tileX) * m_tileBytes; }
+    const U8* getTile(U32 tileX, U32 tileY) const { return m_pData + ((U64)tileY * m_tilesX + tileX) * m_tileBytes; }
+
+    B32 isAllocated() const { return m_pData != nullptr; }
+    U32 getWidth() const { return m_width; }
+    U32 getHeight() const { return m_height; }
+    U32 getPixelSize() const { return m_pixelSize; }
+    U32 getTilesX() const { return m_tilesX; }
+    U32 getTilesY() const { return m_tilesY; }
+
+private:
+    U8* m_pData;
+    U32 m_width;
+    U32 m_height;
+    U32 m_pixelSize;
+    U32 m_tilesX;
+    U32 m_tilesY;
+    U64 m_tileBytes;
+};
+
+// Copy tiled RGBA8 pixels out into a scanline RGB8 image, dropping alpha. Runs over several threads.
+void detileRGBA8ToRGB8(const TiledBuffer& src, U8* pDst);
+} // rt
\ No newline at end of file
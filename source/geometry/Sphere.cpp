@@ -0,0 +1,87 @@
+// Raytracer.
+#include "Sphere.hpp"
+
+namespace rt {
+
+
+Bounds3 Sphere::getWorldBounds() const
+{
+    // The transform may scale, or shear, the sphere into an ellipsoid. Its extent along a world
+    // axis is the radius times the length of what the local axes contribute to it.
+    const Matrix44& m = m_localToWorld;
+    Float3 c = getCenter();
+    Float3 r = Float3(m_radius * sqrtf(m[0] * m[0] + m[4] * m[4] + m[8] * m[8]),
+                      m_radius * sqrtf(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]),
+                      m_radius * sqrtf(m[2] * m[2] + m[6] * m[6] + m[10] * m[10]));
+    return { c - r, c + r };
+}
+
+B32 Sphere::sample(const Float2& u, SurfaceInteraction& si, F32& pdf) const
+{
+    F32 z = 1.f - 2.f * u.x;
+    F32 r = sqrtf(fmaxf(0.f, 1.f - z * z));
+    F32 phi = 2.f * (F32)RT_PI * u.y;
+    Float3 n = Float3(r * cosf(phi), r * sinf(phi), z);
+
+    si.vPosition = Float4(n * m_radius, 1.f) * m_localToWorld;
+    si.vNormal = normalize(Float4(n, 0.f) * m_localToWorld);
+    pdf = 1.f / area();
+    return true;
+}
+
+B32 Sphere::sample(const SurfaceInteraction& ref, const Float2& u, SurfaceInteraction& si, F32& pdf) const
+{
+    Float3 pCenter = getCenter();
+    F32 dc2 = length2(ref.vPosition - pCenter);
+    // Inside the sphere, every direction sees it. Fall back to area sampling.
+    if (dc2 <= m_radius * m_radius)
+        return Shape::sample(ref, u, si, pdf);
+
+    // Sample uniformly inside the cone subtended by the sphere.
+    F32 dc = sqrtf(dc2);
+    F32 sinThetaMax = m_radius / dc;
+    F32 sin2ThetaMax = sinThetaMax * sinThetaMax;
+    F32 cosThetaMax = sqrtf(fmaxf(0.f, 1.f - sin2ThetaMax));
+    F32 oneMinusCosThetaMax = 1.f - cosThetaMax;
+
+    F32 cosTheta = (cosThetaMax - 1.f) * u.x + 1.f;
+    F32 sin2Theta = 1.f - cosTheta * cosTheta;
+    if (sin2ThetaMax < 0.00068523f)
+    {
+        // Small cones lose too much precision in 1 - cosTheta, use a Taylor expansion instead.
+        sin2Theta = sin2ThetaMax * u.x;
+        cosTheta = sqrtf(1.f - sin2Theta);
+        oneMinusCosThetaMax = sin2ThetaMax / 2.f;
+    }
+
+    // Angle from the sphere center to the sampled point, as seen from the center.
+    F32 cosAlpha = sin2Theta / sinThetaMax + 
+                   cosTheta * sqrtf(fmaxf(0.f, 1.f - sin2Theta / sin2ThetaMax));
+    F32 sinAlpha = sqrtf(fmaxf(0.f, 1.f - cosAlpha * cosAlpha));
+    F32 phi = u.y * 2.f * (F32)RT_PI;
+
+    Float3 wz = (ref.vPosition - pCenter) / dc;
+    Float3 wx, wy;
+    coordinateSystem(wz, wx, wy);
+    Float3 local = sphericalDirection(sinAlpha, cosAlpha, phi);
+    Float3 n = wx * local.x + wy * local.y + wz * local.z;
+
+    si.vNormal = n;
+    si.vPosition = pCenter + n * m_radius;
+    pdf = 1.f / (2.f * (F32)RT_PI * oneMinusCosThetaMax);
+    return true;
+}
+
+F32 Sphere::pdf(const SurfaceInteraction& ref, const Float3& wi)
+{
+    Float3 pCenter = getCenter();
+    F32 dc2 = length2(ref.vPosition - pCenter);
+    if (dc2 <= m_radius * m_radius)
+        return Shape::pdf(ref, wi);
+
+    F32 sin2ThetaMax = m_radius * m_radius / dc2;
+    F32 cosThetaMax = sqrtf(fmaxf(0.f, 1.f - sin2ThetaMax));
+    F32 oneMinusCosThetaMax = (sin2ThetaMax < 0.00068523f) ? sin2ThetaMax / 2.f : 1.f - cosThetaMax;
+    return 1.f / (2.f * (F32)RT_PI * oneMinusCosThetaMax);
+}
+} // rt
\ No newline at end of file
@@ -1,6 +1,7 @@
 // Raytracer.
 #pragma once
 
+#include "math/CommonMath.hpp"
 #include "math/Ray.hpp"
 
 #include "Primitive.hpp"
@@ -39,10 +40,11 @@ public:
         return 4.f * RT_PI * (m_radius * m_radius);
     }
 
-    virtual B32 intersects(const Ray& ray, SurfaceInteraction& si) override
+    virtual B32 intersect(const Ray& ray, HitRecord& hit) const override
     {
-        // Transform ray to this shape's local space.
-        Ray localRay = ray * m_worldToLocal;
+        // Transform ray to this shape's local space. Only its origin and direction, the
+        // differentials aren't needed to find the hit and would be four more transforms per test.
+        Ray localRay = Ray(ray.o, ray.dir, ray.tMax) * m_worldToLocal;
         F32 t0, t1;
         F32 radius2 = m_radius * m_radius;
         Float3 l = localRay.o;
@@ -58,17 +60,25 @@ public:
             (U32&)t1 ^= (U32&)t0;
             (U32&)t0 ^= (U32&)t1;        
         }
+        // Nearest root inside [0, tMax], the far one only when the ray starts inside.
+        if (t0 > localRay.tMax || t1 < 0.f)
+            return false;
         if (t0 < 0.f)
         {
             t0 = t1;
-            if (t0 < 0.f) return false;
+            if (t0 > localRay.tMax) return false;
         }
-        
-        F32 t = t0;
-        Float3 position = localRay.o + localRay.dir * t;
+        hit.time = t0;
+        return true;
+    }
+
+    virtual void computeInteraction(const Ray& ray, const HitRecord& hit, SurfaceInteraction& si) const override
+    {
+        // The same local space hit intersect() found, the parameterization is worked out from it.
+        Ray localRay = Ray(ray.o, ray.dir, ray.tMax) * m_worldToLocal;
+        Float3 position = localRay.o + localRay.dir * hit.time;
         Float3 normal = normalize(position);
 
-        si.time = t;
         // Transform position to world space.
         si.vPosition = Float4(position, 1.0f) * m_localToWorld;
 
@@ -86,16 +96,31 @@ public:
         F32 zRad = sqrtf(position.x * position.x + position.y * position.y);
         F32 invZRad = 1.f / zRad;
         F32 phi = atan2f(position.y, position.x);
-        F32 u = phi / 1.f;
+        if (phi < 0.f) phi += 2.f * (F32)RT_PI;
         F32 theta = acosf(RT_CLAMP(position.z / m_radius, -1.f, 1.f));
-        F32 v = (theta + 1.f) / 2.f;
+        // Latitude-longitude parameterization, both in [0, 1].
+        F32 u = phi / (2.f * (F32)RT_PI);
+        F32 v = theta / (F32)RT_PI;
+        si.vTexCoord = Float2(u, v);
         F32 phiMax = RT_RAD(360.0f);
+        F32 thetaRange = (F32)RT_PI;
         si.dpdu = Float3(-phiMax * position.y, phiMax * position.x, 0.f) * m_localToWorld;
-        si.dpdv;
-
-        return true;    
+        si.dpdv = Float3(position.z * position.x * invZRad, position.z * position.y * invZRad, 
+                         -m_radius * sinf(theta)) * thetaRange * m_localToWorld;
     } 
 
+    Bounds3 getWorldBounds() const override;
+
+    // Uniform area sampling over the whole sphere.
+    B32 sample(const Float2& u, SurfaceInteraction& si, F32& pdf) const override;
+
+    // Samples the cone of directions subtended by the sphere from the reference point, 
+    // so no samples are wasted on the far side of the sphere.
+    B32 sample(const SurfaceInteraction& ref, const Float2& u, SurfaceInteraction& si, F32& pdf) const override;
+    F32 pdf(const SurfaceInteraction& ref, const Float3& wi) override;
+
+    Float3 getCenter() const { return Float4(0.f, 0.f, 0.f, 1.f) * m_localToWorld; }
+
     Matrix44 m_localToWorld;
     Matrix44 m_worldToLocal;
     Matrix44 m_localToWorldNormal;
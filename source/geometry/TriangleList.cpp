@@ -0,0 +1,104 @@
+// Raytracer.
+#include "TriangleList.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+void Triangle::computeInteraction(const Ray& ray, const HitRecord& hit, SurfaceInteraction& si) const
+{
+    const Float3& p0 = m_pTriangleList->getPosition(m_index[0]);
+    Float3 edge1 = m_pTriangleList->getPosition(m_index[1]) - p0;
+    Float3 edge2 = m_pTriangleList->getPosition(m_index[2]) - p0;
+    F32 b1 = hit.uv.x;
+    F32 b2 = hit.uv.y;
+    F32 b0 = 1.f - b1 - b2;
+    si.vPosition    = ray.o + ray.dir * hit.time;
+    si.vNormal      = normalize(cross(edge1, edge2));
+    si.vTexCoord    = hit.uv;
+    si.dpdu         = edge1;
+    si.dpdv         = edge2;
+    si.wo           = -ray.dir;
+
+    if (m_pTriangleList->hasUVs())
+    {
+        const Float2& uv0 = m_pTriangleList->getUVs(m_index[0]);
+        const Float2& uv1 = m_pTriangleList->getUVs(m_index[1]);
+        const Float2& uv2 = m_pTriangleList->getUVs(m_index[2]);
+        si.vTexCoord = uv0 * b0 + uv1 * b1 + uv2 * b2;
+
+        // Solve edge = dpdu * du + dpdv * dv for both edges. Degenerate uvs keep the edges.
+        Float2 duv1 = uv1 - uv0;
+        Float2 duv2 = uv2 - uv0;
+        F32 det = duv1.x * duv2.y - duv1.y * duv2.x;
+        if (fabsf(det) > 1e-12f)
+        {
+            F32 invDet = 1.f / det;
+            si.dpdu = (edge1 * duv2.y - edge2 * duv1.y) * invDet;
+            si.dpdv = (edge2 * duv1.x - edge1 * duv2.x) * invDet;
+        }
+    }
+
+    if (m_pTriangleList->hasNormals())
+    {
+        Float3 n = m_pTriangleList->getNormal(m_index[0]) * b0 + m_pTriangleList->getNormal(m_index[1]) * b1 +
+                   m_pTriangleList->getNormal(m_index[2]) * b2;
+        if (length2(n) > 0.f)
+            si.vNormal = normalize(n);
+    }
+
+    if (m_pTriangleList->hasTangents())
+    {
+        // Authored tangents only turn dpdu, its length still has to match the uvs for differentials.
+        Float3 t = m_pTriangleList->getTangents(m_index[0]) * b0 + m_pTriangleList->getTangents(m_index[1]) * b1 +
+                   m_pTriangleList->getTangents(m_index[2]) * b2;
+        if (length2(t) > 0.f)
+            si.dpdu = normalize(t) * length(si.dpdu);
+    }
+
+    // The shading frame takes dpdu as its first axis, so keep it perpendicular to the normal.
+    Float3 dpdu = si.dpdu - si.vNormal * dot(si.vNormal, si.dpdu);
+    if (length2(dpdu) > 0.f)
+        si.dpdu = dpdu;
+}
+
+Bounds3 Triangle::getWorldBounds() const
+{
+    Bounds3 bounds = { m_pTriangleList->getPosition(m_index[0]), m_pTriangleList->getPosition(m_index[0]) };
+    bounds = boundsUnion(bounds, m_pTriangleList->getPosition(m_index[1]));
+    return boundsUnion(bounds, m_pTriangleList->getPosition(m_index[2]));
+}
+
+F32 Triangle::getNormalBounds(Float3& w) const
+{
+    const Float3& p0 = m_pTriangleList->getPosition(m_index[0]);
+    const Float3& p1 = m_pTriangleList->getPosition(m_index[1]);
+    const Float3& p2 = m_pTriangleList->getPosition(m_index[2]);
+    w = normalize(cross(p1 - p0, p2 - p0));
+    return 1.f;
+}
+
+B32 Triangle::sample(const Float2& u, SurfaceInteraction& si, F32& pdf) const
+{
+    const Float3& p0 = m_pTriangleList->getPosition(m_index[0]);
+    const Float3& p1 = m_pTriangleList->getPosition(m_index[1]);
+    const Float3& p2 = m_pTriangleList->getPosition(m_index[2]);
+
+    // Warp the square to uniformly distributed barycentrics.
+    F32 su0 = sqrtf(u.x);
+    F32 b0 = 1.f - su0;
+    F32 b1 = u.y * su0;
+    si.vPosition = p0 * b0 + p1 * b1 + p2 * (1.f - b0 - b1);
+    si.vNormal = normalize(cross(p1 - p0, p2 - p0));
+    si.vTexCoord = Float2(b1, 1.f - b0 - b1);
+    if (m_pTriangleList->hasUVs())
+    {
+        si.vTexCoord = m_pTriangleList->getUVs(m_index[0]) * b0 + m_pTriangleList->getUVs(m_index[1]) * b1 +
+                       m_pTriangleList->getUVs(m_index[2]) * (1.f - b0 - b1);
+    }
+    F32 a = area();
+    pdf = (a > 0.f) ? 1.f / a : 0.f;
+    return a > 0.f;
+}
+} // rt
\ No newline at end of file
@@ -14,20 +14,44 @@
 
 namespace rt {
 
+struct Triangle;
 
 class TriangleList 
 {
 public:
+    TriangleList()
+        : m_nTriangles(0), m_nVertices(0), m_indices(nullptr), m_vertices{ nullptr, nullptr, nullptr, nullptr } { }
+
     void loadVertices();
     void cleanUp();
 
-    Triangle getTriangle(U32 index) 
+    // Point the list at vertex arrays owned elsewhere, such as a mapped scene file. Nothing is
+    // copied, so the arrays must outlive the list. Normals, tangents and uvs may be null.
+    void setVertices(U32 nVertices, const Float3* pPositions, const Float3* pNormals = nullptr,
+                     const Float3* pTangents = nullptr, const Float2* pUVs = nullptr)
+    {
+        m_nVertices = nVertices;
+        m_vertices.m_positions = pPositions;
+        m_vertices.m_normals = pNormals;
+        m_vertices.m_tangents = pTangents;
+        m_vertices.m_uvs = pUVs;
+    }
+
+    // Three vertex indices per triangle, also referenced in place.
+    void setIndices(U32 nTriangles, const U32* pIndices)
     {
-        if (index > m_nTriangles)
-            return Triangle(nullptr, nullptr, 0);
-        return Triangle(this, m_indices, index);
+        m_nTriangles = nTriangles;
+        m_indices = pIndices;
     }
 
+    U32 getTriangleCount() const { return m_nTriangles; }
+    U32 getVertexCount() const { return m_nVertices; }
+    B32 hasNormals() const { return m_vertices.m_normals != nullptr; }
+    B32 hasTangents() const { return m_vertices.m_tangents != nullptr; }
+    B32 hasUVs() const { return m_vertices.m_uvs != nullptr; }
+
+    Triangle getTriangle(U32 index);
+
     // Getters for vertex values.
     inline const Float3& getPosition(U32 index) const   { return m_vertices.m_positions[index]; }
     inline const Float3& getNormal(U32 index) const     { return m_vertices.m_normals[index]; }
@@ -35,15 +59,15 @@ public:
     inline const Float2& getUVs(U32 index) const        { return m_vertices.m_uvs[index]; }
 
 private:
-    U32     m_nTriangles;
-    U32     m_nVertices;
-    U32*    m_indices;
+    U32             m_nTriangles;
+    U32             m_nVertices;
+    const U32*      m_indices;
 
     struct {
-        Float3* m_positions;
-        Float3* m_normals;
-        Float3* m_tangents;
-        Float2* m_uvs;
+        const Float3*   m_positions;
+        const Float3*   m_normals;
+        const Float3*   m_tangents;
+        const Float2*   m_uvs;
     } m_vertices;   
 };
 
@@ -52,14 +76,14 @@ private:
 // triangle from a list must be processed.
 struct Triangle : public Shape
 {
-    Triangle(TriangleList* pList, U32* indices, U32 index)
+    Triangle(TriangleList* pList, const U32* indices, U32 index)
         : m_pTriangleList(pList)
         , m_index(indices + index * 3u)
     {
         
     }
 
-    B32 intersects(const Ray& ray, SurfaceInteraction& si) override
+    B32 intersect(const Ray& ray, HitRecord& hit) const override
     {   
         // Use Moller-Trumbore intersection algorithm.
         const F32 kEpsilon = 0.0000001f;
@@ -97,20 +121,21 @@ struct Triangle : public Shape
 
         F32 t = f * dot(edge2, q);
 
-        // We have intersected this ray.
-        if (t > kEpsilon)
+        // We have intersected this ray, if it's within its extent.
+        if (t > kEpsilon && t <= ray.tMax)
         {
-            si.time         = t;
-            si.vPosition    = ray.o + ray.dir * t;
-            si.vNormal      = cross(edge1, edge2);
-            si.vTexCoord    = Float2(u, v);
-            si.wo           = -ray.dir;
+            hit.time        = t;
+            hit.uv          = Float2(u, v);
             return true;
         }
 
         return false;
     }
 
+    // Vertex uvs, normals and tangents are interpolated with the hit's barycentrics where the
+    // list has them. Otherwise the barycentrics are the uvs and the face normal is used.
+    void computeInteraction(const Ray& ray, const HitRecord& hit, SurfaceInteraction& si) const override;
+
     // Calculate the area of a triangle by obtaining the surface area of a parallelogram,
     // and taking the half of it.
     F32 area() const override
@@ -120,8 +145,23 @@ struct Triangle : public Shape
         const Float3& p2 = m_pTriangleList->getPosition(m_index[2]);
         return 0.5f * length(cross(p1 - p0, p2 - p0));
     }
+
+    Bounds3 getWorldBounds() const override;
+
+    // Triangles are flat, their normals are bound by a zero spread cone.
+    F32 getNormalBounds(Float3& w) const override;
+
+    // Uniform area sampling with barycentric coordinates.
+    B32 sample(const Float2& u, SurfaceInteraction& si, F32& pdf) const override;
 private:
     TriangleList*   m_pTriangleList;
     const U32*      m_index;
 };
+
+inline Triangle TriangleList::getTriangle(U32 index)
+{
+    if (index >= m_nTriangles)
+        return Triangle(nullptr, nullptr, 0);
+    return Triangle(this, m_indices, index);
+}
 } // namespace rt
\ No newline at end of file
@@ -0,0 +1,260 @@
+// Raytracer.
+#include "Json.hpp"
+
+#include <charconv>
+#include <string.h>
+
+namespace rt {
+
+
+// Nesting deeper than this is rejected instead of recursing further.
+static const U32 kMaxJsonDepth = 256;
+
+static const JsonValue kNullValue;
+
+const JsonValue& JsonValue::operator[](const char* pKey) const
+{
+    for (const std::pair<std::string, JsonValue>& member : members)
+    {
+        if (member.first == pKey)
+            return member.second;
+    }
+    return kNullValue;
+}
+
+const JsonValue& JsonValue::at(U64 index) const
+{
+    return index < elements.size() ? elements[index] : kNullValue;
+}
+
+U32 JsonValue::getUInt(U32 fallback) const
+{
+    if (type != JsonType::Number || number < 0.0 || number > 4294967295.0 || number != (F64)(U32)number)
+        return fallback;
+    return (U32)number;
+}
+
+class JsonParser
+{
+public:
+    JsonParser(const char* pText, U64 length) : m_pCursor(pText), m_pEnd(pText + length) { }
+
+    B32 parse(JsonValue& root)
+    {
+        if (!parseValue(root, 0))
+            return false;
+        skipSpace();
+        return m_pCursor == m_pEnd;
+    }
+
+private:
+    void skipSpace()
+    {
+        while (m_pCursor < m_pEnd && (*m_pCursor == ' ' || *m_pCursor == '\t' ||
+                                      *m_pCursor == '\n' || *m_pCursor == '\r'))
+            ++m_pCursor;
+    }
+
+    B32 match(const char* pWord)
+    {
+        U64 length = strlen(pWord);
+        if ((U64)(m_pEnd - m_pCursor) < length || memcmp(m_pCursor, pWord, length) != 0)
+            return false;
+        m_pCursor += length;
+        return true;
+    }
+
+    B32 parseValue(JsonValue& value, U32 depth)
+    {
+        skipSpace();
+        if (m_pCursor == m_pEnd || depth > kMaxJsonDepth)
+            return false;
+        switch (*m_pCursor)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.type = JsonType::String;
+            return parseString(value.string);
+        case 't':
+            value.type = JsonType::Boolean;
+            value.boolean = true;
+            return match("true");
+        case 'f':
+            value.type = JsonType::Boolean;
+            value.boolean = false;
+            return match("false");
+        case 'n':
+            value.type = JsonType::Null;
+            return match("null");
+        default:
+            value.type = JsonType::Number;
+            return parseNumber(value.number);
+        }
+    }
+
+    B32 parseObject(JsonValue& value, U32 depth)
+    {
+        value.type = JsonType::Object;
+        ++m_pCursor;
+        skipSpace();
+        if (m_pCursor < m_pEnd && *m_pCursor == '}')
+        {
+            ++m_pCursor;
+            return true;
+        }
+        for (;;)
+        {
+            value.members.emplace_back();
+            std::pair<std::string, JsonValue>& member = value.members.back();
+            skipSpace();
+            if (m_pCursor == m_pEnd || *m_pCursor != '"' || !parseString(member.first))
+                return false;
+            skipSpace();
+            if (m_pCursor == m_pEnd || *m_pCursor++ != ':')
+                return false;
+            if (!parseValue(member.second, depth + 1))
+                return false;
+            skipSpace();
+            if (m_pCursor == m_pEnd)
+                return false;
+            char c = *m_pCursor++;
+            if (c == '}')
+                return true;
+            if (c != ',')
+                return false;
+        }
+    }
+
+    B32 parseArray(JsonValue& value, U32 depth)
+    {
+        value.type = JsonType::Array;
+        ++m_pCursor;
+        skipSpace();
+        if (m_pCursor < m_pEnd && *m_pCursor == ']')
+        {
+            ++m_pCursor;
+            return true;
+        }
+        for (;;)
+        {
+            value.elements.emplace_back();
+            if (!parseValue(value.elements.back(), depth + 1))
+                return false;
+            skipSpace();
+            if (m_pCursor == m_pEnd)
+                return false;
+            char c = *m_pCursor++;
+            if (c == ']')
+                return true;
+            if (c != ',')
+                return false;
+        }
+    }
+
+    B32 parseHex(U32& code)
+    {
+        if (m_pEnd - m_pCursor < 4)
+            return false;
+        std::from_chars_result result = std::from_chars(m_pCursor, m_pCursor + 4, code, 16);
+        if (result.ptr != m_pCursor + 4)
+            return false;
+        m_pCursor += 4;
+        return true;
+    }
+
+    static void appendUtf8(U32 code, std::string& out)
+    {
+        if (code < 0x80)
+            out.push_back((char)code);
+        else if (code < 0x800)
+        {
+            out.push_back((char)(0xC0 | (code >> 6)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out.push_back((char)(0xE0 | (code >> 12)));
+            out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out.push_back((char)(0xF0 | (code >> 18)));
+            out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    B32 parseString(std::string& out)
+    {
+        ++m_pCursor;
+        for (;;)
+        {
+            // Copy runs without escapes in one go.
+            const char* pRun = m_pCursor;
+            while (m_pCursor < m_pEnd && *m_pCursor != '"' && *m_pCursor != '\\')
+                ++m_pCursor;
+            out.append(pRun, m_pCursor);
+            if (m_pCursor == m_pEnd)
+                return false;
+            if (*m_pCursor++ == '"')
+                return true;
+            if (m_pCursor == m_pEnd)
+                return false;
+            char c = *m_pCursor++;
+            switch (c)
+            {
+            case '"':   out.push_back('"'); break;
+            case '\\':  out.push_back('\\'); break;
+            case '/':   out.push_back('/'); break;
+            case 'b':   out.push_back('\b'); break;
+            case 'f':   out.push_back('\f'); break;
+            case 'n':   out.push_back('\n'); break;
+            case 'r':   out.push_back('\r'); break;
+            case 't':   out.push_back('\t'); break;
+            case 'u':
+            {
+                U32 code = 0;
+                if (!parseHex(code))
+                    return false;
+                // Characters outside the basic plane come as a pair of surrogates.
+                if (code >= 0xD800 && code < 0xDC00)
+                {
+                    U32 low = 0;
+                    if (!match("\\u") || !parseHex(low) || low < 0xDC00 || low >= 0xE000)
+                        return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(code, out);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    B32 parseNumber(F64& number)
+    {
+        std::from_chars_result result = std::from_chars(m_pCursor, m_pEnd, number);
+        if (result.ec != std::errc() || result.ptr == m_pCursor)
+            return false;
+        m_pCursor = result.ptr;
+        return true;
+    }
+
+    const char* m_pCursor;
+    const char* m_pEnd;
+};
+
+B32 parseJson(const char* pText, U64 length, JsonValue& root)
+{
+    root = JsonValue();
+    JsonParser parser(pText, length);
+    return parser.parse(root);
+}
+} // rt
\ No newline at end of file
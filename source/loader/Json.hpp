@@ -0,0 +1,54 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+
+enum class JsonType : U32
+{
+    Null,
+    Boolean,
+    Number,
+    String,
+    Array,
+    Object
+};
+
+// Parsed JSON document, as a tree of values. Only meant for small documents such as the
+// header of a glTF file, bulk data stays in binary buffers next to it.
+struct JsonValue
+{
+    JsonType                                        type    = JsonType::Null;
+    B32                                             boolean = false;
+    F64                                             number  = 0.0;
+    std::string                                     string;
+    std::vector<JsonValue>                          elements;
+    std::vector<std::pair<std::string, JsonValue>>  members;
+
+    B32 isNull() const { return type == JsonType::Null; }
+    B32 isNumber() const { return type == JsonType::Number; }
+    B32 isString() const { return type == JsonType::String; }
+    B32 isArray() const { return type == JsonType::Array; }
+    B32 isObject() const { return type == JsonType::Object; }
+
+    // Member of an object, a null value if it has none by that name.
+    const JsonValue& operator[](const char* pKey) const;
+    // Element of an array, a null value past its end.
+    const JsonValue& at(U64 index) const;
+    U64 size() const { return elements.size(); }
+
+    // The value converted, or fallback if it's of another type.
+    F64 getNumber(F64 fallback = 0.0) const { return type == JsonType::Number ? number : fallback; }
+    U32 getUInt(U32 fallback = 0) const;
+    const std::string& getString() const { return string; }
+};
+
+// Parse a whole JSON document. Fails on malformed input, and on anything but white space after it.
+B32 parseJson(const char* pText, U64 length, JsonValue& root);
+} // rt
\ No newline at end of file
@@ -0,0 +1,203 @@
+// Raytracer.
+#include "Loader.hpp"
+
+#include "common/Memory.hpp"
+#include "common/Trace.hpp"
+#include "math/CommonMath.hpp"
+#include "scene/Scene.hpp"
+#include "EnvironmentLight.hpp"
+#include "Light.hpp"
+#include "Material.hpp"
+
+#include <unordered_map>
+
+namespace rt {
+
+
+void SceneDescription::clear()
+{
+    for (void* p : m_storage)
+        alignedFree(p);
+    m_storage.clear();
+    m_adopted.clear();
+    m_file.close();
+    camera = CameraDescription();
+    materials = { };
+    lights = { };
+    spheres = { };
+    transforms = { };
+    meshes = { };
+    strings = { };
+    directory.clear();
+}
+
+void* SceneDescription::allocate(U64 size)
+{
+    // Cache line aligned, the same as arrays in a mapped binary scene.
+    void* p = alignedAlloc(size);
+    m_storage.push_back(p);
+    return p;
+}
+
+B32 Loader::fail(const std::string& error)
+{
+    m_error = error;
+    return false;
+}
+
+B32 Loader::load(const std::string& filename, SceneDescription& desc)
+{
+    RT_TRACE_SCOPE("scene load", "scene");
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return fail("can't open " + filename);
+    char magic[4] = { };
+    B32 binary = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "RTSC", 4) == 0;
+    fclose(fp);
+    return binary ? loadBinary(filename, desc) : loadText(filename, desc);
+}
+
+std::string Loader::joinPath(const std::string& directory, const std::string& name)
+{
+    if (directory.empty() || name.empty() || name[0] == '/' || name[0] == '\\' ||
+        (name.size() > 1 && name[1] == ':'))
+        return name;
+    return directory + "/" + name;
+}
+
+B32 Loader::build(const SceneDescription& desc, Scene* pScene, SceneAssets& assets)
+{
+    RT_TRACE_SCOPE("scene build", "scene");
+    // Materials sharing a file share its texture.
+    std::unordered_map<U32, Texture*> textures;
+    auto openTexture = [&] (U32 name, Texture*& pTexture) -> B32 {
+        pTexture = nullptr;
+        if (name == 0)
+            return true;
+        auto it = textures.find(name);
+        if (it != textures.end())
+        {
+            pTexture = it->second;
+            return true;
+        }
+        std::string filename = joinPath(desc.directory, desc.getString(name));
+        std::unique_ptr<Texture> pOpened(new Texture());
+        if (!pOpened->open(filename))
+            return fail("can't open texture " + filename);
+        if (!assets.textureSampler)
+        {
+            assets.tileCache.reset(new TileCache());
+            assets.textureSampler.reset(new TextureSampler(assets.tileCache.get()));
+        }
+        pTexture = pOpened.get();
+        textures[name] = pTexture;
+        assets.textures.push_back(std::move(pOpened));
+        return true;
+    };
+
+    std::vector<IMaterial*> materials;
+    materials.reserve(desc.materials.size());
+    for (const MaterialDescription& material : desc.materials)
+    {
+        if (material.type == MaterialType::Matte)
+        {
+            MatteMaterial* pMatte = pScene->createMaterial<MatteMaterial>();
+            pMatte->color = material.color;
+            materials.push_back(pMatte);
+        }
+        else
+        {
+            MicrofacetMaterial* pMicrofacet = pScene->createMaterial<MicrofacetMaterial>();
+            pMicrofacet->color = material.color;
+            pMicrofacet->kD = material.roughness;
+            pMicrofacet->kS = material.metallic;
+            materials.push_back(pMicrofacet);
+            if (!openTexture(material.albedoTexture, pMicrofacet->albedo) ||
+                !openTexture(material.normalTexture, pMicrofacet->normal) ||
+                !openTexture(material.metallicRoughnessTexture, pMicrofacet->metallicRoughness) ||
+                !openTexture(material.aoTexture, pMicrofacet->ao))
+                return false;
+            if (pMicrofacet->albedo || pMicrofacet->normal || pMicrofacet->metallicRoughness || pMicrofacet->ao)
+                pMicrofacet->surfaceSampler = assets.textureSampler.get();
+        }
+    }
+
+    for (const LightDescription& light : desc.lights)
+    {
+        Light* pLight = nullptr;
+        if (light.type == LightType::Point)
+        {
+            PointLight* pPoint = pScene->createLight<PointLight>();
+            pPoint->position = light.vector;
+            pPoint->i = light.power;
+            pLight = pPoint;
+        }
+        else if (light.type == LightType::Directional)
+        {
+            DirectionLight* pDirection = pScene->createLight<DirectionLight>();
+            pDirection->wi = normalize(light.vector);
+            pDirection->l = light.power;
+            pLight = pDirection;
+        }
+        else
+        {
+            EnvironmentLight* pEnvironment = pScene->createLight<EnvironmentLight>(Matrix44(), light.power);
+            std::string filename = joinPath(desc.directory, desc.getString(light.filename));
+            if (!pEnvironment->loadHDR(filename))
+                return fail("can't read environment map " + filename);
+            pLight = pEnvironment;
+        }
+        pLight->enableShadowing(light.shadowing);
+        pScene->addLight(pLight);
+    }
+
+    for (const SphereDescription& sphere : desc.spheres)
+    {
+        if (sphere.material >= materials.size() || (U64)sphere.transform + 1 >= desc.transforms.size())
+            return fail("sphere refers to a missing material or transform");
+        Sphere shape;
+        shape.m_localToWorld = desc.transforms[sphere.transform];
+        shape.m_worldToLocal = desc.transforms[sphere.transform + 1];
+        shape.m_radius = sphere.radius;
+        Sphere* pShape = &pScene->getSphere(pScene->createSphere(shape));
+        DiffuseAreaLight* pArea = nullptr;
+        if (sphere.emission.x > 0.f || sphere.emission.y > 0.f || sphere.emission.z > 0.f)
+        {
+            pArea = pScene->createLight<DiffuseAreaLight>(pShape->m_localToWorld, 1, pShape, sphere.emission);
+            pScene->addLight(pArea);
+        }
+        pScene->createPrimitive(pShape, materials[sphere.material], pArea);
+    }
+
+    for (const MeshDescription& mesh : desc.meshes)
+    {
+        if (mesh.material >= materials.size())
+            return fail("mesh refers to a missing material");
+        TriangleList* pList = new TriangleList();
+        assets.meshes.emplace_back(pList);
+        pList->setVertices((U32)mesh.positions.size(), mesh.positions.pData,
+                           mesh.normals.empty() ? nullptr : mesh.normals.pData,
+                           mesh.tangents.empty() ? nullptr : mesh.tangents.pData,
+                           mesh.uvs.empty() ? nullptr : mesh.uvs.pData);
+        pList->setIndices((U32)(mesh.indices.size() / 3), mesh.indices.pData);
+        IMaterial* pMaterial = materials[mesh.material];
+        for (U32 i = 0; i < pList->getTriangleCount(); ++i)
+        {
+            Handle<Triangle> triangle = pScene->createTriangle(pList->getTriangle(i));
+            pScene->createPrimitive(&pScene->getTriangle(triangle), pMaterial);
+        }
+    }
+    pScene->addCreatedPrimitives();
+
+    // The camera looks down its +z, the same as lookAt's view matrix.
+    const CameraDescription& camera = desc.camera;
+    Float2 resolution((F32)camera.width, (F32)camera.height);
+    assets.width = camera.width;
+    assets.height = camera.height;
+    assets.camera.update(identity());
+    assets.camera.adjustScreenToRaster(resolution);
+    assets.camera.updateProjection(RT_RAD(camera.fov), resolution.x / resolution.y, camera.nearPlane, camera.farPlane);
+    assets.camera.update(inverse(lookAt(camera.position, camera.target, camera.up)));
+    return true;
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,263 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+#include "math/Matrix44.hpp"
+
+#include "geometry/Sphere.hpp"
+#include "geometry/TriangleList.hpp"
+#include "loader/MappedFile.hpp"
+#include "scene/Camera.hpp"
+#include "texture/Texture.hpp"
+#include "texture/TextureSampler.hpp"
+#include "texture/TileCache.hpp"
+
+#include <memory>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+struct IMaterial;
+struct Light;
+class Scene;
+
+
+// Read only array that doesn't own its elements, they live in a mapped file or in the
+// storage of the description holding the view.
+template <typename T>
+struct ArrayView
+{
+    const T*    pData = nullptr;
+    U64         count = 0;
+
+    const T& operator[](U64 i) const { return pData[i]; }
+    const T* begin() const { return pData; }
+    const T* end() const { return pData + count; }
+    U64 size() const { return count; }
+    B32 empty() const { return count == 0; }
+};
+
+struct CameraDescription
+{
+    Float3  position            = Float3(0.f, 0.f, -10.f);
+    Float3  target              = Float3(0.f, 0.f, 0.f);
+    Float3  up                  = Float3(0.f, 1.f, 0.f);
+    // Vertical field of view, in degrees.
+    F32     fov                 = 45.f;
+    F32     nearPlane           = 0.001f;
+    F32     farPlane            = 1000.f;
+    U32     width               = 1920;
+    U32     height              = 1080;
+};
+
+enum class MaterialType : U32
+{
+    Matte,
+    Microfacet
+};
+
+struct MaterialDescription
+{
+    MaterialType    type;
+    Float3          color;
+    F32             roughness;
+    F32             metallic;
+    // Offsets of baked texture file names in the string table, zero for none. Microfacet only,
+    // laid out as MicrofacetMaterial expects them.
+    U32             albedoTexture;
+    U32             normalTexture;
+    U32             metallicRoughnessTexture;
+    U32             aoTexture;
+};
+
+enum class LightType : U32
+{
+    Point,
+    Directional,
+    Environment
+};
+
+struct LightDescription
+{
+    LightType   type;
+    B32         shadowing;
+    // Position of point lights, direction towards directional lights.
+    Float3      vector;
+    // Intensity of point lights, radiance of directional lights, scale of environment lights.
+    Float3      power;
+    // Offset of the environment map's file name in the string table, relative to the scene file.
+    U32         filename;
+};
+
+struct SphereDescription
+{
+    // Index of the sphere's local to world matrix in the transform array, world to local follows it.
+    U32         transform;
+    U32         material;
+    F32         radius;
+    // Radiance emitted by the surface, spheres that emit become area lights.
+    Float3      emission;
+};
+
+// Triangle mesh with world space vertices, ready to be referenced by a TriangleList as is.
+struct MeshDescription
+{
+    U32                 material;
+    ArrayView<Float3>   positions;
+    // Optional, empty or one per position.
+    ArrayView<Float3>   normals;
+    ArrayView<Float3>   tangents;
+    ArrayView<Float2>   uvs;
+    // Three per triangle.
+    ArrayView<U32>      indices;
+};
+
+// Everything in a scene file, as plain arrays. Parsing text fills arrays owned by the
+// description, loading a binary scene maps the file and points straight into it.
+struct SceneDescription
+{
+    SceneDescription() { }
+    ~SceneDescription() { clear(); }
+
+    SceneDescription(const SceneDescription&) = delete;
+    SceneDescription& operator=(const SceneDescription&) = delete;
+
+    void clear();
+
+    // Copy count elements into storage owned by the description, and view them.
+    template <typename T>
+    ArrayView<T> store(const T* pData, U64 count)
+    {
+        ArrayView<T> view;
+        if (count == 0)
+            return view;
+        void* pCopy = allocate(sizeof(T) * count);
+        memcpy(pCopy, pData, sizeof(T) * count);
+        view.pData = (const T*)pCopy;
+        view.count = count;
+        return view;
+    }
+
+    template <typename T>
+    ArrayView<T> store(const std::vector<T>& v) { return store(v.data(), v.size()); }
+
+    // Take over a vector instead of copying it, for arrays that were built up anyway.
+    template <typename T>
+    ArrayView<T> adopt(std::vector<T>&& v)
+    {
+        ArrayView<T> view;
+        if (v.empty())
+            return view;
+        std::shared_ptr<std::vector<T>> pOwned = std::make_shared<std::vector<T>>(std::move(v));
+        m_adopted.push_back(pOwned);
+        view.pData = pOwned->data();
+        view.count = pOwned->size();
+        return view;
+    }
+
+    // Name at an offset into the string table.
+    const char* getString(U32 offset) const { return offset < strings.count ? &strings[offset] : ""; }
+
+    CameraDescription               camera;
+    ArrayView<MaterialDescription>  materials;
+    ArrayView<LightDescription>     lights;
+    ArrayView<SphereDescription>    spheres;
+    ArrayView<Matrix44>             transforms;
+    ArrayView<MeshDescription>      meshes;
+    // Null terminated names, referenced by offset.
+    ArrayView<char>                 strings;
+    // Directory of the scene file, relative names are looked up from here.
+    std::string                     directory;
+
+private:
+    void* allocate(U64 size);
+
+    std::vector<void*>              m_storage;
+    std::vector<std::shared_ptr<void>> m_adopted;
+    MappedFile                      m_file;
+
+    friend class Loader;
+};
+
+// What a description builds besides the scene's own objects. Shapes, primitives, materials
+// and lights belong to the scene, but its triangles and materials point at these, and meshes
+// point at the description's arrays, so both have to outlive the scene.
+struct SceneAssets
+{
+    Camera                                      camera;
+    U32                                         width   = 0;
+    U32                                         height  = 0;
+    // Textures are opened once per file, and sampled through one cache shared by every material.
+    std::vector<std::unique_ptr<Texture>>       textures;
+    std::unique_ptr<TileCache>                  tileCache;
+    std::unique_ptr<TextureSampler>             textureSampler;
+    std::vector<std::unique_ptr<TriangleList>>  meshes;
+};
+
+// Reads scene descriptions from text, and to and from a binary format that is mapped instead
+// of parsed. The binary file stores every array already laid out as the renderer uses it,
+// aligned to cache lines, so loading a scene is a header check and a few pointer fixups.
+//
+// The text format is a list of statements, one keyword each followed by its values. Names may
+// be quoted, and # comments out the rest of a line.
+//
+//     film 1920 1080
+//     camera position 0 50 -50 target 0 0 0 up 0 1 0 fov 45
+//     material red matte color 0.8 0.1 0.1
+//     material gold microfacet color 1 0.8 0.3 roughness 0.2 metallic 1
+//     material rust microfacet albedo "rust.tex" metallicRoughness "rust_mr.tex" normal "rust_n.tex"
+//     light point position 0 10 0 intensity 100 100 100 shadows 1
+//     light directional direction 0 1 0 radiance 3 3 3
+//     light environment file "sky.hdr" intensity 1 1 1
+//     {
+//         translate 0 1 0
+//         rotate 90 1 0 0
+//         scale 2 2 2
+//         sphere red radius 1 emission 0 0 0
+//         mesh gold positions 3 0 0 0 1 0 0 0 1 0 indices 1 0 1 2 normals 3 ... uvs 3 ...
+//         obj gold file "bunny.obj"
+//         gltf file "car.glb"
+//     }
+//
+// Transforms apply to the shapes after them, innermost first, and braces save and restore
+// the current transform. Mesh vertices are transformed to world space as they are read.
+// glTF files bring their own materials, and their meshes are referenced in place when the
+// current transform is the identity.
+class Loader
+{
+public:
+    // Load a text or binary scene, told apart by the binary file's magic number.
+    B32 load(const std::string& filename, SceneDescription& desc);
+
+    B32 loadText(const std::string& filename, SceneDescription& desc);
+    // Parse a text description already in memory, pText[length] must be a null terminator.
+    // Files it refers to are looked up relative to desc.directory.
+    B32 parseText(const char* pText, U64 length, SceneDescription& desc);
+
+    // Map a binary scene, leaving desc pointing into the mapping.
+    B32 loadBinary(const std::string& filename, SceneDescription& desc);
+    B32 saveBinary(const std::string& filename, const SceneDescription& desc);
+
+    // Create the materials, shapes, lights and camera described, in the scene's arenas, and add
+    // them to the scene. The scene's aggregate should be set first, primitives are added to it here.
+    B32 build(const SceneDescription& desc, Scene* pScene, SceneAssets& assets);
+
+    // What went wrong with the last call that failed.
+    const std::string& getError() const { return m_error; }
+
+private:
+    B32 fail(const std::string& error);
+    // Resolve a name relative to the scene's directory, unless it's absolute.
+    static std::string joinPath(const std::string& directory, const std::string& name);
+    // Add the materials and meshes of a glTF file, placed by transform, to the arrays of a text
+    // scene being parsed. The file stays mapped by desc, and meshes reference it where they can.
+    B32 importGltf(const std::string& name, const Matrix44& transform, SceneDescription& desc,
+                   std::vector<MaterialDescription>& materials, std::vector<MeshDescription>& meshes,
+                   std::vector<char>& strings);
+
+    std::string m_error;
+};
+} // rt
\ No newline at end of file
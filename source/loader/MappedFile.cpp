@@ -0,0 +1,100 @@
+// Raytracer.
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rt {
+
+
+MappedFile::MappedFile()
+    : m_pData(nullptr)
+    , m_size(0)
+#if defined(_WIN32)
+    , m_file(nullptr)
+    , m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+B32 MappedFile::open(const std::string& filename)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void* pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!pData)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_pData = (const U8*)pData;
+    m_size = (U64)size.QuadPart;
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* pData = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (pData == MAP_FAILED)
+        return false;
+    m_pData = (const U8*)pData;
+    m_size = (U64)info.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!m_pData)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(m_pData);
+    CloseHandle((HANDLE)m_mapping);
+    CloseHandle((HANDLE)m_file);
+    m_file = nullptr;
+    m_mapping = nullptr;
+#else
+    munmap((void*)m_pData, (size_t)m_size);
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,38 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <string>
+
+namespace rt {
+
+
+// Read only view of a whole file, mapped into the address space instead of read. Pages are
+// loaded by the OS on first touch and shared with the file cache, so opening is nearly free
+// no matter the size, and data can be used in place without a copy.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    B32 open(const std::string& filename);
+    void close();
+
+    B32 isOpen() const { return m_pData != nullptr; }
+    const U8* getData() const { return m_pData; }
+    U64 getSize() const { return m_size; }
+
+private:
+    const U8*   m_pData;
+    U64         m_size;
+#if defined(_WIN32)
+    void*       m_file;
+    void*       m_mapping;
+#endif
+};
+} // rt
\ No newline at end of file
@@ -0,0 +1,452 @@
+// Raytracer.
+#include "ObjImporter.hpp"
+
+#include "common/Threading.hpp"
+#include "loader/MappedFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+namespace rt {
+
+
+// Big enough that splitting and merging costs nothing next to parsing.
+static const U64 kChunkSize = 4ull << 20;
+// Vertex deduplication is split over this many hash tables, picked by the top bits of the hash.
+static const U32 kShardBits = 6;
+static const U32 kShardCount = 1u << kShardBits;
+static const I32 kNoIndex = -1;
+
+// Indices of one face corner, 0 based. Missing uvs and normals are kNoIndex.
+struct ObjCorner
+{
+    I32 position;
+    I32 uv;
+    I32 normal;
+
+    bool operator==(const ObjCorner& rh) const
+    {
+        return position == rh.position && uv == rh.uv && normal == rh.normal;
+    }
+};
+
+struct ObjChunk
+{
+    const char*             pBegin;
+    const char*             pEnd;
+    std::vector<Float3>     positions;
+    std::vector<Float2>     uvs;
+    std::vector<Float3>     normals;
+    // Three per triangle.
+    std::vector<ObjCorner>  corners;
+    // Negative indices count back from the last vertex read, which may be in an earlier chunk.
+    // They're kept relative to the start of this chunk, with a bit per attribute set here, and
+    // fixed up once the chunks before have been counted. Empty until the first one turns up.
+    std::vector<U8>         relative;
+    B32                     hasRelative = false;
+    // Global indices of the corners that hash to each shard, in order.
+    std::vector<U32>        shards[kShardCount];
+    B32                     failed = false;
+    B32                     hasUVs = false;
+    B32                     hasNormals = false;
+    // Where this chunk's elements start in the whole file.
+    U64                     positionBase = 0;
+    U64                     uvBase = 0;
+    U64                     normalBase = 0;
+    U64                     cornerBase = 0;
+};
+
+static const char* skipSpace(const char* p, const char* pEnd)
+{
+    while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+    return p;
+}
+
+static const char* parseFloat(const char* p, const char* pEnd, F32& value)
+{
+    p = skipSpace(p, pEnd);
+    // from_chars doesn't take a leading plus.
+    if (p < pEnd && *p == '+')
+        ++p;
+    std::from_chars_result result = std::from_chars(p, pEnd, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+static const char* parseInt(const char* p, const char* pEnd, I32& value)
+{
+    std::from_chars_result result = std::from_chars(p, pEnd, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+// One corner of a face, "v", "v/vt", "v//vn" or "v/vt/vn". Indices left out are 0.
+static const char* parseCorner(const char* p, const char* pEnd, I32 index[3])
+{
+    index[0] = index[1] = index[2] = 0;
+    p = parseInt(p, pEnd, index[0]);
+    if (!p || p == pEnd || *p != '/')
+        return p;
+    ++p;
+    if (p < pEnd && *p != '/')
+    {
+        p = parseInt(p, pEnd, index[1]);
+        if (!p)
+            return nullptr;
+    }
+    if (p < pEnd && *p == '/')
+        p = parseInt(p + 1, pEnd, index[2]);
+    return p;
+}
+
+static U64 hashCorner(const ObjCorner& corner)
+{
+    U64 h = (U64)(U32)corner.position * 0x9E3779B97F4A7C15ull;
+    h ^= ((U64)(U32)corner.uv + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+    h ^= ((U64)(U32)corner.normal + 0x85EBCA77C2B2AE63ull) * 0x165667B19E3779F9ull;
+    return h ^ (h >> 29);
+}
+
+static B32 isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static void parseChunk(ObjChunk& chunk)
+{
+    std::vector<ObjCorner> face;
+    std::vector<U8> faceRelative;
+    const char* p = chunk.pBegin;
+    while (p < chunk.pEnd && !chunk.failed)
+    {
+        const char* pLineEnd = (const char*)memchr(p, '\n', chunk.pEnd - p);
+        if (!pLineEnd)
+            pLineEnd = chunk.pEnd;
+        const char* q = skipSpace(p, pLineEnd);
+        p = pLineEnd + 1;
+        if (pLineEnd - q < 3)
+            continue;
+
+        if (q[0] == 'v' && isBlank(q[1]))
+        {
+            Float3 v;
+            q = parseFloat(q + 2, pLineEnd, v.x);
+            q = q ? parseFloat(q, pLineEnd, v.y) : nullptr;
+            q = q ? parseFloat(q, pLineEnd, v.z) : nullptr;
+            chunk.failed = !q;
+            chunk.positions.push_back(v);
+        }
+        else if (q[0] == 'v' && q[1] == 't' && isBlank(q[2]))
+        {
+            // The second coordinate is optional. Flipped so the origin is at the top left, like textures.
+            Float2 uv;
+            q = parseFloat(q + 3, pLineEnd, uv.x);
+            chunk.failed = !q;
+            if (q && skipSpace(q, pLineEnd) < pLineEnd)
+                chunk.failed = !parseFloat(q, pLineEnd, uv.y);
+            uv.y = 1.f - uv.y;
+            chunk.uvs.push_back(uv);
+        }
+        else if (q[0] == 'v' && q[1] == 'n' && isBlank(q[2]))
+        {
+            Float3 n;
+            q = parseFloat(q + 3, pLineEnd, n.x);
+            q = q ? parseFloat(q, pLineEnd, n.y) : nullptr;
+            q = q ? parseFloat(q, pLineEnd, n.z) : nullptr;
+            chunk.failed = !q;
+            chunk.normals.push_back(n);
+        }
+        else if (q[0] == 'f' && isBlank(q[1]))
+        {
+            face.clear();
+            faceRelative.clear();
+            q = skipSpace(q + 1, pLineEnd);
+            while (q < pLineEnd)
+            {
+                I32 index[3];
+                q = parseCorner(q, pLineEnd, index);
+                if (!q || index[0] == 0)
+                {
+                    chunk.failed = true;
+                    break;
+                }
+                // Resolve to 0 based indices, negative ones relative to the start of the chunk.
+                const U64 counts[3] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+                ObjCorner corner;
+                I32* pResolved[3] = { &corner.position, &corner.uv, &corner.normal };
+                U8 relative = 0;
+                for (U32 a = 0; a < 3; ++a)
+                {
+                    if (index[a] > 0)
+                        *pResolved[a] = index[a] - 1;
+                    else if (index[a] == 0)
+                        *pResolved[a] = kNoIndex;
+                    else
+                    {
+                        *pResolved[a] = (I32)counts[a] + index[a];
+                        relative |= 1 << a;
+                    }
+                }
+                if (relative && !chunk.hasRelative)
+                {
+                    chunk.relative.resize(chunk.corners.size(), 0);
+                    chunk.hasRelative = true;
+                }
+                face.push_back(corner);
+                faceRelative.push_back(relative);
+                q = skipSpace(q, pLineEnd);
+            }
+            if (chunk.failed || face.size() < 3)
+            {
+                chunk.failed = true;
+                break;
+            }
+            // Fan the polygon out into triangles.
+            for (U64 k = 1; k + 1 < face.size(); ++k)
+            {
+                chunk.corners.push_back(face[0]);
+                chunk.corners.push_back(face[k]);
+                chunk.corners.push_back(face[k + 1]);
+                if (chunk.hasRelative)
+                {
+                    chunk.relative.push_back(faceRelative[0]);
+                    chunk.relative.push_back(faceRelative[k]);
+                    chunk.relative.push_back(faceRelative[k + 1]);
+                }
+            }
+        }
+    }
+}
+
+// Tangents along increasing u, from each triangle's uv gradient. Every vertex sums the tangents
+// of the triangles around it, found through a vertex to triangle table, so threads each own a
+// range of vertices and never write to the same one.
+static void generateTangents(ObjMesh& mesh)
+{
+    U32 triangleCount = (U32)(mesh.indices.size() / 3);
+    U32 vertexCount = (U32)mesh.positions.size();
+    std::vector<Float3> faceTangents(triangleCount);
+    parallelFor(triangleCount, [&] (U32 begin, U32 end) -> void {
+        for (U32 t = begin; t < end; ++t)
+        {
+            const U32* pIndex = &mesh.indices[(U64)t * 3];
+            Float3 e1 = mesh.positions[pIndex[1]] - mesh.positions[pIndex[0]];
+            Float3 e2 = mesh.positions[pIndex[2]] - mesh.positions[pIndex[0]];
+            Float2 d1 = mesh.uvs[pIndex[1]] - mesh.uvs[pIndex[0]];
+            Float2 d2 = mesh.uvs[pIndex[2]] - mesh.uvs[pIndex[0]];
+            F32 det = d1.x * d2.y - d2.x * d1.y;
+            // Larger triangles weigh more, the tangent isn't normalized.
+            faceTangents[t] = fabsf(det) > 1e-12f ? (e1 * d2.y - e2 * d1.y) * (1.f / det) * length(cross(e1, e2)) : Float3();
+        }
+    });
+
+    std::vector<U32> offsets((U64)vertexCount + 1, 0);
+    for (U32 index : mesh.indices)
+        ++offsets[index + 1];
+    for (U32 v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<U32> adjacent(mesh.indices.size());
+    {
+        std::vector<U32> cursor(offsets.begin(), offsets.end() - 1);
+        for (U64 i = 0; i < mesh.indices.size(); ++i)
+            adjacent[cursor[mesh.indices[i]]++] = (U32)(i / 3);
+    }
+
+    mesh.tangents.resize(vertexCount);
+    B32 hasNormals = !mesh.normals.empty();
+    parallelFor(vertexCount, [&] (U32 begin, U32 end) -> void {
+        for (U32 v = begin; v < end; ++v)
+        {
+            Float3 t;
+            for (U32 i = offsets[v]; i < offsets[v + 1]; ++i)
+                t = t + faceTangents[adjacent[i]];
+            // Gram-Schmidt against the shading normal.
+            Float3 n = hasNormals ? mesh.normals[v] : Float3();
+            t = t - n * dot(n, t);
+            F32 len = length(t);
+            if (len > 0.f)
+                t = t / len;
+            else if (hasNormals && dot(n, n) > 0.f)
+            {
+                Float3 b;
+                coordinateSystem(normalize(n), t, b);
+            }
+            else
+                t = Float3(1.f, 0.f, 0.f);
+            mesh.tangents[v] = t;
+        }
+    });
+}
+
+B32 importObj(const std::string& filename, ObjMesh& mesh)
+{
+    mesh = ObjMesh();
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+
+    // Chunks end just after a newline, so no line is split between two.
+    const char* pText = (const char*)file.getData();
+    const char* pTextEnd = pText + file.getSize();
+    std::vector<ObjChunk> chunks((file.getSize() + kChunkSize - 1) / kChunkSize);
+    const char* pBegin = pText;
+    for (U64 i = 0; i < chunks.size(); ++i)
+    {
+        const char* pEnd = i + 1 < chunks.size() ? pText + (i + 1) * kChunkSize : pTextEnd;
+        if (pEnd < pBegin)
+            pEnd = pBegin;
+        const char* pNewline = (const char*)memchr(pEnd, '\n', pTextEnd - pEnd);
+        pEnd = pNewline && pEnd < pTextEnd ? pNewline + 1 : pTextEnd;
+        chunks[i].pBegin = pBegin;
+        chunks[i].pEnd = pEnd;
+        pBegin = pEnd;
+    }
+
+    parallelFor((U32)chunks.size(), [&] (U32 begin, U32 end) -> void {
+        for (U32 i = begin; i < end; ++i)
+            parseChunk(chunks[i]);
+    });
+
+    U64 positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (chunk.failed)
+            return false;
+        chunk.positionBase = positionCount;
+        chunk.uvBase = uvCount;
+        chunk.normalBase = normalCount;
+        chunk.cornerBase = cornerCount;
+        positionCount += chunk.positions.size();
+        uvCount += chunk.uvs.size();
+        normalCount += chunk.normals.size();
+        cornerCount += chunk.corners.size();
+    }
+    // Indices are stored in 32 bits.
+    if (positionCount > INT_MAX || uvCount > INT_MAX || normalCount > INT_MAX || cornerCount > UINT_MAX)
+        return false;
+
+    // Gather everything into whole file arrays, fixing up relative indices and checking ranges.
+    std::vector<Float3> positions(positionCount);
+    std::vector<Float2> uvs(uvCount);
+    std::vector<Float3> normals(normalCount);
+    std::vector<ObjCorner> corners(cornerCount);
+    parallelFor((U32)chunks.size(), [&] (U32 begin, U32 end) -> void {
+        for (U32 i = begin; i < end; ++i)
+        {
+            ObjChunk& chunk = chunks[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+            std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvBase);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+            for (U64 c = 0; c < chunk.corners.size(); ++c)
+            {
+                ObjCorner corner = chunk.corners[c];
+                U8 relative = chunk.hasRelative ? chunk.relative[c] : 0;
+                if (relative & 1) corner.position += (I32)chunk.positionBase;
+                if (relative & 2) corner.uv += (I32)chunk.uvBase;
+                if (relative & 4) corner.normal += (I32)chunk.normalBase;
+                if (corner.position < 0 || (U64)corner.position >= positionCount ||
+                    corner.uv < kNoIndex || (corner.uv != kNoIndex && (U64)corner.uv >= uvCount) ||
+                    corner.normal < kNoIndex || (corner.normal != kNoIndex && (U64)corner.normal >= normalCount))
+                {
+                    chunk.failed = true;
+                    break;
+                }
+                chunk.hasUVs |= corner.uv != kNoIndex;
+                chunk.hasNormals |= corner.normal != kNoIndex;
+                U64 global = chunk.cornerBase + c;
+                corners[global] = corner;
+                chunk.shards[hashCorner(corner) >> (64 - kShardBits)].push_back((U32)global);
+            }
+            chunk.positions = std::vector<Float3>();
+            chunk.uvs = std::vector<Float2>();
+            chunk.normals = std::vector<Float3>();
+            chunk.corners = std::vector<ObjCorner>();
+            chunk.relative = std::vector<U8>();
+        }
+    });
+    B32 hasUVs = false;
+    B32 hasNormals = false;
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.failed)
+            return false;
+        hasUVs |= chunk.hasUVs;
+        hasNormals |= chunk.hasNormals;
+    }
+
+    // Each shard finds, for every corner hashing to it, the first corner with the same indices.
+    // Corners are inserted in file order, so whatever is found in the table came first.
+    std::vector<U32> first(cornerCount);
+    parallelFor(kShardCount, [&] (U32 begin, U32 end) -> void {
+        std::vector<U32> slots;
+        for (U32 shard = begin; shard < end; ++shard)
+        {
+            U64 count = 0;
+            for (const ObjChunk& chunk : chunks)
+                count += chunk.shards[shard].size();
+            U64 capacity = 16;
+            while (capacity < count * 2)
+                capacity *= 2;
+            slots.assign(capacity, ~0u);
+            for (const ObjChunk& chunk : chunks)
+            {
+                for (U32 c : chunk.shards[shard])
+                {
+                    const ObjCorner& corner = corners[c];
+                    U64 slot = hashCorner(corner) & (capacity - 1);
+                    while (slots[slot] != ~0u && !(corners[slots[slot]] == corner))
+                        slot = (slot + 1) & (capacity - 1);
+                    if (slots[slot] == ~0u)
+                        slots[slot] = c;
+                    first[c] = slots[slot];
+                }
+            }
+        }
+    });
+    chunks.clear();
+
+    // Number vertices in order of first use. Every corner's first copy comes before it, so
+    // one pass over the corners in order is enough.
+    mesh.indices.resize(cornerCount);
+    U32 vertexCount = 0;
+    for (U64 c = 0; c < cornerCount; ++c)
+        mesh.indices[c] = first[c] == c ? vertexCount++ : mesh.indices[first[c]];
+
+    mesh.positions.resize(vertexCount);
+    if (hasUVs)
+        mesh.uvs.resize(vertexCount);
+    if (hasNormals)
+        mesh.normals.resize(vertexCount);
+    parallelFor((U32)(cornerCount / 3), [&] (U32 begin, U32 end) -> void {
+        for (U64 c = (U64)begin * 3; c < (U64)end * 3; ++c)
+        {
+            if (first[c] != c)
+                continue;
+            const ObjCorner& corner = corners[c];
+            U32 v = mesh.indices[c];
+            mesh.positions[v] = positions[corner.position];
+            if (hasUVs)
+                mesh.uvs[v] = corner.uv != kNoIndex ? uvs[corner.uv] : Float2();
+            if (hasNormals)
+            {
+                if (corner.normal != kNoIndex)
+                    mesh.normals[v] = normalize(normals[corner.normal]);
+                else
+                {
+                    // Corners without a normal take their face's.
+                    U64 t = c - c % 3;
+                    const Float3& p0 = positions[corners[t].position];
+                    mesh.normals[v] = normalize(cross(positions[corners[t + 1].position] - p0,
+                                                      positions[corners[t + 2].position] - p0));
+                }
+            }
+        }
+    });
+
+    if (hasUVs)
+        generateTangents(mesh);
+    return true;
+}
+} // rt
\ No newline at end of file
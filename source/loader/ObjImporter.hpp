@@ -0,0 +1,32 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+#include <string>
+#include <vector>
+
+namespace rt {
+
+
+// Triangle mesh read from a Wavefront OBJ file, laid out the way TriangleList references it.
+// Each distinct combination of position, uv and normal indices becomes one vertex.
+struct ObjMesh
+{
+    std::vector<Float3> positions;
+    // Empty when the file has none. Corners that leave them out get their face's normal or uv (0, 0).
+    std::vector<Float3> normals;
+    std::vector<Float2> uvs;
+    // Generated from the uvs, so empty without them.
+    std::vector<Float3> tangents;
+    // Three per triangle, polygons are split into fans.
+    std::vector<U32>    indices;
+};
+
+// Import the geometry of an OBJ file, ignoring groups, materials, lines and points. The file is
+// mapped and split into chunks at line boundaries, which are parsed in parallel. Vertices are
+// then deduplicated in parallel, each thread hashing its own share of the index triples, and
+// numbered in order of first use so triangles near each other in the file stay near in memory.
+B32 importObj(const std::string& filename, ObjMesh& mesh);
+} // rt
\ No newline at end of file
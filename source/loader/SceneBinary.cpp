@@ -0,0 +1,202 @@
+// Raytracer.
+#include "Loader.hpp"
+
+#include "common/Memory.hpp"
+
+#include <stdio.h>
+
+namespace rt {
+
+
+// Binary scenes are a header followed by arrays, each starting on a cache line. Every array is
+// stored exactly as SceneDescription views it, in the native (little endian) byte order, so a
+// loaded scene points into the mapped file and nothing is read until it's touched.
+static const char kSceneMagic[4] = { 'R', 'T', 'S', 'C' };
+static const U32 kSceneVersion = 3;
+
+enum SceneSection : U32
+{
+    kSectionMaterials,
+    kSectionLights,
+    kSectionSpheres,
+    kSectionTransforms,
+    kSectionMeshes,
+    kSectionStrings,
+    kSectionCount
+};
+
+struct SectionRecord
+{
+    U64 offset;
+    U64 count;
+};
+
+struct SceneHeader
+{
+    char                magic[4];
+    U32                 version;
+    CameraDescription   camera;
+    SectionRecord       sections[kSectionCount];
+};
+
+// MeshDescription with its views stored as file offsets, absent arrays have a count of zero.
+struct MeshRecord
+{
+    U32             material;
+    U32             pad;
+    SectionRecord   positions;
+    SectionRecord   normals;
+    SectionRecord   tangents;
+    SectionRecord   uvs;
+    SectionRecord   indices;
+};
+
+static U64 alignOffset(U64 offset)
+{
+    return (offset + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+}
+
+// Lays out arrays one after another as they are added, then writes them out in the same order.
+class SceneWriter
+{
+public:
+    SceneWriter() : m_end(alignOffset(sizeof(SceneHeader))) { }
+
+    template <typename T>
+    SectionRecord add(const T* pData, U64 count)
+    {
+        SectionRecord record = { 0, count };
+        if (count == 0)
+            return record;
+        record.offset = m_end;
+        m_arrays.push_back({ pData, sizeof(T) * count, m_end });
+        m_end = alignOffset(m_end + sizeof(T) * count);
+        return record;
+    }
+
+    template <typename T>
+    SectionRecord add(const ArrayView<T>& view) { return add(view.pData, view.count); }
+
+    B32 write(FILE* fp, const SceneHeader& header)
+    {
+        static const U8 kZeros[kCacheLineSize] = { };
+        U64 position = sizeof(SceneHeader);
+        fwrite(&header, sizeof(SceneHeader), 1, fp);
+        for (const Array& array : m_arrays)
+        {
+            fwrite(kZeros, 1, array.offset - position, fp);
+            fwrite(array.pData, 1, array.size, fp);
+            position = array.offset + array.size;
+        }
+        return ferror(fp) == 0;
+    }
+
+private:
+    struct Array
+    {
+        const void* pData;
+        U64         size;
+        U64         offset;
+    };
+
+    std::vector<Array>  m_arrays;
+    U64                 m_end;
+};
+
+B32 Loader::saveBinary(const std::string& filename, const SceneDescription& desc)
+{
+    SceneHeader header = { };
+    memcpy(header.magic, kSceneMagic, 4);
+    header.version = kSceneVersion;
+    header.camera = desc.camera;
+
+    SceneWriter writer;
+    header.sections[kSectionMaterials] = writer.add(desc.materials);
+    header.sections[kSectionLights] = writer.add(desc.lights);
+    header.sections[kSectionSpheres] = writer.add(desc.spheres);
+    header.sections[kSectionTransforms] = writer.add(desc.transforms);
+    header.sections[kSectionStrings] = writer.add(desc.strings);
+    std::vector<MeshRecord> meshes(desc.meshes.size());
+    for (U64 i = 0; i < meshes.size(); ++i)
+    {
+        const MeshDescription& mesh = desc.meshes[i];
+        meshes[i].material = mesh.material;
+        meshes[i].positions = writer.add(mesh.positions);
+        meshes[i].normals = writer.add(mesh.normals);
+        meshes[i].tangents = writer.add(mesh.tangents);
+        meshes[i].uvs = writer.add(mesh.uvs);
+        meshes[i].indices = writer.add(mesh.indices);
+    }
+    header.sections[kSectionMeshes] = writer.add(meshes.data(), meshes.size());
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp)
+        return fail("can't create " + filename);
+    B32 ok = writer.write(fp, header);
+    fclose(fp);
+    return ok ? true : fail("can't write " + filename);
+}
+
+// View count elements of T at a record's offset, if they lie within the file.
+template <typename T>
+static B32 mapSection(const MappedFile& file, const SectionRecord& record, ArrayView<T>& view)
+{
+    view = { };
+    if (record.count == 0)
+        return true;
+    if (record.offset % kCacheLineSize != 0 || record.offset > file.getSize() ||
+        record.count > (file.getSize() - record.offset) / sizeof(T))
+        return false;
+    view.pData = (const T*)(file.getData() + record.offset);
+    view.count = record.count;
+    return true;
+}
+
+B32 Loader::loadBinary(const std::string& filename, SceneDescription& desc)
+{
+    desc.clear();
+    MappedFile& file = desc.m_file;
+    if (!file.open(filename))
+        return fail("can't map " + filename);
+
+    SceneHeader header;
+    if (file.getSize() < sizeof(SceneHeader))
+        return fail(filename + " is not a binary scene");
+    memcpy(&header, file.getData(), sizeof(SceneHeader));
+    if (memcmp(header.magic, kSceneMagic, 4) != 0 || header.version != kSceneVersion)
+        return fail(filename + " is not a binary scene, or from another version");
+
+    ArrayView<MeshRecord> meshes;
+    if (!mapSection(file, header.sections[kSectionMaterials], desc.materials) ||
+        !mapSection(file, header.sections[kSectionLights], desc.lights) ||
+        !mapSection(file, header.sections[kSectionSpheres], desc.spheres) ||
+        !mapSection(file, header.sections[kSectionTransforms], desc.transforms) ||
+        !mapSection(file, header.sections[kSectionStrings], desc.strings) ||
+        !mapSection(file, header.sections[kSectionMeshes], meshes))
+        return fail(filename + " is truncated");
+    if (!desc.strings.empty() && desc.strings[desc.strings.size() - 1] != '\0')
+        return fail(filename + " has a corrupt string table");
+
+    // Only the small mesh table is converted, the vertex and index arrays stay in the mapping.
+    // Indices aren't checked against the vertex counts, that would touch every page of them.
+    std::vector<MeshDescription> views(meshes.size());
+    for (U64 i = 0; i < meshes.size(); ++i)
+    {
+        const MeshRecord& record = meshes[i];
+        MeshDescription& mesh = views[i];
+        mesh.material = record.material;
+        if (!mapSection(file, record.positions, mesh.positions) ||
+            !mapSection(file, record.normals, mesh.normals) ||
+            !mapSection(file, record.tangents, mesh.tangents) ||
+            !mapSection(file, record.uvs, mesh.uvs) ||
+            !mapSection(file, record.indices, mesh.indices))
+            return fail(filename + " is truncated");
+    }
+    desc.meshes = desc.store(views);
+    desc.camera = header.camera;
+
+    size_t slash = filename.find_last_of("/\\");
+    desc.directory = slash == std::string::npos ? std::string() : filename.substr(0, slash);
+    return true;
+}
+} // rt
\ No newline at end of file
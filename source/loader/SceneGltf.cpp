@@ -0,0 +1,577 @@
+// Raytracer.
+#include "Loader.hpp"
+
+#include "common/Threading.hpp"
+#include "loader/Json.hpp"
+#include "math/CommonMath.hpp"
+
+namespace rt {
+
+
+// Binary glTF is a 12 byte header and a list of chunks, the JSON document first and then
+// optionally the binary buffer, each padded to four bytes.
+static const U32 kGlbMagic      = 0x46546C67;
+static const U32 kGlbVersion    = 2;
+static const U32 kGlbChunkJson  = 0x4E4F534A;
+static const U32 kGlbChunkBin   = 0x004E4942;
+
+enum GltfComponentType : U32
+{
+    kGltfByte           = 5120,
+    kGltfUnsignedByte   = 5121,
+    kGltfShort          = 5122,
+    kGltfUnsignedShort  = 5123,
+    kGltfUnsignedInt    = 5125,
+    kGltfFloat          = 5126
+};
+
+static const U32 kGltfTriangles = 4;
+
+struct GltfBuffer
+{
+    const U8*   pData;
+    U64         size;
+};
+
+// An accessor's elements, resolved to a pointer into its buffer.
+struct GltfAccessor
+{
+    const U8*   pData;
+    U64         count;
+    U64         stride;
+    U32         componentType;
+    U32         components;
+    B32         normalized;
+};
+
+static U32 componentSize(U32 componentType)
+{
+    switch (componentType)
+    {
+    case kGltfByte:
+    case kGltfUnsignedByte:     return 1;
+    case kGltfShort:
+    case kGltfUnsignedShort:    return 2;
+    case kGltfUnsignedInt:
+    case kGltfFloat:            return 4;
+    default:                    return 0;
+    }
+}
+
+static U32 componentCount(const std::string& type)
+{
+    return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+}
+
+// Read one element as floats, applying the normalization of integer components.
+static void readElement(const GltfAccessor& accessor, U64 index, F32* pOut)
+{
+    const U8* p = accessor.pData + index * accessor.stride;
+    for (U32 c = 0; c < accessor.components; ++c)
+    {
+        switch (accessor.componentType)
+        {
+        case kGltfFloat:
+            memcpy(&pOut[c], p + c * 4, 4);
+            break;
+        case kGltfUnsignedInt:
+        {
+            U32 u;
+            memcpy(&u, p + c * 4, 4);
+            pOut[c] = (F32)u;
+            break;
+        }
+        case kGltfUnsignedShort:
+        {
+            U16 u;
+            memcpy(&u, p + c * 2, 2);
+            pOut[c] = accessor.normalized ? u / 65535.f : (F32)u;
+            break;
+        }
+        case kGltfShort:
+        {
+            I16 i;
+            memcpy(&i, p + c * 2, 2);
+            pOut[c] = accessor.normalized ? fmaxf(i / 32767.f, -1.f) : (F32)i;
+            break;
+        }
+        case kGltfUnsignedByte:
+            pOut[c] = accessor.normalized ? (unsigned char)p[c] / 255.f : (F32)(unsigned char)p[c];
+            break;
+        default:
+            pOut[c] = accessor.normalized ? fmaxf((I8)p[c] / 127.f, -1.f) : (F32)(I8)p[c];
+            break;
+        }
+    }
+}
+
+static U32 readIndex(const GltfAccessor& accessor, U64 index)
+{
+    const U8* p = accessor.pData + index * accessor.stride;
+    if (accessor.componentType == kGltfUnsignedByte)
+        return (unsigned char)*p;
+    if (accessor.componentType == kGltfUnsignedShort)
+    {
+        U16 u;
+        memcpy(&u, p, 2);
+        return u;
+    }
+    U32 u;
+    memcpy(&u, p, 4);
+    return u;
+}
+
+// True when an accessor can be viewed in place as count elements of T.
+template <typename T>
+static B32 isTightlyPacked(const GltfAccessor& accessor, U32 componentType, U32 components)
+{
+    return accessor.componentType == componentType && accessor.components == components &&
+           !accessor.normalized && accessor.stride == sizeof(T) &&
+           ((uintptr_t)accessor.pData % alignof(T)) == 0;
+}
+
+static B32 isIdentity(const Matrix44& m)
+{
+    Matrix44 id = identity();
+    return memcmp(m.d, id.d, sizeof(m.d)) == 0;
+}
+
+static std::string directoryOf(const std::string& filename)
+{
+    size_t slash = filename.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : filename.substr(0, slash);
+}
+
+// URIs are percent encoded, so names with spaces come as %20.
+static std::string decodeUri(const std::string& uri)
+{
+    std::string out;
+    for (size_t i = 0; i < uri.size(); ++i)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size())
+        {
+            char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+            char* pEnd;
+            long c = strtol(hex, &pEnd, 16);
+            if (pEnd == hex + 2)
+            {
+                out.push_back((char)c);
+                i += 2;
+                continue;
+            }
+        }
+        out.push_back(uri[i]);
+    }
+    return out;
+}
+
+static B32 decodeBase64(const char* pText, U64 length, std::vector<U8>& out)
+{
+    U32 bits = 0;
+    U32 bitCount = 0;
+    out.reserve(length * 3 / 4);
+    for (U64 i = 0; i < length && pText[i] != '='; ++i)
+    {
+        char c = pText[i];
+        U32 value = c >= 'A' && c <= 'Z' ? c - 'A' :
+                    c >= 'a' && c <= 'z' ? c - 'a' + 26 :
+                    c >= '0' && c <= '9' ? c - '0' + 52 :
+                    c == '+' ? 62 : c == '/' ? 63 : 64;
+        if (value == 64)
+            return false;
+        bits = (bits << 6) | value;
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            out.push_back((U8)(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+// Local to parent transform of a node, as a matrix or as scale, then rotation, then translation.
+static Matrix44 nodeTransform(const JsonValue& node)
+{
+    const JsonValue& matrix = node["matrix"];
+    if (matrix.size() == 16)
+    {
+        // Column major with column vectors is the same memory order as our row vectors.
+        Matrix44 m;
+        for (U32 i = 0; i < 16; ++i)
+            m.d[i] = (F32)matrix.at(i).getNumber();
+        return m;
+    }
+    const JsonValue& t = node["translation"];
+    const JsonValue& r = node["rotation"];
+    const JsonValue& s = node["scale"];
+    Float3 translation((F32)t.at(0).getNumber(), (F32)t.at(1).getNumber(), (F32)t.at(2).getNumber());
+    Float3 scaling((F32)s.at(0).getNumber(1.0), (F32)s.at(1).getNumber(1.0), (F32)s.at(2).getNumber(1.0));
+    F32 x = (F32)r.at(0).getNumber(), y = (F32)r.at(1).getNumber(), z = (F32)r.at(2).getNumber();
+    F32 w = (F32)r.at(3).getNumber(1.0);
+    Matrix44 rotation(1.f - 2.f * (y * y + z * z), 2.f * (x * y + z * w), 2.f * (x * z - y * w), 0.f,
+                      2.f * (x * y - z * w), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + x * w), 0.f,
+                      2.f * (x * z + y * w), 2.f * (y * z - x * w), 1.f - 2.f * (x * x + y * y), 0.f,
+                      0.f, 0.f, 0.f, 1.f);
+    return scale(identity(), Float4(scaling, 1.f)) * rotation * translate(identity(), translation);
+}
+
+B32 Loader::importGltf(const std::string& name, const Matrix44& transform, SceneDescription& desc,
+                       std::vector<MaterialDescription>& materials, std::vector<MeshDescription>& meshes,
+                       std::vector<char>& strings)
+{
+    std::string filename = joinPath(desc.directory, name);
+    std::string directory = directoryOf(name);
+    // The description keeps the mapping, meshes point straight into it when they can.
+    std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>();
+    if (!pFile->open(filename))
+        return fail("can't map " + filename);
+    desc.m_adopted.push_back(pFile);
+
+    // Either a .glb with the document in its first chunk, or a .gltf that is only the document.
+    const U8* pData = pFile->getData();
+    U64 size = pFile->getSize();
+    const char* pJson = (const char*)pData;
+    U64 jsonLength = size;
+    GltfBuffer binary = { nullptr, 0 };
+    U32 header[3];
+    if (size >= sizeof(header) && (memcpy(header, pData, sizeof(header)), header[0] == kGlbMagic))
+    {
+        if (header[1] != kGlbVersion || header[2] > size)
+            return fail(filename + " is not a glTF 2.0 binary");
+        U64 offset = sizeof(header);
+        jsonLength = 0;
+        while (offset + 8 <= header[2])
+        {
+            U32 chunk[2];
+            memcpy(chunk, pData + offset, 8);
+            offset += 8;
+            if (chunk[0] > header[2] - offset)
+                return fail(filename + " has a truncated chunk");
+            if (chunk[1] == kGlbChunkJson && jsonLength == 0)
+            {
+                pJson = (const char*)(pData + offset);
+                jsonLength = chunk[0];
+            }
+            else if (chunk[1] == kGlbChunkBin && !binary.pData)
+                binary = { pData + offset, chunk[0] };
+            offset += (chunk[0] + 3) & ~3u;
+        }
+        if (jsonLength == 0)
+            return fail(filename + " has no JSON chunk");
+    }
+
+    JsonValue root;
+    if (!parseJson(pJson, jsonLength, root) || !root.isObject())
+        return fail(filename + " has a malformed JSON document");
+
+    // Buffers are the binary chunk, files next to this one, or base64 inside the document.
+    std::vector<GltfBuffer> buffers;
+    for (const JsonValue& buffer : root["buffers"].elements)
+    {
+        GltfBuffer view = { nullptr, 0 };
+        U64 byteLength = (U64)buffer["byteLength"].getNumber();
+        const std::string& uri = buffer["uri"].getString();
+        if (uri.empty())
+            view = binary;
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            size_t comma = uri.find(";base64,");
+            std::vector<U8> decoded;
+            if (comma == std::string::npos ||
+                !decodeBase64(uri.data() + comma + 8, uri.size() - comma - 8, decoded))
+                return fail(filename + " has a buffer that isn't base64");
+            ArrayView<U8> owned = desc.adopt(std::move(decoded));
+            view = { owned.pData, owned.count };
+        }
+        else
+        {
+            std::string bufferName = joinPath(desc.directory, joinPath(directory, decodeUri(uri)));
+            std::shared_ptr<MappedFile> pBuffer = std::make_shared<MappedFile>();
+            if (!pBuffer->open(bufferName))
+                return fail("can't map " + bufferName);
+            desc.m_adopted.push_back(pBuffer);
+            view = { pBuffer->getData(), pBuffer->getSize() };
+        }
+        if (view.size < byteLength)
+            return fail(filename + " has a buffer shorter than its byteLength");
+        buffers.push_back(view);
+    }
+
+    auto resolveAccessor = [&] (const JsonValue& index, GltfAccessor& out) -> B32 {
+        const JsonValue& accessor = root["accessors"].at(index.getUInt(~0u));
+        const JsonValue& bufferView = root["bufferViews"].at(accessor["bufferView"].getUInt(~0u));
+        U32 buffer = bufferView["buffer"].getUInt(~0u);
+        if (!accessor.isObject() || !bufferView.isObject() || buffer >= buffers.size() ||
+            !accessor["sparse"].isNull())
+            return false;
+        out.componentType = accessor["componentType"].getUInt();
+        out.components = componentCount(accessor["type"].getString());
+        out.normalized = accessor["normalized"].boolean;
+        out.count = (U64)accessor["count"].getNumber();
+        U64 elementSize = (U64)componentSize(out.componentType) * out.components;
+        out.stride = (U64)bufferView["byteStride"].getNumber((F64)elementSize);
+        U64 viewOffset = (U64)bufferView["byteOffset"].getNumber();
+        U64 viewLength = (U64)bufferView["byteLength"].getNumber();
+        U64 offset = (U64)accessor["byteOffset"].getNumber();
+        if (elementSize == 0 || out.count == 0 || out.count > ~0u || out.stride < elementSize ||
+            viewOffset > buffers[buffer].size || viewLength > buffers[buffer].size - viewOffset ||
+            offset > viewLength || (out.count - 1) * out.stride + elementSize > viewLength - offset)
+            return false;
+        out.pData = buffers[buffer].pData + viewOffset + offset;
+        return true;
+    };
+
+    // Textures are only used if the image, or a file of the same name ending in .tex, has been
+    // baked into a tiled texture. There is no PNG or JPEG decoder, embedded images are skipped.
+    auto findTexture = [&] (const JsonValue& info) -> U32 {
+        const JsonValue& texture = root["textures"].at(info["index"].getUInt(~0u));
+        const JsonValue& image = root["images"].at(texture["source"].getUInt(~0u));
+        const std::string& uri = image["uri"].getString();
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+            return 0;
+        std::string candidates[2] = { decodeUri(uri), decodeUri(uri) };
+        size_t dot = candidates[1].find_last_of('.');
+        candidates[1] = candidates[1].substr(0, dot) + ".tex";
+        for (const std::string& candidate : candidates)
+        {
+            std::string textureName = joinPath(directory, candidate);
+            Texture probe;
+            if (!probe.open(joinPath(desc.directory, textureName)))
+                continue;
+            U32 offset = (U32)strings.size();
+            strings.insert(strings.end(), textureName.begin(), textureName.end());
+            strings.push_back('\0');
+            return offset;
+        }
+        return 0;
+    };
+
+    // Metallic-roughness PBR maps onto the microfacet material, factors included.
+    U32 firstMaterial = (U32)materials.size();
+    for (const JsonValue& material : root["materials"].elements)
+    {
+        const JsonValue& pbr = material["pbrMetallicRoughness"];
+        MaterialDescription out = { };
+        out.type = MaterialType::Microfacet;
+        const JsonValue& baseColor = pbr["baseColorFactor"];
+        out.color = Float3((F32)baseColor.at(0).getNumber(1.0), (F32)baseColor.at(1).getNumber(1.0),
+                           (F32)baseColor.at(2).getNumber(1.0));
+        out.roughness = RT_CLAMP((F32)pbr["roughnessFactor"].getNumber(1.0), 0.04f, 1.f);
+        out.metallic = (F32)pbr["metallicFactor"].getNumber(1.0);
+        out.albedoTexture = findTexture(pbr["baseColorTexture"]);
+        out.metallicRoughnessTexture = findTexture(pbr["metallicRoughnessTexture"]);
+        out.normalTexture = findTexture(material["normalTexture"]);
+        out.aoTexture = findTexture(material["occlusionTexture"]);
+        materials.push_back(out);
+    }
+    // Primitives without a material get glTF's default, added the first time it's needed.
+    U32 defaultMaterial = ~0u;
+
+    // Walk the nodes of the default scene, or every root node if there are no scenes.
+    std::vector<std::pair<U32, Matrix44>> stack;
+    const JsonValue& scenes = root["scenes"];
+    const JsonValue& nodes = root["nodes"];
+    if (scenes.size() > 0)
+    {
+        const std::vector<JsonValue>& roots = scenes.at(root["scene"].getUInt(0))["nodes"].elements;
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+            stack.push_back({ it->getUInt(~0u), transform });
+    }
+    else
+    {
+        std::vector<B32> isChild(nodes.size(), false);
+        for (const JsonValue& node : nodes.elements)
+        {
+            for (const JsonValue& child : node["children"].elements)
+            {
+                if (child.getUInt(~0u) < nodes.size())
+                    isChild[child.getUInt()] = true;
+            }
+        }
+        for (U32 i = (U32)nodes.size(); i-- > 0;)
+        {
+            if (!isChild[i])
+                stack.push_back({ i, transform });
+        }
+    }
+
+    // Nodes form a tree, so no more than one visit each unless the file is broken. Children are
+    // pushed in reverse, so meshes come out in the order of the file.
+    U64 visits = 0;
+    while (!stack.empty())
+    {
+        U32 nodeIndex = stack.back().first;
+        Matrix44 parent = stack.back().second;
+        stack.pop_back();
+        const JsonValue& node = nodes.at(nodeIndex);
+        if (!node.isObject() || ++visits > nodes.size())
+            return fail(filename + " has a broken node hierarchy");
+        Matrix44 world = nodeTransform(node) * parent;
+        const std::vector<JsonValue>& children = node["children"].elements;
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            stack.push_back({ it->getUInt(~0u), world });
+
+        const JsonValue& mesh = node["mesh"];
+        if (mesh.isNull())
+            continue;
+        const JsonValue& primitives = root["meshes"].at(mesh.getUInt(~0u))["primitives"];
+        if (!primitives.isArray())
+            return fail(filename + " has a node with a missing mesh");
+
+        B32 inPlace = isIdentity(world);
+        Matrix44 normalTransform = transpose(inverse(world));
+        for (const JsonValue& primitive : primitives.elements)
+        {
+            // Points, lines, strips and fans are left out.
+            if (primitive["mode"].getUInt(kGltfTriangles) != kGltfTriangles)
+                continue;
+            const JsonValue& attributes = primitive["attributes"];
+            GltfAccessor positions;
+            if (!resolveAccessor(attributes["POSITION"], positions) || positions.components != 3)
+                return fail(filename + " has a primitive without valid positions");
+
+            MeshDescription out = { };
+            const JsonValue& material = primitive["material"];
+            if (material.isNull())
+            {
+                if (defaultMaterial == ~0u)
+                {
+                    MaterialDescription fallback = { };
+                    fallback.type = MaterialType::Microfacet;
+                    fallback.color = Float3(1.f, 1.f, 1.f);
+                    fallback.roughness = 1.f;
+                    fallback.metallic = 1.f;
+                    defaultMaterial = (U32)materials.size();
+                    materials.push_back(fallback);
+                }
+                out.material = defaultMaterial;
+            }
+            else if (material.getUInt(~0u) < root["materials"].size())
+                out.material = firstMaterial + material.getUInt();
+            else
+                return fail(filename + " has a primitive with a missing material");
+
+            // Attributes already laid out as TriangleList reads them are referenced in place,
+            // anything else is converted into storage owned by the description.
+            U32 vertexCount = (U32)positions.count;
+            if (inPlace && isTightlyPacked<Float3>(positions, kGltfFloat, 3))
+                out.positions = { (const Float3*)positions.pData, positions.count };
+            else
+            {
+                std::vector<Float3> converted(vertexCount);
+                parallelFor(vertexCount, [&] (U32 begin, U32 end) -> void {
+                    for (U32 i = begin; i < end; ++i)
+                    {
+                        F32 p[3];
+                        readElement(positions, i, p);
+                        converted[i] = Float4(p[0], p[1], p[2], 1.f) * world;
+                    }
+                });
+                out.positions = desc.adopt(std::move(converted));
+            }
+
+            GltfAccessor normals;
+            if (!attributes["NORMAL"].isNull())
+            {
+                if (!resolveAccessor(attributes["NORMAL"], normals) || normals.components != 3 ||
+                    normals.count != positions.count)
+                    return fail(filename + " has a primitive with invalid normals");
+                if (inPlace && isTightlyPacked<Float3>(normals, kGltfFloat, 3))
+                    out.normals = { (const Float3*)normals.pData, normals.count };
+                else
+                {
+                    std::vector<Float3> converted(vertexCount);
+                    parallelFor(vertexCount, [&] (U32 begin, U32 end) -> void {
+                        for (U32 i = begin; i < end; ++i)
+                        {
+                            F32 n[3];
+                            readElement(normals, i, n);
+                            converted[i] = normalize(Float3(Float4(n[0], n[1], n[2], 0.f) * normalTransform));
+                        }
+                    });
+                    out.normals = desc.adopt(std::move(converted));
+                }
+            }
+
+            // glTF tangents carry the bitangent's sign in w, TriangleList only keeps the direction.
+            GltfAccessor tangents;
+            if (!attributes["TANGENT"].isNull())
+            {
+                if (!resolveAccessor(attributes["TANGENT"], tangents) || tangents.components < 3 ||
+                    tangents.count != positions.count)
+                    return fail(filename + " has a primitive with invalid tangents");
+                std::vector<Float3> converted(vertexCount);
+                parallelFor(vertexCount, [&] (U32 begin, U32 end) -> void {
+                    for (U32 i = begin; i < end; ++i)
+                    {
+                        F32 t[4];
+                        readElement(tangents, i, t);
+                        converted[i] = normalize(Float3(Float4(t[0], t[1], t[2], 0.f) * world));
+                    }
+                });
+                out.tangents = desc.adopt(std::move(converted));
+            }
+
+            // Texture coordinates start at the top left, the same as our textures.
+            GltfAccessor uvs;
+            if (!attributes["TEXCOORD_0"].isNull())
+            {
+                if (!resolveAccessor(attributes["TEXCOORD_0"], uvs) || uvs.components != 2 ||
+                    uvs.count != positions.count)
+                    return fail(filename + " has a primitive with invalid texture coordinates");
+                if (isTightlyPacked<Float2>(uvs, kGltfFloat, 2))
+                    out.uvs = { (const Float2*)uvs.pData, uvs.count };
+                else
+                {
+                    std::vector<Float2> converted(vertexCount);
+                    parallelFor(vertexCount, [&] (U32 begin, U32 end) -> void {
+                        for (U32 i = begin; i < end; ++i)
+                        {
+                            F32 uv[2];
+                            readElement(uvs, i, uv);
+                            converted[i] = Float2(uv[0], uv[1]);
+                        }
+                    });
+                    out.uvs = desc.adopt(std::move(converted));
+                }
+            }
+
+            // Unindexed primitives list their vertices in triangle order.
+            if (primitive["indices"].isNull())
+            {
+                std::vector<U32> sequence(vertexCount - vertexCount % 3);
+                for (U32 i = 0; i < sequence.size(); ++i)
+                    sequence[i] = i;
+                out.indices = desc.adopt(std::move(sequence));
+            }
+            else
+            {
+                GltfAccessor indices;
+                if (!resolveAccessor(primitive["indices"], indices) || indices.components != 1 ||
+                    (indices.componentType != kGltfUnsignedByte && indices.componentType != kGltfUnsignedShort &&
+                     indices.componentType != kGltfUnsignedInt))
+                    return fail(filename + " has a primitive with invalid indices");
+                U64 indexCount = indices.count - indices.count % 3;
+                if (isTightlyPacked<U32>(indices, kGltfUnsignedInt, 1))
+                    out.indices = { (const U32*)indices.pData, indexCount };
+                else
+                {
+                    std::vector<U32> converted(indexCount);
+                    for (U64 i = 0; i < indexCount; ++i)
+                        converted[i] = readIndex(indices, i);
+                    out.indices = desc.adopt(std::move(converted));
+                }
+                // Triangles read vertices without checking, so a bad index must not get through.
+                for (U32 index : out.indices)
+                {
+                    if (index >= vertexCount)
+                        return fail(filename + " has an index out of range");
+                }
+            }
+            meshes.push_back(out);
+        }
+    }
+    return true;
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,471 @@
+// Raytracer.
+#include "Loader.hpp"
+
+#include "common/Threading.hpp"
+#include "loader/ObjImporter.hpp"
+#include "math/CommonMath.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+
+namespace rt {
+
+
+// Splits the text into words, skipping whitespace and comments. Braces are words of their own,
+// and quoted names may hold spaces.
+class SceneTokenizer
+{
+public:
+    SceneTokenizer(const char* pText, U64 length)
+        : m_pCursor(pText), m_pEnd(pText + length), m_line(1) { }
+
+    B32 next(std::string& token)
+    {
+        skip();
+        token.clear();
+        if (m_pCursor == m_pEnd)
+            return false;
+        if (*m_pCursor == '{' || *m_pCursor == '}')
+        {
+            token.push_back(*m_pCursor++);
+            return true;
+        }
+        if (*m_pCursor == '"')
+        {
+            ++m_pCursor;
+            while (m_pCursor != m_pEnd && *m_pCursor != '"' && *m_pCursor != '\n')
+                token.push_back(*m_pCursor++);
+            if (m_pCursor != m_pEnd && *m_pCursor == '"')
+                ++m_pCursor;
+            return true;
+        }
+        while (m_pCursor != m_pEnd && !isSpace(*m_pCursor) && *m_pCursor != '#' &&
+               *m_pCursor != '{' && *m_pCursor != '}')
+            token.push_back(*m_pCursor++);
+        return true;
+    }
+
+    // The next word, without consuming it.
+    B32 peek(std::string& token)
+    {
+        const char* pCursor = m_pCursor;
+        U32 line = m_line;
+        B32 found = next(token);
+        m_pCursor = pCursor;
+        m_line = line;
+        return found;
+    }
+
+    B32 readFloat(F32& value)
+    {
+        skip();
+        char* pEnd = nullptr;
+        value = strtof(m_pCursor, &pEnd);
+        if (pEnd == m_pCursor || pEnd > m_pEnd)
+            return false;
+        m_pCursor = pEnd;
+        return true;
+    }
+
+    B32 readFloat3(Float3& value)
+    {
+        return readFloat(value.x) && readFloat(value.y) && readFloat(value.z);
+    }
+
+    B32 readUInt(U32& value)
+    {
+        skip();
+        char* pEnd = nullptr;
+        unsigned long v = strtoul(m_pCursor, &pEnd, 10);
+        if (pEnd == m_pCursor || pEnd > m_pEnd || v > 0xffffffffUL)
+            return false;
+        value = (U32)v;
+        m_pCursor = pEnd;
+        return true;
+    }
+
+    U32 getLine() const { return m_line; }
+
+private:
+    static B32 isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skip()
+    {
+        while (m_pCursor != m_pEnd)
+        {
+            if (*m_pCursor == '#')
+            {
+                while (m_pCursor != m_pEnd && *m_pCursor != '\n')
+                    ++m_pCursor;
+            }
+            else if (isSpace(*m_pCursor))
+            {
+                if (*m_pCursor == '\n')
+                    ++m_line;
+                ++m_pCursor;
+            }
+            else
+                break;
+        }
+    }
+
+    const char* m_pCursor;
+    const char* m_pEnd;
+    U32         m_line;
+};
+
+B32 Loader::loadText(const std::string& filename, SceneDescription& desc)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return fail("can't open " + filename);
+    std::vector<char> text;
+    char buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        text.insert(text.end(), buffer, buffer + read);
+    fclose(fp);
+    // Terminate it, so number parsing always stops inside the buffer.
+    text.push_back('\0');
+
+    size_t slash = filename.find_last_of("/\\");
+    desc.directory = slash == std::string::npos ? std::string() : filename.substr(0, slash);
+
+    if (!parseText(text.data(), text.size() - 1, desc))
+    {
+        m_error = filename + ": " + m_error;
+        return false;
+    }
+    return true;
+}
+
+B32 Loader::parseText(const char* pText, U64 length, SceneDescription& desc)
+{
+    std::string directory = desc.directory;
+    desc.clear();
+    desc.directory = directory;
+    SceneTokenizer tokens(pText, length);
+    std::string token;
+    std::string value;
+
+    std::vector<MaterialDescription> materials;
+    std::vector<LightDescription> lights;
+    std::vector<SphereDescription> spheres;
+    std::vector<Matrix44> transforms;
+    std::vector<MeshDescription> meshes;
+    std::vector<char> strings(1, '\0');
+    std::unordered_map<std::string, U32> materialNames;
+
+    Matrix44 transform = identity();
+    std::vector<Matrix44> stack;
+
+    auto error = [&] (const std::string& message) -> B32 {
+        return fail("line " + std::to_string(tokens.getLine()) + ": " + message);
+    };
+    // Optional parameters follow a statement for as long as the next word is one of its names.
+    auto parameter = [&] (std::initializer_list<const char*> names) -> B32 {
+        if (!tokens.peek(value))
+            return false;
+        for (const char* pName : names)
+        {
+            if (value == pName)
+            {
+                tokens.next(value);
+                return true;
+            }
+        }
+        return false;
+    };
+    auto addString = [&] (const std::string& s) -> U32 {
+        U32 offset = (U32)strings.size();
+        strings.insert(strings.end(), s.begin(), s.end());
+        strings.push_back('\0');
+        return offset;
+    };
+    auto findMaterial = [&] (U32& material) -> B32 {
+        if (!tokens.next(value))
+            return false;
+        auto it = materialNames.find(value);
+        if (it == materialNames.end())
+            return false;
+        material = it->second;
+        return true;
+    };
+
+    while (tokens.next(token))
+    {
+        if (token == "film")
+        {
+            if (!tokens.readUInt(desc.camera.width) || !tokens.readUInt(desc.camera.height) ||
+                desc.camera.width == 0 || desc.camera.height == 0)
+                return error("film expects a width and height");
+        }
+        else if (token == "camera")
+        {
+            CameraDescription& camera = desc.camera;
+            while (parameter({ "position", "target", "up", "fov", "near", "far" }))
+            {
+                B32 ok = value == "position" ? tokens.readFloat3(camera.position) :
+                         value == "target" ? tokens.readFloat3(camera.target) :
+                         value == "up" ? tokens.readFloat3(camera.up) :
+                         value == "fov" ? tokens.readFloat(camera.fov) :
+                         value == "near" ? tokens.readFloat(camera.nearPlane) :
+                                           tokens.readFloat(camera.farPlane);
+                if (!ok)
+                    return error("bad camera " + value);
+            }
+        }
+        else if (token == "material")
+        {
+            std::string name;
+            if (!tokens.next(name) || !tokens.next(value))
+                return error("material expects a name and a type");
+            MaterialDescription material = { };
+            material.color = Float3(0.5f, 0.5f, 0.5f);
+            material.roughness = 0.5f;
+            if (value == "matte")
+                material.type = MaterialType::Matte;
+            else if (value == "microfacet")
+                material.type = MaterialType::Microfacet;
+            else
+                return error("unknown material type " + value);
+            while (parameter({ "color", "roughness", "metallic", "albedo", "normal", "metallicRoughness", "ao" }))
+            {
+                B32 ok = true;
+                if (value == "color")
+                    ok = tokens.readFloat3(material.color);
+                else if (value == "roughness")
+                    ok = tokens.readFloat(material.roughness);
+                else if (value == "metallic")
+                    ok = tokens.readFloat(material.metallic);
+                else
+                {
+                    U32& texture = value == "albedo" ? material.albedoTexture :
+                                   value == "normal" ? material.normalTexture :
+                                   value == "metallicRoughness" ? material.metallicRoughnessTexture :
+                                                                  material.aoTexture;
+                    std::string name = value;
+                    ok = material.type == MaterialType::Microfacet && tokens.next(value);
+                    if (ok)
+                        texture = addString(value);
+                    value = name;
+                }
+                if (!ok)
+                    return error("bad material " + value);
+            }
+            materialNames[name] = (U32)materials.size();
+            materials.push_back(material);
+        }
+        else if (token == "light")
+        {
+            if (!tokens.next(value))
+                return error("light expects a type");
+            LightDescription light = { };
+            light.power = Float3(1.f, 1.f, 1.f);
+            if (value == "point")
+            {
+                light.type = LightType::Point;
+                light.shadowing = true;
+            }
+            else if (value == "directional")
+            {
+                light.type = LightType::Directional;
+                light.shadowing = true;
+                light.vector = Float3(0.f, 1.f, 0.f);
+            }
+            else if (value == "environment")
+                light.type = LightType::Environment;
+            else
+                return error("unknown light type " + value);
+            while (parameter({ "position", "direction", "intensity", "radiance", "shadows", "file" }))
+            {
+                B32 ok = true;
+                U32 shadows = 0;
+                if (value == "position" || value == "direction")
+                    ok = tokens.readFloat3(light.vector);
+                else if (value == "intensity" || value == "radiance")
+                    ok = tokens.readFloat3(light.power);
+                else if (value == "shadows")
+                {
+                    ok = tokens.readUInt(shadows);
+                    light.shadowing = shadows != 0;
+                }
+                else
+                {
+                    ok = tokens.next(value);
+                    light.filename = addString(value);
+                }
+                if (!ok)
+                    return error("bad light parameter");
+            }
+            if (light.type == LightType::Environment && light.filename == 0)
+                return error("environment light needs a file");
+            lights.push_back(light);
+        }
+        else if (token == "{")
+            stack.push_back(transform);
+        else if (token == "}")
+        {
+            if (stack.empty())
+                return error("unmatched }");
+            transform = stack.back();
+            stack.pop_back();
+        }
+        else if (token == "identity")
+            transform = identity();
+        else if (token == "translate")
+        {
+            Float3 t;
+            if (!tokens.readFloat3(t))
+                return error("translate expects x y z");
+            transform = translate(identity(), t) * transform;
+        }
+        else if (token == "rotate")
+        {
+            F32 degrees;
+            Float3 axis;
+            if (!tokens.readFloat(degrees) || !tokens.readFloat3(axis))
+                return error("rotate expects an angle and an axis");
+            transform = rotate(identity(), axis, RT_RAD(degrees)) * transform;
+        }
+        else if (token == "scale")
+        {
+            Float3 s;
+            if (!tokens.readFloat3(s))
+                return error("scale expects x y z");
+            transform = scale(identity(), Float4(s, 1.f)) * transform;
+        }
+        else if (token == "sphere")
+        {
+            SphereDescription sphere = { };
+            sphere.radius = 1.f;
+            if (!findMaterial(sphere.material))
+                return error("sphere needs a known material");
+            while (parameter({ "radius", "emission" }))
+            {
+                B32 ok = value == "radius" ? tokens.readFloat(sphere.radius) : tokens.readFloat3(sphere.emission);
+                if (!ok)
+                    return error("bad sphere " + value);
+            }
+            sphere.transform = (U32)transforms.size();
+            transforms.push_back(transform);
+            transforms.push_back(inverse(transform));
+            spheres.push_back(sphere);
+        }
+        else if (token == "mesh")
+        {
+            MeshDescription mesh = { };
+            if (!findMaterial(mesh.material))
+                return error("mesh needs a known material");
+            std::vector<Float3> positions;
+            std::vector<Float3> normals;
+            std::vector<Float2> uvs;
+            std::vector<U32> indices;
+            // Normals go through the inverse transpose, without the translation.
+            Matrix44 normalTransform = transpose(inverse(transform));
+            while (parameter({ "positions", "normals", "uvs", "indices" }))
+            {
+                U32 count = 0;
+                if (!tokens.readUInt(count))
+                    return error("mesh " + value + " expects a count");
+                B32 ok = true;
+                if (value == "positions")
+                {
+                    positions.resize(count);
+                    for (U32 i = 0; ok && i < count; ++i)
+                    {
+                        ok = tokens.readFloat3(positions[i]);
+                        positions[i] = Float4(positions[i], 1.f) * transform;
+                    }
+                }
+                else if (value == "normals")
+                {
+                    normals.resize(count);
+                    for (U32 i = 0; ok && i < count; ++i)
+                    {
+                        ok = tokens.readFloat3(normals[i]);
+                        normals[i] = normalize(Float3(Float4(normals[i], 0.f) * normalTransform));
+                    }
+                }
+                else if (value == "uvs")
+                {
+                    uvs.resize(count);
+                    for (U32 i = 0; ok && i < count; ++i)
+                        ok = tokens.readFloat(uvs[i].x) && tokens.readFloat(uvs[i].y);
+                }
+                else
+                {
+                    indices.resize((U64)count * 3);
+                    for (U64 i = 0; ok && i < indices.size(); ++i)
+                        ok = tokens.readUInt(indices[i]);
+                }
+                if (!ok)
+                    return error("mesh " + value + " ended early");
+            }
+            if ((!normals.empty() && normals.size() != positions.size()) ||
+                (!uvs.empty() && uvs.size() != positions.size()))
+                return error("mesh normals and uvs must match its positions");
+            for (U32 index : indices)
+            {
+                if (index >= positions.size())
+                    return error("mesh index out of range");
+            }
+            mesh.positions = desc.adopt(std::move(positions));
+            mesh.normals = desc.adopt(std::move(normals));
+            mesh.uvs = desc.adopt(std::move(uvs));
+            mesh.indices = desc.adopt(std::move(indices));
+            meshes.push_back(mesh);
+        }
+        else if (token == "obj")
+        {
+            MeshDescription mesh = { };
+            if (!findMaterial(mesh.material))
+                return error("obj needs a known material");
+            if (!parameter({ "file" }) || !tokens.next(value))
+                return error("obj needs a file");
+            std::string filename = joinPath(directory, value);
+            ObjMesh obj;
+            if (!importObj(filename, obj))
+                return error("can't import " + filename);
+            // Into world space, the same as inline meshes.
+            Matrix44 normalTransform = transpose(inverse(transform));
+            parallelFor((U32)obj.positions.size(), [&] (U32 begin, U32 end) -> void {
+                for (U32 i = begin; i < end; ++i)
+                {
+                    obj.positions[i] = Float4(obj.positions[i], 1.f) * transform;
+                    if (!obj.normals.empty())
+                        obj.normals[i] = normalize(Float3(Float4(obj.normals[i], 0.f) * normalTransform));
+                    if (!obj.tangents.empty())
+                        obj.tangents[i] = normalize(Float3(Float4(obj.tangents[i], 0.f) * transform));
+                }
+            });
+            mesh.positions = desc.adopt(std::move(obj.positions));
+            mesh.normals = desc.adopt(std::move(obj.normals));
+            mesh.tangents = desc.adopt(std::move(obj.tangents));
+            mesh.uvs = desc.adopt(std::move(obj.uvs));
+            mesh.indices = desc.adopt(std::move(obj.indices));
+            meshes.push_back(mesh);
+        }
+        else if (token == "gltf")
+        {
+            if (!parameter({ "file" }) || !tokens.next(value))
+                return error("gltf needs a file");
+            if (!importGltf(value, transform, desc, materials, meshes, strings))
+                return error(m_error);
+        }
+        else
+            return error("unknown statement " + token);
+    }
+    if (!stack.empty())
+        return error("missing }");
+
+    desc.materials = desc.store(materials);
+    desc.lights = desc.store(lights);
+    desc.spheres = desc.store(spheres);
+    desc.transforms = desc.store(transforms);
+    desc.meshes = desc.store(meshes);
+    desc.strings = desc.store(strings);
+    return true;
+}
+} // rt
\ No newline at end of file
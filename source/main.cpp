@@ -1,6 +1,8 @@
 // Raytracer.
+#include "AmbientOcclusion.hpp"
 #include "RayTracer.hpp"
 #include "Light.hpp"
+#include "TraversalHeatmap.hpp"
 
 #include "common/Types.hpp"
 
@@ -10,103 +12,244 @@
 
 #include "framebuffer/RenderTarget.hpp"
 #include "scene/Camera.hpp"
+#include "scene/DefaultScene.hpp"
 #include "scene/Scene.hpp"
 #include "acceleration/SimpleContainer.hpp"
 #include "geometry/Sphere.hpp"
 #include "common/Threading.hpp"
+#include "common/Trace.hpp"
+#include "loader/Loader.hpp"
 
-#include <random>
+#include <errno.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 using namespace rt;
 
+static void printUsage()
+{
+    printf("RayTracer [options] [scene file]\n"
+           "Renders the scene file given, text or binary, or a built in one without it.\n"
+           "  --resolution <w>x<h>  image size, the scene file's or 1920x1080 without\n"
+           "  --spp <n>             camera samples per pixel (1)\n"
+           "  --depth <n>           specular bounces past the first hit (2)\n"
+           "  --threads <n>         render threads, 0 for one per hardware thread (0)\n"
+           "  --tile <n>            width and height of the tiles threads take in turn, rounded to\n"
+           "                        a power of two from 4 to 32 or a multiple of 64 (64)\n"
+           "  --integrator <name>   whitted, ao or heatmap (whitted)\n"
+           "  --output <path>       image written, empty to skip (Test.png)\n"
+           "  --format <name>       png or exr, taken from the output's extension otherwise\n"
+           "  --aovs <path>         EXR the AOVs are written to, if any are enabled (Test_aovs.exr)\n"
+           "  --seed <n>            seeds the built in scene and every pixel's samples (0)\n"
+           "  --export <path>       also save the scene file as a binary scene\n"
+           "  --trace <path>        write a Chrome trace of the run, RT_TRACE sets it too\n"
+           "  --help                show this\n");
+}
+
+// Whole decimal numbers only, so a typo in a sweep's script fails instead of rendering with 0.
+// strtoull would take a sign or leading spaces, and wrap negative numbers around, so the text
+// has to start with a digit. Numbers too large for 64 bits fail too, instead of saturating.
+static B32 readU64(const char* pText, U64& value)
+{
+    char* pEnd = nullptr;
+    if (!pText || pText[0] < '0' || pText[0] > '9')
+        return false;
+    errno = 0;
+    value = (U64)strtoull(pText, &pEnd, 10);
+    return *pEnd == '\0' && errno != ERANGE;
+}
+
+static B32 readU32(const char* pText, U32& value)
+{
+    U64 value64 = 0;
+    if (!readU64(pText, value64) || value64 > 0xffffffffull)
+        return false;
+    value = (U32)value64;
+    return true;
+}
+
+// Width and height as <w>x<h>, both positive.
+static B32 readResolution(const char* pText, U32& width, U32& height)
+{
+    const char* pX = strchr(pText, 'x');
+    if (!pX)
+        return false;
+    std::string widthText(pText, pX - pText);
+    return readU32(widthText.c_str(), width) && readU32(pX + 1, height) && width > 0 && height > 0;
+}
+
+// RayTracer [options] [scene file]
+// Options are listed by printUsage(). With a trace path, a Chrome trace of the run is written there.
 int main(int c, char* argv[])
 {
-    DirectionLight dirLight;
-    dirLight.enableShadowing(true);
-    dirLight.wi = Float3(0.0f, 0.9f, 0.0f);
-    dirLight.l = Float3(30.0f, 30.0f, 30.0f);
-    
-    Scene scene;
-    SimpleContainer aggregate;
-    scene.setAggregate(&aggregate);
-    std::vector<Sphere> spheres;
-    std::vector<Primitive*> primitives;
-    std::vector<IMaterial*> materials;
-
-    std::random_device dev;
-    std::mt19937 mt(dev());
-    std::uniform_real_distribution<F32> cc(0.f, 1.f);
-    std::uniform_real_distribution<F32> xy(-10.f, 10.f);
-    std::uniform_real_distribution<F32> z(-15.f, 15.f);
-    
-    for (U32 i = 0; i < 150; ++i) 
+    const char* pScenePath = nullptr;
+    const char* pExportPath = nullptr;
+    const char* pTracePath = getenv("RT_TRACE");
+    const char* pIntegrator = "whitted";
+    const char* pFormat = nullptr;
+    std::string outputPath = "Test.png";
+    std::string aovPath = "Test_aovs.exr";
+    U32 width = 0;
+    U32 height = 0;
+    U32 samples = 1;
+    U32 maxDepth = 2;
+    U32 threads = 0;
+    U32 tileSize = TiledBuffer::kTileSize;
+    U64 seed = 0;
+    for (I32 i = 1; i < c; ++i)
     {
-        Sphere sphere;
-        sphere.m_localToWorld = rotate(translate(identity(), Float3(xy(mt), xy(mt), z(mt))), Float3(1.0f, 0.0f, 0.0f), RT_RAD(90.0f));
-        sphere.m_worldToLocal = inverse(sphere.m_localToWorld);
-        sphere.m_radius = 1.f;
-        spheres.push_back(sphere);
-        //MatteMaterial* mat =  new MatteMaterial();
-        //mat->color = Float3(cc(mt), cc(mt), cc(mt));
-        MicrofacetMaterial* mat = new MicrofacetMaterial();
-        mat->color = Float3(cc(mt), cc(mt), cc(mt));
-        mat->kD = 0.04f;
-        materials.push_back(mat);
+        const char* pArg = argv[i];
+        if (strcmp(pArg, "--help") == 0)
+        {
+            printUsage();
+            return 0;
+        }
+        if (pArg[0] != '-' && !pScenePath)
+        {
+            pScenePath = pArg;
+            continue;
+        }
+
+        // Every option takes a value.
+        if (i + 1 >= c)
+        {
+            printf("%s needs a value\n", pArg);
+            printUsage();
+            return 1;
+        }
+        const char* pValue = argv[++i];
+        B32 ok = true;
+        if (strcmp(pArg, "--resolution") == 0)
+            ok = readResolution(pValue, width, height);
+        else if (strcmp(pArg, "--spp") == 0)
+            ok = readU32(pValue, samples) && samples > 0;
+        else if (strcmp(pArg, "--depth") == 0)
+            ok = readU32(pValue, maxDepth);
+        else if (strcmp(pArg, "--threads") == 0)
+            ok = readU32(pValue, threads);
+        else if (strcmp(pArg, "--tile") == 0)
+            ok = readU32(pValue, tileSize) && tileSize > 0;
+        else if (strcmp(pArg, "--integrator") == 0)
+            pIntegrator = pValue;
+        else if (strcmp(pArg, "--output") == 0)
+            outputPath = pValue;
+        else if (strcmp(pArg, "--format") == 0)
+            pFormat = pValue;
+        else if (strcmp(pArg, "--aovs") == 0)
+            aovPath = pValue;
+        else if (strcmp(pArg, "--seed") == 0)
+            ok = readU64(pValue, seed);
+        else if (strcmp(pArg, "--export") == 0)
+            pExportPath = pValue;
+        else if (strcmp(pArg, "--trace") == 0)
+            pTracePath = pValue;
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            printf("bad argument %s\n", pArg);
+            printUsage();
+            return 1;
+        }
     }
+
+    std::unique_ptr<Integrator> pIntegratorInstance;
+    if (strcmp(pIntegrator, "whitted") == 0)
+    {
+        pIntegratorInstance.reset(new Integrator());
+        pIntegratorInstance->setTonemapper(Tonemapper(TonemapOperator::Reinhard));
+    }
+    else if (strcmp(pIntegrator, "ao") == 0)
+        pIntegratorInstance.reset(new AmbientOcclusionIntegrator());
+    else if (strcmp(pIntegrator, "heatmap") == 0)
+        pIntegratorInstance.reset(new TraversalHeatmapIntegrator());
+    else
     {
-        Sphere sphere;
-        sphere.m_localToWorld = translate(identity(), Float3(0.0, -100.0f, 50.f));
-        sphere.m_worldToLocal = inverse(sphere.m_localToWorld);
-        sphere.m_radius = 100.0f;
-        spheres.push_back(sphere);
-        MatteMaterial* mat =  new MatteMaterial();
-        mat->color = Float3(0.0f, 0.6f, 0.05f);
-        //MicrofacetMaterial* mat = new MicrofacetMaterial();
-        //mat->color = Float3(cc(mt), cc(mt), cc(mt));
-        //mat->kD = 0.04f;
-        materials.push_back(mat);
+        printf("unknown integrator %s\n", pIntegrator);
+        return 1;
     }
-    for (U32 i = 0; i < 150; ++i)
+    Integrator& integrator = *pIntegratorInstance;
+
+    ImageFormat format = getImageFormat(outputPath);
+    if (pFormat)
     {
-        Primitive* prim = new Primitive();
-        prim->setShape(&spheres[i]);
-        prim->setMat(materials[i]);
-        primitives.push_back(prim);
+        if (strcmp(pFormat, "png") == 0)
+            format = ImageFormat::PNG;
+        else if (strcmp(pFormat, "exr") == 0)
+            format = ImageFormat::EXR;
+        else
+        {
+            printf("unknown format %s\n", pFormat);
+            return 1;
+        }
     }
 
+    if (pTracePath)
     {
-        Primitive* prim = new Primitive();
-        prim->setShape(&spheres.back());
-        prim->setMat(materials.back());
-        primitives.push_back(prim);
+        setTraceThreadName("main");
+        beginTrace();
     }
 
-    scene.addPrimitive(primitives.size(), primitives.data());
-    scene.addLight(&dirLight);
-    Float2 resolution{ 1920, 1080 };
-    Camera camera;
-    Integrator integrator;
+    Scene scene;
+    SimpleContainer aggregate;
+    scene.setAggregate(&aggregate);
+
+    Loader loader;
+    SceneDescription desc;
+    SceneAssets assets;
+    if (pScenePath)
+    {
+        if (!loader.load(pScenePath, desc) || (pExportPath && !loader.saveBinary(pExportPath, desc)))
+        {
+            printf("%s\n", loader.getError().c_str());
+            return 1;
+        }
+        if (width > 0)
+        {
+            desc.camera.width = width;
+            desc.camera.height = height;
+        }
+        if (!loader.build(desc, &scene, assets))
+        {
+            printf("%s\n", loader.getError().c_str());
+            return 1;
+        }
+    }
+    else
+        buildDefaultScene(scene, assets, width > 0 ? width : 1920, height > 0 ? height : 1080, seed);
 
-    ImageBuffer renderBuf((U32)resolution.x, (U32)resolution.y);
+    ImageBuffer renderBuf(assets.width, assets.height);
     RenderTarget rt;
-    rt.width = (U32)resolution.x;
-    rt.height = (U32)resolution.y;
+    rt.width = assets.width;
+    rt.height = assets.height;
     rt.surface = &renderBuf;
-
-    camera.update(identity());
-    camera.adjustScreenToRaster(resolution);
-    camera.updateProjection(RT_RAD(45.0f), resolution.x / resolution.y, 0.001f, 1000.0f);
-    Matrix44 worldToCamera =  rotate(identity(), Float3(1.0f, 0.0f, 0.0f), RT_RAD(45.0f));
-    worldToCamera = translate(worldToCamera, Float3(0.0, 50.0, -50.0f));
-    camera.update(worldToCamera);
+    rt.enableTiling();
 
     // Setup
-    integrator.setTonemapFun(reinhardtToneMapEvaluate);
-    integrator.setCamera(&camera);
+    integrator.setCamera(&assets.camera);
+    integrator.setTileCache(assets.tileCache.get());
     integrator.setRenderTarget(&rt);
-    integrator.setSamples(1);
+    integrator.setSamples(samples);
+    integrator.setMaxDepth(maxDepth);
+    integrator.setThreadCount(threads);
+    integrator.setTileSize(tileSize);
+    if (integrator.getTileSize() != tileSize)
+        printf("tile size %u rounded to %u, to keep threads off each other's cache lines\n", tileSize, integrator.getTileSize());
+    integrator.setSeed(seed);
+    integrator.setOutput(outputPath, format);
+    integrator.setAOVOutput(aovPath);
     // Trace the scene.
     integrator.render(&scene);
+    printFrameStats(integrator.getStats());
+
+    // Let the frame finish encoding, so the write shows up on the timeline, and fail the run
+    // if the image couldn't be written.
+    B32 written = integrator.flushOutput();
+    if (pTracePath && !endTrace(pTracePath))
+        printf("can't write %s\n", pTracePath);
 
-    return 0;
+    return written ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+// Raytracer.
+#include "Bounds.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+bool rayBoundsIntersect(const Ray& ray, const Bounds3& bounds)
+{
+    // Slab test, clipping the ray parametric range against each axis.
+    F32 t0 = 0.f;
+    F32 t1 = ray.tMax;
+    for (I32 i = 0; i < 3; ++i)
+    {
+        F32 invDir = 1.f / ray.dir[i];
+        F32 tNear = (bounds.min[i] - ray.o[i]) * invDir;
+        F32 tFar = (bounds.max[i] - ray.o[i]) * invDir;
+        if (tNear > tFar)
+        {
+            F32 t = tNear;
+            tNear = tFar;
+            tFar = t;
+        }
+        t0 = tNear > t0 ? tNear : t0;
+        t1 = tFar < t1 ? tFar : t1;
+        if (t0 > t1) 
+            return false;
+    }
+    return true;
+}
+
+bool intersect(const Bounds3& lh, const Bounds3& rh)
+{
+    return (lh.max.x >= rh.min.x) && (lh.min.x <= rh.max.x) &&
+           (lh.max.y >= rh.min.y) && (lh.min.y <= rh.max.y) &&
+           (lh.max.z >= rh.min.z) && (lh.min.z <= rh.max.z);
+}
+
+bool inside(const Float3& p, const Bounds3& bounds)
+{
+    return (p.x >= bounds.min.x && p.x <= bounds.max.x) &&
+           (p.y >= bounds.min.y && p.y <= bounds.max.y) &&
+           (p.z >= bounds.min.z && p.z <= bounds.max.z);
+}
+
+F32 volume(const Bounds3& lh)
+{
+    Float3 d = diagonal(lh);
+    return d.x * d.y * d.z;
+}
+
+F32 surfaceArea(const Bounds3& lh)
+{
+    Float3 d = diagonal(lh);
+    return 2.f * (d.x * d.y + d.x * d.z + d.y * d.z);
+}
+
+Float3 center(const Bounds3& lh)
+{
+    return (lh.min + lh.max) * 0.5f;
+}
+
+Float3 diagonal(const Bounds3& lh)
+{
+    return lh.max - lh.min;
+}
+
+Bounds3 boundsUnion(const Bounds3& lh, const Bounds3& rh)
+{
+    Bounds3 ans;
+    ans.min = Float3(fminf(lh.min.x, rh.min.x), fminf(lh.min.y, rh.min.y), fminf(lh.min.z, rh.min.z));
+    ans.max = Float3(fmaxf(lh.max.x, rh.max.x), fmaxf(lh.max.y, rh.max.y), fmaxf(lh.max.z, rh.max.z));
+    return ans;
+}
+
+Bounds3 boundsUnion(const Bounds3& lh, const Float3& p)
+{
+    return boundsUnion(lh, { p, p });
+}
+} // rt
\ No newline at end of file
@@ -14,7 +14,11 @@ struct Bounds3
 
 bool        rayBoundsIntersect(const Ray& ray, const Bounds3& bounds);
 bool        intersect(const Bounds3& lh, const Bounds3& rh);
+bool        inside(const Float3& p, const Bounds3& bounds);
 F32         volume(const Bounds3& lh);
+F32         surfaceArea(const Bounds3& lh);
 Float3      center(const Bounds3& lh);
+Float3      diagonal(const Bounds3& lh);
 Bounds3     boundsUnion(const Bounds3& lh, const Bounds3& rh);
-} // rt
\ No newline at end of file
+Bounds3     boundsUnion(const Bounds3& lh, const Float3& p);
+} // rt
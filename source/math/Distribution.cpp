@@ -0,0 +1,166 @@
+// Raytracer.
+#include "Distribution.hpp"
+#include "math/CommonMath.hpp"
+
+#include <math.h>
+
+namespace rt {
+
+
+static const F32 kOneMinusEpsilon = 0.99999994f;
+
+void AliasTable::build(const F32* weights, U32 n)
+{
+    m_bins.assign(n, { 0.f, 0.f, 0u });
+    if (n == 0)
+        return;
+
+    F64 sum = 0.0;
+    for (U32 i = 0; i < n; ++i)
+        sum += weights[i];
+    for (U32 i = 0; i < n; ++i)
+        m_bins[i].p = (sum > 0.0) ? (F32)(weights[i] / sum) : 1.f / (F32)n;
+
+    // Split into bins under and over the average, then pair them up so each bin
+    // is filled exactly to the average.
+    struct Outcome { F32 pHat; U32 index; };
+    std::vector<Outcome> under, over;
+    for (U32 i = 0; i < n; ++i)
+    {
+        F32 pHat = m_bins[i].p * (F32)n;
+        if (pHat < 1.f)
+            under.push_back({ pHat, i });
+        else
+            over.push_back({ pHat, i });
+    }
+
+    while (!under.empty() && !over.empty())
+    {
+        Outcome un = under.back();
+        under.pop_back();
+        Outcome ov = over.back();
+        over.pop_back();
+
+        m_bins[un.index].q = un.pHat;
+        m_bins[un.index].alias = ov.index;
+
+        // Give the remainder of the larger bin back to the lists.
+        F32 pExcess = un.pHat + ov.pHat - 1.f;
+        if (pExcess < 1.f)
+            under.push_back({ pExcess, ov.index });
+        else
+            over.push_back({ pExcess, ov.index });
+    }
+
+    // Round off leaves bins that are full to within float precision.
+    while (!over.empty())
+    {
+        m_bins[over.back().index].q = 1.f;
+        m_bins[over.back().index].alias = 0;
+        over.pop_back();
+    }
+    while (!under.empty())
+    {
+        m_bins[under.back().index].q = 1.f;
+        m_bins[under.back().index].alias = 0;
+        under.pop_back();
+    }
+}
+
+U32 AliasTable::sample(F32 u, F32& pmf, F32& uRemapped) const
+{
+    U32 n = (U32)m_bins.size();
+    F32 scaled = u * (F32)n;
+    U32 offset = (U32)scaled;
+    offset = offset < n - 1 ? offset : n - 1;
+    F32 up = fminf(scaled - (F32)offset, kOneMinusEpsilon);
+
+    const Bin& bin = m_bins[offset];
+    if (up < bin.q)
+    {
+        pmf = bin.p;
+        uRemapped = fminf(up / bin.q, kOneMinusEpsilon);
+        return offset;
+    }
+    pmf = m_bins[bin.alias].p;
+    uRemapped = fminf((up - bin.q) / (1.f - bin.q), kOneMinusEpsilon);
+    return bin.alias;
+}
+
+void Distribution2D::build(const F32* func, U32 nu, U32 nv)
+{
+    m_nu = nu;
+    m_nv = nv;
+    m_func.assign(func, func + (U64)nu * nv);
+    m_conditional.resize(nv);
+
+    F64 total = 0.0;
+    std::vector<F32> rowSums(nv);
+    for (U32 v = 0; v < nv; ++v)
+    {
+        const F32* row = &m_func[(U64)v * nu];
+        F64 rowSum = 0.0;
+        for (U32 u = 0; u < nu; ++u)
+            rowSum += row[u];
+        rowSums[v] = (F32)rowSum;
+        total += rowSum;
+        m_conditional[v].build(row, nu);
+    }
+    m_marginal.build(rowSums.data(), nv);
+
+    // Average value of the function over the domain. A black function is sampled uniformly.
+    m_integral = (F32)(total / ((F64)nu * nv));
+    if (m_integral == 0.f)
+    {
+        m_func.assign((U64)nu * nv, 1.f);
+        m_integral = 1.f;
+    }
+}
+
+Float2 Distribution2D::sample(const Float2& u, F32& pdf) const
+{
+    F32 pmfV, pmfU, remapV, remapU;
+    U32 v = m_marginal.sample(u.y, pmfV, remapV);
+    U32 iu = m_conditional[v].sample(u.x, pmfU, remapU);
+    pdf = m_func[(U64)v * m_nu + iu] / m_integral;
+    // Place the point uniformly within the chosen cell.
+    return Float2(((F32)iu + remapU) / (F32)m_nu, ((F32)v + remapV) / (F32)m_nv);
+}
+
+F32 Distribution2D::pdf(const Float2& p) const
+{
+    I32 iu = (I32)(p.x * (F32)m_nu);
+    I32 iv = (I32)(p.y * (F32)m_nv);
+    iu = iu < 0 ? 0 : (iu >= (I32)m_nu ? (I32)m_nu - 1 : iu);
+    iv = iv < 0 ? 0 : (iv >= (I32)m_nv ? (I32)m_nv - 1 : iv);
+    return m_func[(U64)iv * m_nu + iu] / m_integral;
+}
+
+Float2 concentricSampleDisk(const Float2& u)
+{
+    F32 ox = 2.f * u.x - 1.f;
+    F32 oy = 2.f * u.y - 1.f;
+    if (ox == 0.f && oy == 0.f)
+        return Float2(0.f, 0.f);
+    F32 r, theta;
+    if (fabsf(ox) > fabsf(oy))
+    {
+        r = ox;
+        theta = (F32)RT_PI * 0.25f * (oy / ox);
+    }
+    else
+    {
+        r = oy;
+        theta = (F32)RT_PI * 0.5f - (F32)RT_PI * 0.25f * (ox / oy);
+    }
+    return Float2(r * cosf(theta), r * sinf(theta));
+}
+
+Float3 cosineSampleHemisphere(const Float2& u)
+{
+    // Malley's method, project disk samples up onto the hemisphere.
+    Float2 d = concentricSampleDisk(u);
+    F32 z = sqrtf(fmaxf(0.f, 1.f - d.x * d.x - d.y * d.y));
+    return Float3(d.x, d.y, z);
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+#include <vector>
+
+namespace rt {
+
+
+// Discrete distribution sampled in constant time with Vose's alias method. Every bin holds the
+// probability of keeping its own index, and the index to jump to otherwise.
+class AliasTable
+{
+public:
+    struct Bin
+    {
+        F32 q;      // Probability of keeping this bin.
+        F32 p;      // Normalized probability of this bin.
+        U32 alias;
+    };
+
+    // Build over n non negative weights. All zero weights result in a uniform distribution.
+    void build(const F32* weights, U32 n);
+
+    // Sample an index. Writes the probability of the index into pmf, and u remapped back
+    // to [0, 1) into uRemapped, so it can be reused for a continuous offset.
+    U32 sample(F32 u, F32& pmf, F32& uRemapped) const;
+
+    F32 pmf(U32 index) const { return m_bins[index].p; }
+    U32 size() const { return (U32)m_bins.size(); }
+
+private:
+    std::vector<Bin> m_bins;
+};
+
+
+// Piecewise constant 2D distribution over [0, 1]^2, built from a function tabulated on a
+// nu x nv grid. Sampled as a marginal distribution over rows, then a conditional one
+// within the chosen row, both with alias tables.
+class Distribution2D
+{
+public:
+    void build(const F32* func, U32 nu, U32 nv);
+
+    // Sample a point in [0, 1]^2. Writes the density of the point into pdf.
+    Float2 sample(const Float2& u, F32& pdf) const;
+
+    // Density of sample() returning the point p.
+    F32 pdf(const Float2& p) const;
+
+    U32 getWidth() const { return m_nu; }
+    U32 getHeight() const { return m_nv; }
+
+private:
+    std::vector<F32>        m_func;
+    std::vector<AliasTable> m_conditional;
+    AliasTable              m_marginal;
+    F32                     m_integral;
+    U32                     m_nu;
+    U32                     m_nv;
+};
+
+// Map a point in [0, 1]^2 onto the unit disk, keeping strata area preserving and compact.
+Float2 concentricSampleDisk(const Float2& u);
+
+// Direction on the hemisphere about +z, with density cos(theta) / pi.
+Float3 cosineSampleHemisphere(const Float2& u);
+} // rt
\ No newline at end of file
@@ -156,4 +156,18 @@ F32 tan2Theta(const Float3& w)
 {
     return sin2Theta(w) / cos2Theta(w);
 }
+
+void coordinateSystem(const Float3& v1, Float3& v2, Float3& v3)
+{
+    if (fabsf(v1.x) > fabsf(v1.y))
+        v2 = Float3(-v1.z, 0.f, v1.x) / sqrtf(v1.x * v1.x + v1.z * v1.z);
+    else
+        v2 = Float3(0.f, v1.z, -v1.y) / sqrtf(v1.y * v1.y + v1.z * v1.z);
+    v3 = cross(v1, v2);
+}
+
+Float3 sphericalDirection(F32 sinTheta, F32 cosTheta, F32 phi)
+{
+    return Float3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
 } // rt
\ No newline at end of file
@@ -310,4 +310,10 @@ F32 sin2Theta(const Float3& w);
 F32 sinTheta(const Float3& w);
 F32 tanTheta(const Float3& w);
 F32 tan2Theta(const Float3& w);
+
+// Build an orthonormal basis (v1, v2, v3) from the normalized vector v1.
+void    coordinateSystem(const Float3& v1, Float3& v2, Float3& v3);
+
+// Direction from spherical coordinates, about the z axis.
+Float3  sphericalDirection(F32 sinTheta, F32 cosTheta, F32 phi);
 } // rt
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+namespace rt {
+
+
+// Permuted congruential generator (PCG32). Small state, fast, and good enough for
+// choosing lights and sampling directions. Each pixel seeds its own sequence, so
+// threads never share a generator.
+struct Random
+{
+    static const U64 kDefaultSeed = 0x853c49e6748fea9bULL;
+
+    Random(U64 seqIndex = 0ULL, U64 seed = kDefaultSeed)
+    {
+        setSequence(seqIndex, seed);
+    }
+
+    void setSequence(U64 seqIndex, U64 seed)
+    {
+        m_state = 0ULL;
+        m_inc = (seqIndex << 1ULL) | 1ULL;
+        nextU32();
+        m_state += seed;
+        nextU32();
+    }
+
+    U32 nextU32()
+    {
+        U64 old = m_state;
+        m_state = old * 0x5851f42d4c957f2dULL + m_inc;
+        U32 xorShifted = (U32)(((old >> 18ULL) ^ old) >> 27ULL);
+        U32 rot = (U32)(old >> 59ULL);
+        return (xorShifted >> rot) | (xorShifted << ((~rot + 1u) & 31));
+    }
+
+    // Uniform float in [0, 1).
+    F32 nextF32()
+    {
+        return (F32)(nextU32() >> 8) * (1.f / 16777216.f);
+    }
+
+    Float2 nextFloat2()
+    {
+        F32 u = nextF32();
+        return Float2(u, nextF32());
+    }
+
+private:
+    U64 m_state;
+    U64 m_inc;
+};
+} // rt
\ No newline at end of file
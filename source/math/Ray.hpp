@@ -5,17 +5,37 @@
 #include "math/Float.hpp"
 #include "math/Matrix44.hpp"
 
+#include <math.h>
+
 namespace rt {
 
 
 struct Ray {
     Float3 o, dir;
+    // Maximum parametric distance along the ray. Shadow rays use this to stop
+    // short of the light they are testing visibility against.
+    F32 tMax;
+
+    // Rays offset by one pixel in x and y, tracked alongside this one so that surfaces 
+    // can tell how large the pixel footprint is where it lands. Only valid if hasDifferentials is set.
+    B32 hasDifferentials;
+    Float3 rxOrigin, ryOrigin;
+    Float3 rxDirection, ryDirection;
+
+    Ray(const Float3& origin = Float3(), const Float3& dir = Float3(), F32 tMax = INFINITY)
+        : o(origin), dir(dir), tMax(tMax), hasDifferentials(false) { }
 
-    Ray(const Float3& origin = Float3(), const Float3& dir = Float3())
-        : o(origin), dir(dir) { }
+    // Shrink the footprint to that of a single sample, when several are taken per pixel.
+    void scaleDifferentials(F32 s)
+    {
+        rxOrigin = o + (rxOrigin - o) * s;
+        ryOrigin = o + (ryOrigin - o) * s;
+        rxDirection = dir + (rxDirection - dir) * s;
+        ryDirection = dir + (ryDirection - dir) * s;
+    }
 
     Ray invert() const {
-        return { o, -dir };
+        return { o, -dir, tMax };
     }
 
     Ray operator-() const {
@@ -47,6 +67,13 @@ struct Ray {
             dir[0] * lh[1] + dir[1] * lh[5] + dir[2] * lh[9],
             dir[0] * lh[2] + dir[1] * lh[6] + dir[2] * lh[10]
         );
+        if (hasDifferentials)
+        {
+            ans.rxOrigin = Float4(rxOrigin, 1.0f) * lh;
+            ans.ryOrigin = Float4(ryOrigin, 1.0f) * lh;
+            ans.rxDirection = Float4(rxDirection, 0.0f) * lh;
+            ans.ryDirection = Float4(ryDirection, 0.0f) * lh;
+        }
         return ans;
     }
 };
@@ -0,0 +1,249 @@
+// Raytracer.
+#include "Bloom.hpp"
+
+#include "common/Threading.hpp"
+#include "framebuffer/TiledBuffer.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined SIMD_ENABLE
+#include <immintrin.h>
+#endif
+
+namespace rt {
+
+
+// Keep the part of each RGBA32F pixel above the threshold, easing in over the knee so there's
+// no hard edge where the bloom starts. Alpha is cleared so it's never accumulated.
+static void brightPass(F32* pPixels, U32 count, F32 threshold, F32 knee)
+{
+    for (U32 i = 0; i < count; ++i)
+    {
+        F32* p = pPixels + i * 4;
+        F32 brightness = std::max(p[0], std::max(p[1], p[2]));
+        F32 soft = std::min(std::max(brightness - threshold + knee, 0.f), 2.f * knee);
+        soft = soft * soft / (4.f * knee + 1e-5f);
+        F32 contribution = std::max(soft, brightness - threshold) / std::max(brightness, 1e-5f);
+        p[0] *= contribution;
+        p[1] *= contribution;
+        p[2] *= contribution;
+        p[3] = 0.f;
+    }
+}
+
+// Halve a row of RGBA32F pixels with the [1 3 3 1] / 8 binomial, which is centered between
+// the two source pixels each output pixel covers. Edges are clamped.
+static void downsampleRow(const F32* pSrc, U32 srcWidth, F32* pDst, U32 dstWidth)
+{
+    for (U32 x = 0; x < dstWidth; ++x)
+    {
+        U32 i0 = x > 0 ? 2 * x - 1 : 0;
+        U32 i1 = std::min(2 * x, srcWidth - 1);
+        U32 i2 = std::min(2 * x + 1, srcWidth - 1);
+        U32 i3 = std::min(2 * x + 2, srcWidth - 1);
+#if defined SIMD_ENABLE
+        __m128 outer = _mm_add_ps(_mm_loadu_ps(pSrc + i0 * 4), _mm_loadu_ps(pSrc + i3 * 4));
+        __m128 inner = _mm_add_ps(_mm_loadu_ps(pSrc + i1 * 4), _mm_loadu_ps(pSrc + i2 * 4));
+        _mm_storeu_ps(pDst + x * 4, _mm_add_ps(_mm_mul_ps(outer, _mm_set1_ps(0.125f)),
+                                               _mm_mul_ps(inner, _mm_set1_ps(0.375f))));
+#else
+        for (U32 c = 0; c < 4; ++c)
+        {
+            pDst[x * 4 + c] = (pSrc[i0 * 4 + c] + pSrc[i3 * 4 + c]) * 0.125f +
+                              (pSrc[i1 * 4 + c] + pSrc[i2 * 4 + c]) * 0.375f;
+        }
+#endif
+    }
+}
+
+// The same binomial down a column, over count floats of four already halved rows.
+static void downsampleColumns(const F32* const pRows[4], F32* pDst, U32 count)
+{
+    U32 i = 0;
+#if defined SIMD_ENABLE
+    const __m128 outerWeight = _mm_set1_ps(0.125f);
+    const __m128 innerWeight = _mm_set1_ps(0.375f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 outer = _mm_add_ps(_mm_loadu_ps(pRows[0] + i), _mm_loadu_ps(pRows[3] + i));
+        __m128 inner = _mm_add_ps(_mm_loadu_ps(pRows[1] + i), _mm_loadu_ps(pRows[2] + i));
+        _mm_storeu_ps(pDst + i, _mm_add_ps(_mm_mul_ps(outer, outerWeight), _mm_mul_ps(inner, innerWeight)));
+    }
+#endif
+    for (; i < count; ++i)
+        pDst[i] = (pRows[0][i] + pRows[3][i]) * 0.125f + (pRows[1][i] + pRows[2][i]) * 0.375f;
+}
+
+// Lerp count floats of two rows, the vertical half of a bilinear upsample.
+static void blendRows(const F32* pRow0, const F32* pRow1, F32 t, F32* pDst, U32 count)
+{
+    U32 i = 0;
+#if defined SIMD_ENABLE
+    const __m128 vt = _mm_set1_ps(t);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(pRow0 + i);
+        _mm_storeu_ps(pDst + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pRow1 + i), a), vt)));
+    }
+#endif
+    for (; i < count; ++i)
+        pDst[i] = pRow0[i] + (pRow1[i] - pRow0[i]) * t;
+}
+
+// Double a row horizontally and add it, scaled, to count destination pixels starting at
+// column x0. Output pixels sit a quarter of a source pixel either side of the source centers.
+static void upsampleAddRow(const F32* pSrc, U32 srcWidth, U32 x0, U32 count, F32* pDst, F32 scale)
+{
+    for (U32 i = 0; i < count; ++i)
+    {
+        U32 x = x0 + i;
+        U32 center = std::min(x >> 1, srcWidth - 1);
+        U32 side = (x & 1) ? std::min(center + 1, srcWidth - 1) : (center > 0 ? center - 1 : 0);
+#if defined SIMD_ENABLE
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + center * 4), _mm_set1_ps(0.75f * scale)),
+                              _mm_mul_ps(_mm_loadu_ps(pSrc + side * 4), _mm_set1_ps(0.25f * scale)));
+        _mm_storeu_ps(pDst + i * 4, _mm_add_ps(_mm_loadu_ps(pDst + i * 4), v));
+#else
+        for (U32 c = 0; c < 4; ++c)
+            pDst[i * 4 + c] += (pSrc[center * 4 + c] * 0.75f + pSrc[side * 4 + c] * 0.25f) * scale;
+#endif
+    }
+}
+
+// Source rows, and the weight of the second, that destination row y of a doubled image blends.
+static void upsampleRows(U32 y, U32 srcHeight, U32& row0, U32& row1, F32& t)
+{
+    U32 center = std::min(y >> 1, srcHeight - 1);
+    if (y & 1)
+    {
+        row0 = center;
+        row1 = std::min(center + 1, srcHeight - 1);
+        t = 0.25f;
+    }
+    else
+    {
+        row0 = center > 0 ? center - 1 : 0;
+        row1 = center;
+        t = 0.75f;
+    }
+}
+
+typedef std::function<const F32*(U32 y, F32* pScratch)> RowSource;
+
+// Halve a srcWidth x srcHeight image into dst, bands of rows in parallel. Each thread keeps its
+// last four horizontally filtered rows, consecutive output rows share two of them.
+static void downsample(U32 srcWidth, U32 srcHeight, const RowSource& getRow, F32* pDst, U32 dstWidth, U32 dstHeight)
+{
+    parallelFor(dstHeight, [&] (U32 begin, U32 end) -> void {
+        std::vector<F32> scratch((U64)srcWidth * 4);
+        std::vector<F32> rows((U64)dstWidth * 4 * 4);
+        I64 cached[4] = { -1, -1, -1, -1 };
+        for (U32 y = begin; y < end; ++y)
+        {
+            const F32* pRows[4];
+            for (U32 k = 0; k < 4; ++k)
+            {
+                I64 sy = std::min(std::max((I64)2 * y - 1 + k, (I64)0), (I64)srcHeight - 1);
+                // Four consecutive rows never share a slot.
+                F32* pSlot = &rows[(U64)(sy & 3) * dstWidth * 4];
+                if (cached[sy & 3] != sy)
+                {
+                    downsampleRow(getRow((U32)sy, scratch.data()), srcWidth, pSlot, dstWidth);
+                    cached[sy & 3] = sy;
+                }
+                pRows[k] = pSlot;
+            }
+            downsampleColumns(pRows, pDst + (U64)y * dstWidth * 4, dstWidth * 4);
+        }
+    });
+}
+
+void Bloom::apply(TiledBuffer& radiance)
+{
+    if (!radiance.isAllocated() || radiance.getPixelSize() != sizeof(F32) * 4 || m_levelCount == 0 ||
+        m_intensity <= 0.f)
+        return;
+
+    U32 width = radiance.getWidth();
+    U32 height = radiance.getHeight();
+
+    // Size the pyramid, stopping early for small images.
+    U32 levelCount = 0;
+    for (U32 w = width, h = height; levelCount < m_levelCount && w > 1 && h > 1; ++levelCount)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        if (m_levels.size() <= levelCount)
+            m_levels.push_back({});
+        m_levels[levelCount].width = w;
+        m_levels[levelCount].height = h;
+        m_levels[levelCount].pixels.resize((U64)w * h * 4);
+    }
+    if (levelCount == 0)
+        return;
+
+    // The bright pass happens as rows are read out of the tiles, straight into the first level.
+    const F32 threshold = m_threshold;
+    const F32 knee = threshold * 0.5f;
+    downsample(width, height, [&] (U32 y, F32* pScratch) -> const F32* {
+        for (U32 x = 0; x < width; x += TiledBuffer::kTileSize)
+        {
+            U32 count = std::min(TiledBuffer::kTileSize, width - x);
+            memcpy(pScratch + (U64)x * 4, radiance.getPixel(x, y), (U64)count * sizeof(F32) * 4);
+        }
+        brightPass(pScratch, width, threshold, knee);
+        return pScratch;
+    }, m_levels[0].pixels.data(), m_levels[0].width, m_levels[0].height);
+
+    for (U32 i = 1; i < levelCount; ++i)
+    {
+        const Level& src = m_levels[i - 1];
+        Level& dst = m_levels[i];
+        downsample(src.width, src.height, [&] (U32 y, F32*) -> const F32* {
+            return &src.pixels[(U64)y * src.width * 4];
+        }, dst.pixels.data(), dst.width, dst.height);
+    }
+
+    // Back up the pyramid, each level adds the one below it. Bilinear upsampling repeated
+    // level after level smooths out the coarse ones.
+    for (U32 i = levelCount - 1; i > 0; --i)
+    {
+        const Level& src = m_levels[i];
+        Level& dst = m_levels[i - 1];
+        parallelFor(dst.height, [&] (U32 begin, U32 end) -> void {
+            std::vector<F32> line((U64)src.width * 4);
+            for (U32 y = begin; y < end; ++y)
+            {
+                U32 row0, row1;
+                F32 t;
+                upsampleRows(y, src.height, row0, row1, t);
+                blendRows(&src.pixels[(U64)row0 * src.width * 4], &src.pixels[(U64)row1 * src.width * 4], t,
+                          line.data(), src.width * 4);
+                upsampleAddRow(line.data(), src.width, 0, dst.width, &dst.pixels[(U64)y * dst.width * 4], 1.f);
+            }
+        });
+    }
+
+    // Every level carries about the same energy, so normalize by how many were summed.
+    const Level& top = m_levels[0];
+    const F32 scale = m_intensity / levelCount;
+    parallelFor(height, [&] (U32 begin, U32 end) -> void {
+        std::vector<F32> line((U64)top.width * 4);
+        for (U32 y = begin; y < end; ++y)
+        {
+            U32 row0, row1;
+            F32 t;
+            upsampleRows(y, top.height, row0, row1, t);
+            blendRows(&top.pixels[(U64)row0 * top.width * 4], &top.pixels[(U64)row1 * top.width * 4], t,
+                      line.data(), top.width * 4);
+            // Rows are contiguous within a tile, add one tile wide run at a time.
+            for (U32 x = 0; x < width; x += TiledBuffer::kTileSize)
+            {
+                U32 count = std::min(TiledBuffer::kTileSize, width - x);
+                upsampleAddRow(line.data(), top.width, x, count, (F32*)radiance.getPixel(x, y), scale);
+            }
+        }
+    });
+}
+} // rt
\ No newline at end of file
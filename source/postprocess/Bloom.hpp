@@ -0,0 +1,52 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include <vector>
+
+namespace rt {
+
+class TiledBuffer;
+
+
+// Adds a glow around the brightest parts of the HDR radiance, before it is tonemapped.
+// The bright pass is filtered down a pyramid of half resolution levels, then the levels are
+// upsampled and summed back up. Every level costs a quarter of the one above, so the wide
+// kernel ends up cheaper than a single blur at full resolution.
+class Bloom
+{
+public:
+    Bloom(F32 threshold = 1.f, F32 intensity = 0.1f, U32 levels = 6)
+        : m_threshold(threshold), m_intensity(intensity), m_levelCount(levels) { }
+
+    // Radiance below the threshold doesn't bloom, with a soft knee around it.
+    void setThreshold(F32 threshold) { m_threshold = threshold; }
+    F32 getThreshold() const { return m_threshold; }
+
+    // How much of the blurred bright pass is added back.
+    void setIntensity(F32 intensity) { m_intensity = intensity; }
+    F32 getIntensity() const { return m_intensity; }
+
+    // Number of pyramid levels, more levels spread the glow further.
+    void setLevels(U32 levels) { m_levelCount = levels; }
+    U32 getLevels() const { return m_levelCount; }
+
+    // Add bloom to tiled RGBA32F radiance in place. Every pass runs over several threads.
+    void apply(TiledBuffer& radiance);
+
+private:
+    struct Level
+    {
+        U32              width;
+        U32              height;
+        // RGBA32F scanlines.
+        std::vector<F32> pixels;
+    };
+
+    F32                m_threshold;
+    F32                m_intensity;
+    U32                m_levelCount;
+    // Kept between frames so the pyramid isn't reallocated every time.
+    std::vector<Level> m_levels;
+};
+} // rt
\ No newline at end of file
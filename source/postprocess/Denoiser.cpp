@@ -0,0 +1,331 @@
+// Raytracer.
+#include "Denoiser.hpp"
+
+#include "common/Threading.hpp"
+#include "framebuffer/RenderTarget.hpp"
+#include "framebuffer/TiledBuffer.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined SIMD_ENABLE
+#include <immintrin.h>
+#endif
+
+namespace rt {
+
+
+// B3 spline, the a-trous filter's 1D kernel.
+static const F32 kKernel[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+// Misses have an infinite depth, keep it finite so differences stay numbers.
+static const F32 kMaxDepth = 1e30f;
+
+// Dividing by the albedo leaves the lighting, which is smoother than the final color.
+static const F32 kMinAlbedo = 1e-3f;
+
+// Two sets of color and variance planes to ping pong between, then the guides.
+enum DenoiserPlane
+{
+    ColorR,
+    ColorG,
+    ColorB,
+    Variance = 6,
+    NormalX = 8,
+    NormalY,
+    NormalZ,
+    Depth,
+    PlaneCount
+};
+
+// One a-trous pass, reading color and its luminance variance and writing them to out, all in one plane per channel.
+struct FilterPass
+{
+    const F32*  color[3];
+    const F32*  variance;
+    F32*        outColor[3];
+    F32*        outVariance;
+    const F32*  normal[3];
+    const F32*  depth;
+    U32         width;
+    U32         height;
+    U32         step;
+    F32         colorSigma;
+    F32         invNormalSigma2;
+    F32         invDepthSigma;
+};
+
+static F32 luminance(F32 r, F32 g, F32 b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+static void filterPixel(const FilterPass& pass, U32 x, U32 y)
+{
+    U64 i = (U64)y * pass.width + x;
+    F32 cr = pass.color[0][i], cg = pass.color[1][i], cb = pass.color[2][i];
+    F32 nx = pass.normal[0][i], ny = pass.normal[1][i], nz = pass.normal[2][i];
+    F32 z = pass.depth[i];
+    // Luminance differences are measured against the noise around the center, so noisy areas
+    // get smoothed more and the filter backs off as the noise goes down.
+    F32 l = luminance(cr, cg, cb);
+    F32 invColor = 1.f / (pass.colorSigma * sqrtf(pass.variance[i]) + 1e-4f);
+    F32 invDepth = pass.invDepthSigma / (z + 1e-4f);
+
+    F32 sumR = 0.f, sumG = 0.f, sumB = 0.f, sumW = 0.f, sumVariance = 0.f;
+    for (I32 ky = -2; ky <= 2; ++ky)
+    {
+        I64 qy = (I64)y + ky * (I64)pass.step;
+        if (qy < 0 || qy >= pass.height)
+            continue;
+        for (I32 kx = -2; kx <= 2; ++kx)
+        {
+            I64 qx = (I64)x + kx * (I64)pass.step;
+            if (qx < 0 || qx >= pass.width)
+                continue;
+            U64 j = (U64)qy * pass.width + (U64)qx;
+            F32 qr = pass.color[0][j], qg = pass.color[1][j], qb = pass.color[2][j];
+            F32 dx = nx - pass.normal[0][j], dy = ny - pass.normal[1][j], dz = nz - pass.normal[2][j];
+            F32 e = fabsf(l - luminance(qr, qg, qb)) * invColor + (dx * dx + dy * dy + dz * dz) * pass.invNormalSigma2 +
+                    fabsf(z - pass.depth[j]) * invDepth;
+            F32 w = kKernel[ky + 2] * kKernel[kx + 2] * expf(-e);
+            sumR += qr * w;
+            sumG += qg * w;
+            sumB += qb * w;
+            sumW += w;
+            sumVariance += pass.variance[j] * w * w;
+        }
+    }
+    // The center always has a weight, sumW can't be 0.
+    F32 invW = 1.f / sumW;
+    pass.outColor[0][i] = sumR * invW;
+    pass.outColor[1][i] = sumG * invW;
+    pass.outColor[2][i] = sumB * invW;
+    pass.outVariance[i] = sumVariance * invW * invW;
+}
+
+#if defined SIMD_ENABLE
+// e^-x for x >= 0, good to a few ulp. 2^i goes straight into the exponent bits and 2^f is a polynomial.
+static __m128 expNegative(__m128 x)
+{
+    __m128 t = _mm_sub_ps(_mm_set1_ps(126.f), _mm_mul_ps(_mm_min_ps(x, _mm_set1_ps(87.f)), _mm_set1_ps(1.44269504f)));
+    __m128i i = _mm_cvttps_epi32(t);
+    __m128 f = _mm_sub_ps(t, _mm_cvtepi32_ps(i));
+    __m128 p = _mm_set1_ps(1.333355e-3f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618129e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550411e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402265e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.f));
+    // t was offset by 126 to keep it positive for the truncation, the bias takes one more.
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(1)), 23));
+    return _mm_mul_ps(p, scale);
+}
+
+// Four neighbouring pixels at once. Every tap has to land inside the row.
+static void filterQuad(const FilterPass& pass, U32 x, U32 y)
+{
+    U64 i = (U64)y * pass.width + x;
+    __m128 cr = _mm_loadu_ps(pass.color[0] + i), cg = _mm_loadu_ps(pass.color[1] + i), cb = _mm_loadu_ps(pass.color[2] + i);
+    __m128 nx = _mm_loadu_ps(pass.normal[0] + i), ny = _mm_loadu_ps(pass.normal[1] + i), nz = _mm_loadu_ps(pass.normal[2] + i);
+    __m128 z = _mm_loadu_ps(pass.depth + i);
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 lumR = _mm_set1_ps(0.2126f), lumG = _mm_set1_ps(0.7152f), lumB = _mm_set1_ps(0.0722f);
+    __m128 l = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cr, lumR), _mm_mul_ps(cg, lumG)), _mm_mul_ps(cb, lumB));
+    __m128 invColor = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pass.colorSigma), _mm_sqrt_ps(_mm_loadu_ps(pass.variance + i))),
+                                                 _mm_set1_ps(1e-4f)));
+    __m128 invDepth = _mm_div_ps(_mm_set1_ps(pass.invDepthSigma), _mm_add_ps(z, _mm_set1_ps(1e-4f)));
+    __m128 invNormal = _mm_set1_ps(pass.invNormalSigma2);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps(), sumW = _mm_setzero_ps();
+    __m128 sumVariance = _mm_setzero_ps();
+    for (I32 ky = -2; ky <= 2; ++ky)
+    {
+        I64 qy = (I64)y + ky * (I64)pass.step;
+        if (qy < 0 || qy >= pass.height)
+            continue;
+        for (I32 kx = -2; kx <= 2; ++kx)
+        {
+            U64 j = (U64)qy * pass.width + (U64)((I64)x + kx * (I64)pass.step);
+            __m128 qr = _mm_loadu_ps(pass.color[0] + j), qg = _mm_loadu_ps(pass.color[1] + j), qb = _mm_loadu_ps(pass.color[2] + j);
+            __m128 lq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qr, lumR), _mm_mul_ps(qg, lumG)), _mm_mul_ps(qb, lumB));
+            __m128 dx = _mm_sub_ps(nx, _mm_loadu_ps(pass.normal[0] + j));
+            __m128 dy = _mm_sub_ps(ny, _mm_loadu_ps(pass.normal[1] + j));
+            __m128 dz = _mm_sub_ps(nz, _mm_loadu_ps(pass.normal[2] + j));
+            __m128 colorDist = _mm_and_ps(_mm_sub_ps(l, lq), absMask);
+            __m128 normalDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 depthDist = _mm_and_ps(_mm_sub_ps(z, _mm_loadu_ps(pass.depth + j)), absMask);
+            __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(colorDist, invColor), _mm_mul_ps(normalDist, invNormal)),
+                                  _mm_mul_ps(depthDist, invDepth));
+            __m128 w = _mm_mul_ps(_mm_set1_ps(kKernel[ky + 2] * kKernel[kx + 2]), expNegative(e));
+            sumR = _mm_add_ps(sumR, _mm_mul_ps(qr, w));
+            sumG = _mm_add_ps(sumG, _mm_mul_ps(qg, w));
+            sumB = _mm_add_ps(sumB, _mm_mul_ps(qb, w));
+            sumW = _mm_add_ps(sumW, w);
+            sumVariance = _mm_add_ps(sumVariance, _mm_mul_ps(_mm_loadu_ps(pass.variance + j), _mm_mul_ps(w, w)));
+        }
+    }
+    __m128 invW = _mm_div_ps(one, sumW);
+    _mm_storeu_ps(pass.outColor[0] + i, _mm_mul_ps(sumR, invW));
+    _mm_storeu_ps(pass.outColor[1] + i, _mm_mul_ps(sumG, invW));
+    _mm_storeu_ps(pass.outColor[2] + i, _mm_mul_ps(sumB, invW));
+    _mm_storeu_ps(pass.outVariance + i, _mm_mul_ps(sumVariance, _mm_mul_ps(invW, invW)));
+}
+#endif
+
+static void filterRow(const FilterPass& pass, U32 y)
+{
+    U32 x = 0;
+#if defined SIMD_ENABLE
+    // Pixels near the left and right edges have taps outside the image, those go one at a time.
+    U32 border = 2 * pass.step;
+    if (pass.width > 2 * border + 4)
+    {
+        for (; x < border; ++x)
+            filterPixel(pass, x, y);
+        for (; x + 4 + border <= pass.width; x += 4)
+            filterQuad(pass, x, y);
+    }
+#endif
+    for (; x < pass.width; ++x)
+        filterPixel(pass, x, y);
+}
+
+// Starting variance of the lighting's luminance, over the 5 x 5 pixels around each one. 
+// The second set of color planes is free until the first pass, and holds the partial sums.
+static void estimateVariance(F32* const pPlanes[PlaneCount], U32 width, U32 height)
+{
+    F32* pLuminance = pPlanes[ColorR + 3];
+    F32* pSum = pPlanes[ColorG + 3];
+    F32* pSumSquares = pPlanes[ColorB + 3];
+    F32* pVariance = pPlanes[Variance];
+    parallelFor(height, [&] (U32 begin, U32 end) -> void {
+        for (U64 i = (U64)begin * width; i < (U64)end * width; ++i)
+            pLuminance[i] = luminance(pPlanes[ColorR][i], pPlanes[ColorG][i], pPlanes[ColorB][i]);
+        for (U32 y = begin; y < end; ++y)
+        {
+            const F32* pRow = pLuminance + (U64)y * width;
+            for (U32 x = 0; x < width; ++x)
+            {
+                F32 sum = 0.f, sumSquares = 0.f;
+                for (U32 qx = x > 2 ? x - 2 : 0; qx <= std::min(x + 2, width - 1); ++qx)
+                {
+                    sum += pRow[qx];
+                    sumSquares += pRow[qx] * pRow[qx];
+                }
+                pSum[(U64)y * width + x] = sum;
+                pSumSquares[(U64)y * width + x] = sumSquares;
+            }
+        }
+    });
+    parallelFor(height, [&] (U32 begin, U32 end) -> void {
+        for (U32 y = begin; y < end; ++y)
+        {
+            U32 y0 = y > 2 ? y - 2 : 0;
+            U32 y1 = std::min(y + 2, height - 1);
+            for (U32 x = 0; x < width; ++x)
+            {
+                F32 sum = 0.f, sumSquares = 0.f;
+                for (U32 qy = y0; qy <= y1; ++qy)
+                {
+                    sum += pSum[(U64)qy * width + x];
+                    sumSquares += pSumSquares[(U64)qy * width + x];
+                }
+                F32 count = (F32)((y1 - y0 + 1) * (std::min(x + 2, width - 1) - (x > 2 ? x - 2 : 0) + 1));
+                F32 mean = sum / count;
+                pVariance[(U64)y * width + x] = std::max(sumSquares / count - mean * mean, 0.f);
+            }
+        }
+    });
+}
+
+void Denoiser::apply(TiledBuffer& radiance, const RenderPlane& albedo, const RenderPlane& normal, const RenderPlane& depth)
+{
+    U32 width = radiance.getWidth();
+    U32 height = radiance.getHeight();
+    if (!radiance.isAllocated() || radiance.getPixelSize() != sizeof(F32) * 4 || m_iterations == 0)
+        return;
+    const RenderPlane* pGuides[] = { &albedo, &normal, &depth };
+    for (const RenderPlane* pGuide : pGuides)
+    {
+        if (pGuide->getFormat() != PlaneFormat::F32 || pGuide->getWidth() != width || pGuide->getHeight() != height)
+            return;
+    }
+    if (albedo.getChannels().size() != 3 || normal.getChannels().size() != 3 || depth.getChannels().size() != 1)
+        return;
+
+    // Planes of the same large power of two size would all map to the same cache sets, and a
+    // pass reads a dozen of them side by side. Stagger them by an odd number of cache lines.
+    U64 pixelCount = (U64)width * height;
+    U64 stride = ((pixelCount + 15) & ~(U64)15) + 16 * 3;
+    m_planes.resize(stride * PlaneCount);
+    F32* pPlanes[PlaneCount];
+    for (U32 p = 0; p < PlaneCount; ++p)
+        pPlanes[p] = m_planes.data() + p * stride;
+
+    // Gather the lighting and the guides out of the tiles and planes into one plane per channel.
+    const F32* pAlbedo = albedo.getF32().data();
+    const F32* pNormal = normal.getF32().data();
+    const F32* pDepth = depth.getF32().data();
+    parallelFor(height, [&] (U32 begin, U32 end) -> void {
+        for (U32 y = begin; y < end; ++y)
+        {
+            for (U32 x = 0; x < width; ++x)
+            {
+                U64 i = (U64)y * width + x;
+                const F32* pPixel = (const F32*)radiance.getPixel(x, y);
+                for (U32 c = 0; c < 3; ++c)
+                {
+                    pPlanes[ColorR + c][i] = pPixel[c] / std::max(pAlbedo[i * 3 + c], kMinAlbedo);
+                    pPlanes[NormalX + c][i] = pNormal[i * 3 + c];
+                }
+                pPlanes[Depth][i] = std::min(pDepth[i], kMaxDepth);
+            }
+        }
+    });
+
+    estimateVariance(pPlanes, width, height);
+
+    // Ping pong between the two sets of color planes, with the taps twice as far apart every pass.
+    U32 source = 0;
+    for (U32 iteration = 0; iteration < m_iterations; ++iteration)
+    {
+        FilterPass pass;
+        for (U32 c = 0; c < 3; ++c)
+        {
+            pass.color[c] = pPlanes[ColorR + source * 3 + c];
+            pass.outColor[c] = pPlanes[ColorR + (source ^ 1) * 3 + c];
+            pass.normal[c] = pPlanes[NormalX + c];
+        }
+        pass.variance = pPlanes[Variance + source];
+        pass.outVariance = pPlanes[Variance + (source ^ 1)];
+        pass.depth = pPlanes[Depth];
+        pass.width = width;
+        pass.height = height;
+        pass.step = 1u << iteration;
+        pass.colorSigma = m_colorSigma;
+        pass.invNormalSigma2 = 1.f / std::max(m_normalSigma * m_normalSigma, 1e-12f);
+        pass.invDepthSigma = 1.f / std::max(m_depthSigma, 1e-6f);
+        parallelFor(height, [&] (U32 begin, U32 end) -> void {
+            for (U32 y = begin; y < end; ++y)
+                filterRow(pass, y);
+        });
+        source ^= 1;
+    }
+
+    // Put the texture back.
+    parallelFor(height, [&] (U32 begin, U32 end) -> void {
+        for (U32 y = begin; y < end; ++y)
+        {
+            for (U32 x = 0; x < width; ++x)
+            {
+                U64 i = (U64)y * width + x;
+                F32* pPixel = (F32*)radiance.getPixel(x, y);
+                for (U32 c = 0; c < 3; ++c)
+                    pPixel[c] = pPlanes[ColorR + source * 3 + c][i] * std::max(pAlbedo[i * 3 + c], kMinAlbedo);
+            }
+        }
+    });
+}
+} // rt
\ No newline at end of file
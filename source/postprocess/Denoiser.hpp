@@ -0,0 +1,57 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include <vector>
+
+namespace rt {
+
+class RenderPlane;
+class TiledBuffer;
+
+
+// Edge avoiding a-trous wavelet filter, for cleaning up low sample count renders.
+// Radiance is divided by the albedo first, so texture detail isn't blurred, and each pass
+// applies a 5x5 B3 spline with its taps spread twice as far apart as the last. Taps are
+// weighted down where the normal or depth of the first hit differs from the center's, or
+// the lighting differs by more than the noise around it explains. The noise is estimated
+// from the neighbourhood of each pixel, then filtered along with the color.
+class Denoiser
+{
+public:
+    Denoiser(U32 iterations = 5, F32 colorSigma = 4.f, F32 normalSigma = 0.3f, F32 depthSigma = 0.1f)
+        : m_iterations(iterations)
+        , m_colorSigma(colorSigma)
+        , m_normalSigma(normalSigma)
+        , m_depthSigma(depthSigma) { }
+
+    // Each pass doubles the filter's reach, 5 passes cover 61 x 61 pixels.
+    void setIterations(U32 iterations) { m_iterations = iterations; }
+    U32 getIterations() const { return m_iterations; }
+
+    // Edge stopping on the luminance difference, in standard deviations of the noise.
+    void setColorSigma(F32 sigma) { m_colorSigma = sigma; }
+    F32 getColorSigma() const { return m_colorSigma; }
+
+    // Edge stopping on the distance between unit normals.
+    void setNormalSigma(F32 sigma) { m_normalSigma = sigma; }
+    F32 getNormalSigma() const { return m_normalSigma; }
+
+    // Edge stopping on the depth difference, relative to the center's depth.
+    void setDepthSigma(F32 sigma) { m_depthSigma = sigma; }
+    F32 getDepthSigma() const { return m_depthSigma; }
+
+    // Filter tiled RGBA32F radiance in place, guided by the albedo, normal and depth planes of
+    // a render target of the same size. Every pass runs over several threads.
+    void apply(TiledBuffer& radiance, const RenderPlane& albedo, const RenderPlane& normal, const RenderPlane& depth);
+
+private:
+    U32              m_iterations;
+    F32              m_colorSigma;
+    F32              m_normalSigma;
+    F32              m_depthSigma;
+    // One float per pixel for each of two sets of color and variance, the normal and the depth.
+    // Kept between frames so they aren't reallocated every time.
+    std::vector<F32> m_planes;
+};
+} // rt
\ No newline at end of file
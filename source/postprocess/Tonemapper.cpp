@@ -0,0 +1,108 @@
+// Raytracer.
+#include "Tonemapper.hpp"
+
+#include "common/Threading.hpp"
+#include "framebuffer/TiledBuffer.hpp"
+
+#include <math.h>
+
+#if defined SIMD_ENABLE
+#include <immintrin.h>
+#endif
+
+namespace rt {
+
+
+void Tonemapper::setExposure(F32 stops)
+{
+    m_exposure = stops;
+    m_scale = powf(2.f, stops);
+}
+
+Float3 Tonemapper::evaluate(const Float3& sceneReferredColor) const
+{
+    Float3 c = sceneReferredColor * m_scale;
+    switch (m_operator)
+    {
+    case TonemapOperator::Reinhard: c = reinhardtToneMapEvaluate(c); break;
+    case TonemapOperator::ACES:     c = acesFilmicToneMapEvaluate(c); break;
+    default: break;
+    }
+    c.x = c.x < 0.f ? 0.f : (c.x > 1.f ? 1.f : c.x);
+    c.y = c.y < 0.f ? 0.f : (c.y > 1.f ? 1.f : c.y);
+    c.z = c.z < 0.f ? 0.f : (c.z > 1.f ? 1.f : c.z);
+    return c;
+}
+
+#if defined SIMD_ENABLE
+// One RGBA pixel per register, the curves don't mix channels.
+static __m128 tonemapPixel(__m128 c, TonemapOperator op, __m128 scale)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+    c = _mm_mul_ps(c, scale);
+    if (op == TonemapOperator::Reinhard)
+    {
+        c = _mm_div_ps(c, _mm_add_ps(one, c));
+    }
+    else if (op == TonemapOperator::ACES)
+    {
+        __m128 num = _mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+        __m128 den = _mm_add_ps(_mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))),
+                                _mm_set1_ps(0.14f));
+        c = _mm_div_ps(num, den);
+    }
+    c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), one);
+    return _mm_mul_ps(c, _mm_set1_ps(255.999f));
+}
+#endif
+
+// Tonemap count RGBA32F pixels into RGBA8, alpha forced opaque.
+static void tonemapPixels(const Tonemapper& tonemapper, F32 scale, const F32* pSrc, U8* pDst, U32 count)
+{
+    U32 i = 0;
+#if defined SIMD_ENABLE
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128i alpha = _mm_set1_epi32((I32)0xff000000);
+    TonemapOperator op = tonemapper.getOperator();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p0 = _mm_cvttps_epi32(tonemapPixel(_mm_loadu_ps(pSrc + i * 4), op, vScale));
+        __m128i p1 = _mm_cvttps_epi32(tonemapPixel(_mm_loadu_ps(pSrc + i * 4 + 4), op, vScale));
+        __m128i p2 = _mm_cvttps_epi32(tonemapPixel(_mm_loadu_ps(pSrc + i * 4 + 8), op, vScale));
+        __m128i p3 = _mm_cvttps_epi32(tonemapPixel(_mm_loadu_ps(pSrc + i * 4 + 12), op, vScale));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+        _mm_storeu_si128((__m128i*)(pDst + i * 4), _mm_or_si128(packed, alpha));
+    }
+#else
+    // evaluate() applies the tonemapper's own scale.
+    (void)scale;
+#endif
+    for (; i < count; ++i)
+    {
+        Float3 c = tonemapper.evaluate(Float3(pSrc[i * 4 + 0], pSrc[i * 4 + 1], pSrc[i * 4 + 2]));
+        pDst[i * 4 + 0] = U8(c.x * 255.999f);
+        pDst[i * 4 + 1] = U8(c.y * 255.999f);
+        pDst[i * 4 + 2] = U8(c.z * 255.999f);
+        pDst[i * 4 + 3] = U8(255);
+    }
+}
+
+void Tonemapper::apply(const TiledBuffer& radiance, TiledBuffer& color) const
+{
+    if (!radiance.isAllocated() || !color.isAllocated() || radiance.getPixelSize() != sizeof(F32) * 4 ||
+        color.getPixelSize() != 4 || radiance.getTilesX() != color.getTilesX() ||
+        radiance.getTilesY() != color.getTilesY())
+        return;
+
+    // Tiles are contiguous, so each is one flat run of pixels, padding included.
+    const U32 tilePixels = TiledBuffer::kTileSize * TiledBuffer::kTileSize;
+    dispatch({[&] (const ThreadID& id) -> void {
+        U32 tileY = id.global.x;
+        for (U32 tileX = 0; tileX < radiance.getTilesX(); ++tileX)
+        {
+            tonemapPixels(*this, m_scale, (const F32*)radiance.getTile(tileX, tileY),
+                          color.getTile(tileX, tileY), tilePixels);
+        }
+    }, 1, 1, 1 }, radiance.getTilesY(), 1, 1);
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,62 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+namespace rt {
+
+class TiledBuffer;
+
+
+enum class TonemapOperator
+{
+    // Clamp to [0, 1], no curve.
+    Linear,
+    Reinhard,
+    // Narkowicz's fit of the ACES filmic curve.
+    ACES
+};
+
+inline Float3 reinhardtToneMapEvaluate(const Float3& sceneReferredColor)
+{
+    // Simple Reinhardt tonemap.
+    return sceneReferredColor / (1.0f + sceneReferredColor);
+}
+
+inline Float3 acesFilmicToneMapEvaluate(const Float3& sceneReferredColor)
+{
+    const F32 a = 2.51f, b = 0.03f, c = 2.43f, d = 0.59f, e = 0.14f;
+    const Float3& x = sceneReferredColor;
+    return (x * (x * a + b)) / (x * (x * c + d) + e);
+}
+
+// Maps the frame's HDR radiance into displayable 8 bit color, once per frame after all the
+// samples are averaged. Exposure is given in stops and applied before the curve.
+class Tonemapper
+{
+public:
+    Tonemapper(TonemapOperator op = TonemapOperator::Reinhard, F32 exposure = 0.f)
+        : m_operator(op)
+    {
+        setExposure(exposure);
+    }
+
+    void setOperator(TonemapOperator op) { m_operator = op; }
+    TonemapOperator getOperator() const { return m_operator; }
+
+    void setExposure(F32 stops);
+    F32 getExposure() const { return m_exposure; }
+
+    // Tonemap a single color, clamped to [0, 1].
+    Float3 evaluate(const Float3& sceneReferredColor) const;
+
+    // Tonemap tiled RGBA32F radiance into tiled RGBA8 color of the same size, tiles in parallel.
+    void apply(const TiledBuffer& radiance, TiledBuffer& color) const;
+
+private:
+    TonemapOperator m_operator;
+    F32             m_exposure;
+    F32             m_scale;
+};
+} // rt
\ No newline at end of file
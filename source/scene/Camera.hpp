@@ -32,6 +32,11 @@ public:
 
         m_rasterToCamera = m_rasterToScreen * m_screenToCamera;
         m_cameraToRaster = inverse(m_rasterToCamera);
+
+        // Raster to camera is affine in the film position, so stepping one pixel over 
+        // always moves the ray direction by the same amount.
+        m_dxCamera = Float4(1.0f, 0.0f, 0.0f, 0.0f) * m_rasterToCamera;
+        m_dyCamera = Float4(0.0f, 1.0f, 0.0f, 0.0f) * m_rasterToCamera;
     }
 
     void update(Matrix44 cameraToWorld) 
@@ -44,6 +49,11 @@ public:
         Float3 film = Float3(F32(pixelX) + 0.5f, F32(pixelY) + 0.5f, 0.f);
         Float3 camDir = Float4(film, 1.0f) * m_rasterToCamera;
         Ray camRay = Ray(Float3(), normalize(camDir));
+        camRay.hasDifferentials = true;
+        camRay.rxOrigin = camRay.o;
+        camRay.ryOrigin = camRay.o;
+        camRay.rxDirection = normalize(camDir + m_dxCamera);
+        camRay.ryDirection = normalize(camDir + m_dyCamera);
         camRay = camRay * m_cameraToWorld;
         return camRay;
     }
@@ -64,5 +74,9 @@ private:
 
     Matrix44 m_rasterToCamera;
     Matrix44 m_cameraToRaster;
+
+    // Change in camera space ray direction for a one pixel step on the film.
+    Float3 m_dxCamera;
+    Float3 m_dyCamera;
 };
 } // rt
\ No newline at end of file
@@ -0,0 +1,69 @@
+// Raytracer.
+#include "DefaultScene.hpp"
+#include "Camera.hpp"
+#include "Scene.hpp"
+
+#include "Light.hpp"
+#include "Material.hpp"
+#include "geometry/Sphere.hpp"
+#include "loader/Loader.hpp"
+#include "math/CommonMath.hpp"
+#include "math/Matrix44.hpp"
+
+#include <random>
+
+namespace rt {
+
+
+void buildDefaultScene(Scene& scene, SceneAssets& assets, U32 width, U32 height, U64 seed)
+{
+    DirectionLight* pDirLight = scene.createLight<DirectionLight>();
+    pDirLight->enableShadowing(true);
+    pDirLight->wi = Float3(0.0f, 0.9f, 0.0f);
+    pDirLight->l = Float3(30.0f, 30.0f, 30.0f);
+
+    std::mt19937 mt((U32)(seed ^ (seed >> 32)));
+    std::uniform_real_distribution<F32> cc(0.f, 1.f);
+    std::uniform_real_distribution<F32> xy(-10.f, 10.f);
+    std::uniform_real_distribution<F32> z(-15.f, 15.f);
+    
+    for (U32 i = 0; i < 150; ++i) 
+    {
+        Sphere sphere;
+        sphere.m_localToWorld = rotate(translate(identity(), Float3(xy(mt), xy(mt), z(mt))), Float3(1.0f, 0.0f, 0.0f), RT_RAD(90.0f));
+        sphere.m_worldToLocal = inverse(sphere.m_localToWorld);
+        sphere.m_radius = 1.f;
+        //MatteMaterial* mat = scene.createMaterial<MatteMaterial>();
+        //mat->color = Float3(cc(mt), cc(mt), cc(mt));
+        MicrofacetMaterial* mat = scene.createMaterial<MicrofacetMaterial>();
+        mat->color = Float3(cc(mt), cc(mt), cc(mt));
+        mat->kD = 0.04f;
+        scene.createPrimitive(&scene.getSphere(scene.createSphere(sphere)), mat);
+    }
+    {
+        Sphere sphere;
+        sphere.m_localToWorld = translate(identity(), Float3(0.0, -100.0f, 50.f));
+        sphere.m_worldToLocal = inverse(sphere.m_localToWorld);
+        sphere.m_radius = 100.0f;
+        MatteMaterial* mat = scene.createMaterial<MatteMaterial>();
+        mat->color = Float3(0.0f, 0.6f, 0.05f);
+        //MicrofacetMaterial* mat = scene.createMaterial<MicrofacetMaterial>();
+        //mat->color = Float3(cc(mt), cc(mt), cc(mt));
+        //mat->kD = 0.04f;
+        scene.createPrimitive(&scene.getSphere(scene.createSphere(sphere)), mat);
+    }
+
+    scene.addCreatedPrimitives();
+    scene.addLight(pDirLight);
+
+    Float2 resolution{ (F32)width, (F32)height };
+    assets.width = (U32)resolution.x;
+    assets.height = (U32)resolution.y;
+    assets.camera.update(identity());
+    assets.camera.adjustScreenToRaster(resolution);
+    assets.camera.updateProjection(RT_RAD(45.0f), resolution.x / resolution.y, 0.001f, 1000.0f);
+    Matrix44 worldToCamera =  rotate(identity(), Float3(1.0f, 0.0f, 0.0f), RT_RAD(45.0f));
+    worldToCamera = translate(worldToCamera, Float3(0.0, 50.0, -50.0f));
+    assets.camera.update(worldToCamera);
+}
+} // rt
\ No newline at end of file
@@ -0,0 +1,16 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+namespace rt {
+
+
+class Scene;
+struct SceneAssets;
+
+// The scene rendered without a scene file: random spheres over a large green one, lit by the
+// sun. The seed picks their places and colors, the camera frames them at width x height.
+// Shared by the renderer and the benchmarks, so both trace the same thing.
+void buildDefaultScene(Scene& scene, SceneAssets& assets, U32 width, U32 height, U64 seed);
+} // rt
\ No newline at end of file
@@ -1,22 +1,68 @@
 // Raytracer.
 #include "Scene.hpp"
 
+#include "Primitive.hpp"
+#include "Material.hpp"
 #include "math/Ray.hpp"
 #include "acceleration/Aggregate.hpp"
+#include "common/Stats.hpp"
 
 namespace rt {
 
 
 B32 Scene::intersects(const Ray& ray, SurfaceInteraction& si)
 {
+    if (!m_pAggregate || !m_pAggregate->intersects(ray, si))
+        return false;
+    RT_STAT_ADD(Stat::Hits, 1);
+    return true;
+}
+
+B32 Scene::occluded(const Ray& ray)
+{
+    RT_STAT_ADD(Stat::ShadowRays, 1);
     if (!m_pAggregate)
         return false;
-    return m_pAggregate->intersects(ray, si);
+    return m_pAggregate->occluded(ray);
+}
+
+Handle<Primitive> Scene::createPrimitive(Shape* pShape, IMaterial* pMaterial, AreaLight* pAreaLight)
+{
+    // Meshes share a handful of materials between many primitives, each gets one id.
+    U32 materialId = kNoMaterial;
+    if (pMaterial)
+    {
+        auto it = m_materialIds.find(pMaterial);
+        if (it == m_materialIds.end())
+        {
+            it = m_materialIds.emplace(pMaterial, (U32)m_materials.size()).first;
+            m_materials.push_back(pMaterial);
+        }
+        materialId = it->second;
+    }
+    U32 id = m_primitives.size();
+    if (pAreaLight)
+    {
+        materialId |= kEmissiveMaterialBit;
+        m_areaLights[id] = pAreaLight;
+    }
+    return m_primitives.create(pShape, id, materialId);
 }
 
-void Scene::addPrimitive(U32 primitiveCount, Primitive** ppPrimitives)
+void Scene::addCreatedPrimitives()
 {
+    U32 first = m_addedPrimitives;
+    m_addedPrimitives = m_primitives.size();
     if (m_pAggregate)
-        m_pAggregate->addPrimitives(primitiveCount, ppPrimitives);
+        m_pAggregate->addPrimitives(m_primitives, first, m_addedPrimitives - first);
+}
+
+void Scene::commitMaterials()
+{
+    for (IMaterial* pMaterial : m_materials)
+    {
+        if (!pMaterial->isCommitted())
+            pMaterial->commit();
+    }
 }
 } // rt
\ No newline at end of file
@@ -1,9 +1,16 @@
 // Raytracer.
 #pragma once
 
+#include "common/Arena.hpp"
 #include "common/Types.hpp"
 #include "Light.hpp"
+#include "Primitive.hpp"
+#include "acceleration/LightBVH.hpp"
+#include "geometry/Sphere.hpp"
+#include "geometry/TriangleList.hpp"
 
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace rt {
@@ -12,28 +19,108 @@ namespace rt {
 struct SurfaceInteraction;
 struct Primitive;
 struct Light;
+struct IMaterial;
 class Aggregate;
 struct Ray;
 
 class Scene {
 public:
+    Scene() { }
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
     B32 intersects(const Ray& ray, SurfaceInteraction& si);
 
-    void addPrimitive(U32 primitiveCount, Primitive** ppPrimitives);
+    // Whether anything blocks the ray before its tMax, stopping at the first hit found.
+    B32 occluded(const Ray& ray);
+
+    // The scene owns what it's built from. Spheres, triangles and primitives each live in an
+    // arena of their own, so objects created together are traversed from contiguous memory,
+    // never move, and are released together with the scene instead of one by one.
+    Handle<Sphere> createSphere(const Sphere& sphere) { return m_spheres.create(sphere); }
+    Handle<Triangle> createTriangle(const Triangle& triangle) { return m_triangles.create(triangle); }
+    // Primitives are traced once they are added with addCreatedPrimitives(). Their index is
+    // their id, the material and area light are kept as ids too.
+    Handle<Primitive> createPrimitive(Shape* pShape, IMaterial* pMaterial, AreaLight* pAreaLight = nullptr);
+
+    // Hand the primitives created since the last call to the aggregate, in order of creation.
+    void addCreatedPrimitives();
+
+    Sphere& getSphere(Handle<Sphere> sphere) { return m_spheres[sphere]; }
+    Triangle& getTriangle(Handle<Triangle> triangle) { return m_triangles[triangle]; }
+    Primitive& getPrimitive(Handle<Primitive> primitive) { return m_primitives[primitive]; }
+
+    // Material and emitter of the primitive an interaction was made with.
+    IMaterial* getMaterial(const SurfaceInteraction& si) const
+    {
+        U32 index = si.getMaterialIndex();
+        return index < m_materials.size() ? m_materials[index] : nullptr;
+    }
+
+    AreaLight* getAreaLight(const SurfaceInteraction& si) const
+    {
+        if (!si.isEmissive())
+            return nullptr;
+        auto it = m_areaLights.find(si.primitiveId);
+        return it != m_areaLights.end() ? it->second : nullptr;
+    }
+
+    // Materials and lights come in many types, so they share one arena and are handed out by
+    // pointer. Lights still have to be added to be sampled.
+    template <typename T, typename... Args>
+    T* createMaterial(Args&&... args) { return m_objects.create<T>(std::forward<Args>(args)...); }
+
+    template <typename T, typename... Args>
+    T* createLight(Args&&... args) { return m_objects.create<T>(std::forward<Args>(args)...); }
 
     // 
     void setAggregate(Aggregate* pAggregate) { m_pAggregate = pAggregate; }
 
     std::vector<Light*>& getLights() { return m_lights; }
 
-    void addLight(Light* light) { m_lights.push_back(light); }
+    void addLight(Light* light) 
+    { 
+        m_lights.push_back(light); 
+        if (light->isInfinite())
+            m_infiniteLights.push_back(light);
+    }
+
+    // Lights to look up when a ray escapes the scene.
+    std::vector<Light*>& getInfiniteLights() { return m_infiniteLights; }
+
+    // Rebuild the light hierarchy. Must be called after lights are added or moved,
+    // and before rendering.
+    void buildLightSampler() { m_lightSampler.build(m_lights); }
+
+    const LightBVH& getLightSampler() const { return m_lightSampler; }
+
+    // Commit every material used by the primitives added so far that isn't committed yet.
+    // Called before rendering, so materials invalidated between frames are baked again.
+    void commitMaterials();
 
 private:
     // Aggregate contains the structure storing all primitives in the scene.
     // This abstraction provides the interface to determine how to implement
     // an acceleration structure, or container to optimize ray traversal.
-    Aggregate* m_pAggregate;
+    Aggregate* m_pAggregate = nullptr;
 
     std::vector<Light*> m_lights;
+    std::vector<Light*> m_infiniteLights;
+    // Each material once, indexed by material id, and their ids by address.
+    std::vector<IMaterial*>                 m_materials;
+    std::unordered_map<IMaterial*, U32>     m_materialIds;
+    // Emitters of the primitives created as area lights, by primitive id. Few primitives are.
+    std::unordered_map<U32, AreaLight*>     m_areaLights;
+
+    // Hierarchy over m_lights, for picking a few important lights per shading point.
+    LightBVH m_lightSampler;
+
+    TypedArena<Sphere>      m_spheres;
+    TypedArena<Triangle>    m_triangles;
+    TypedArena<Primitive>   m_primitives;
+    MemoryArena             m_objects;
+    // Created primitives before this one have been added already.
+    U32                     m_addedPrimitives = 0;
 };
 } // rt
\ No newline at end of file
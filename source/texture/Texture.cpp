@@ -0,0 +1,236 @@
+// Raytracer.
+#include "Texture.hpp"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+namespace rt {
+
+
+static const char kTextureMagic[4] = { 'R', 'T', 'T', 'X' };
+static const U32 kTextureVersion = 1;
+// A 1x1 level is reached in at most 32 halvings of a 32 bit size.
+static const U32 kMaxTextureLevels = 33;
+
+static std::atomic<U32> g_nextTextureId(1);
+
+static void buildLevels(U32 width, U32 height, std::vector<Texture::MipLevel>& levels)
+{
+    levels.clear();
+    U32 firstTile = 0;
+    while (true)
+    {
+        Texture::MipLevel level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + Texture::kTileSize - 1) / Texture::kTileSize;
+        level.tilesY = (height + Texture::kTileSize - 1) / Texture::kTileSize;
+        level.firstTile = firstTile;
+        levels.push_back(level);
+        firstTile += level.tilesX * level.tilesY;
+        if (width == 1 && height == 1)
+            break;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+static void storeTexel(U8* pOut, const Float4& c, TextureFormat format)
+{
+    if (format == TextureFormat::RGBA32F)
+    {
+        memcpy(pOut, &c.x, sizeof(F32) * 4);
+        return;
+    }
+    for (U32 i = 0; i < 4; ++i)
+    {
+        F32 v = c[i] < 0.f ? 0.f : (c[i] > 1.f ? 1.f : c[i]);
+        pOut[i] = (U8)(unsigned char)(v * 255.f + 0.5f);
+    }
+}
+
+Texture::Texture()
+    : m_id(g_nextTextureId++)
+    , m_format(TextureFormat::RGBA8)
+{
+}
+
+Texture::~Texture()
+{
+    close();
+}
+
+B32 Texture::bake(const std::string& filename, U32 width, U32 height,
+                  const Float4* pixels, TextureFormat format)
+{
+    if (width == 0 || height == 0 || !pixels)
+        return false;
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    std::vector<MipLevel> levels;
+    buildLevels(width, height, levels);
+    U32 tileCount = levels.back().firstTile + levels.back().tilesX * levels.back().tilesY;
+    U32 texelSize = (format == TextureFormat::RGBA8) ? 4u : 16u;
+    U64 tileBytes = (U64)kTileSize * kTileSize * texelSize;
+
+    // Header, level table and tile offsets, followed by the tiles in level order.
+    U32 header[5] = { kTextureVersion, (U32)format, width, height, (U32)levels.size() };
+    fwrite(kTextureMagic, 1, 4, fp);
+    fwrite(header, sizeof(U32), 5, fp);
+    fwrite(levels.data(), sizeof(MipLevel), levels.size(), fp);
+    U64 dataStart = 4 + sizeof(header) + sizeof(MipLevel) * levels.size() + sizeof(U64) * tileCount;
+    std::vector<U64> offsets(tileCount);
+    for (U32 i = 0; i < tileCount; ++i)
+        offsets[i] = dataStart + tileBytes * i;
+    fwrite(offsets.data(), sizeof(U64), tileCount, fp);
+
+    std::vector<Float4> level(pixels, pixels + (U64)width * height);
+    std::vector<U8> tile(tileBytes);
+    for (U32 l = 0; l < levels.size(); ++l)
+    {
+        const MipLevel& mip = levels[l];
+        if (l > 0)
+        {
+            // Box filter the previous level down. Each texel averages the footprint it covers, so
+            // odd sizes fold the last row or column into their neighbour instead of dropping it.
+            const MipLevel& prev = levels[l - 1];
+            std::vector<Float4> next((U64)mip.width * mip.height);
+            for (U32 y = 0; y < mip.height; ++y)
+            {
+                U32 y0 = y * prev.height / mip.height;
+                U32 y1 = (y + 1) * prev.height / mip.height;
+                for (U32 x = 0; x < mip.width; ++x)
+                {
+                    U32 x0 = x * prev.width / mip.width;
+                    U32 x1 = (x + 1) * prev.width / mip.width;
+                    Float4 sum;
+                    for (U32 sy = y0; sy < y1; ++sy)
+                        for (U32 sx = x0; sx < x1; ++sx)
+                            sum = sum + level[(U64)sy * prev.width + sx];
+                    next[(U64)y * mip.width + x] = sum * (1.f / (F32)((x1 - x0) * (y1 - y0)));
+                }
+            }
+            level.swap(next);
+        }
+
+        for (U32 ty = 0; ty < mip.tilesY; ++ty)
+        {
+            for (U32 tx = 0; tx < mip.tilesX; ++tx)
+            {
+                for (U32 y = 0; y < kTileSize; ++y)
+                {
+                    U32 py = ty * kTileSize + y;
+                    py = py < mip.height ? py : mip.height - 1;
+                    for (U32 x = 0; x < kTileSize; ++x)
+                    {
+                        U32 px = tx * kTileSize + x;
+                        px = px < mip.width ? px : mip.width - 1;
+                        storeTexel(&tile[((U64)y * kTileSize + x) * texelSize], level[(U64)py * mip.width + px], format);
+                    }
+                }
+                fwrite(tile.data(), 1, tileBytes, fp);
+            }
+        }
+    }
+
+    B32 ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+B32 Texture::open(const std::string& filename)
+{
+    close();
+    if (!m_file.open(filename))
+        return false;
+
+    // Magic, then version, format, width, height and level count.
+    const U8* pData = m_file.getData();
+    U64 size = m_file.getSize();
+    U32 header[5];
+    U64 headerSize = 4 + sizeof(header);
+    if (size < headerSize || memcmp(pData, kTextureMagic, 4) != 0)
+    {
+        close();
+        return false;
+    }
+    memcpy(header, pData + 4, sizeof(header));
+    U32 format = header[1];
+    U32 width = header[2];
+    U32 height = header[3];
+    U32 levelCount = header[4];
+    if (header[0] != kTextureVersion || format > (U32)TextureFormat::RGBA32F || width == 0 || height == 0 ||
+        levelCount == 0 || levelCount > kMaxTextureLevels)
+    {
+        close();
+        return false;
+    }
+
+    // The level table has to be exactly the one bake() builds for the size, then every tile
+    // it implies has to be inside the file.
+    std::vector<MipLevel> expected;
+    buildLevels(width, height, expected);
+    U64 levelsSize = sizeof(MipLevel) * (U64)levelCount;
+    if (expected.size() != levelCount || size < headerSize + levelsSize)
+    {
+        close();
+        return false;
+    }
+    m_levels.resize(levelCount);
+    memcpy(m_levels.data(), pData + headerSize, levelsSize);
+    for (U32 l = 0; l < levelCount; ++l)
+    {
+        if (memcmp(&m_levels[l], &expected[l], sizeof(MipLevel)) != 0)
+        {
+            close();
+            return false;
+        }
+    }
+
+    m_format = (TextureFormat)format;
+    U32 tileCount = m_levels.back().firstTile + m_levels.back().tilesX * m_levels.back().tilesY;
+    U64 tableStart = headerSize + levelsSize;
+    if (size < tableStart + sizeof(U64) * (U64)tileCount)
+    {
+        close();
+        return false;
+    }
+    m_tileOffsets.resize(tileCount);
+    memcpy(m_tileOffsets.data(), pData + tableStart, sizeof(U64) * (U64)tileCount);
+    U64 tileBytes = getTileSizeInBytes();
+    for (U64 offset : m_tileOffsets)
+    {
+        if (offset > size || size - offset < tileBytes)
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Texture::close()
+{
+    m_file.close();
+    m_levels.clear();
+    m_tileOffsets.clear();
+}
+
+B32 Texture::readTile(U32 level, U32 tileX, U32 tileY, U8* pOut) const
+{
+    if (!m_file.isOpen() || level >= m_levels.size())
+        return false;
+    const MipLevel& mip = m_levels[level];
+    if (tileX >= mip.tilesX || tileY >= mip.tilesY)
+        return false;
+
+    // Offsets were checked against the file's size when it was opened.
+    U64 offset = m_tileOffsets[mip.firstTile + tileY * mip.tilesX + tileX];
+    memcpy(pOut, m_file.getData() + offset, getTileSizeInBytes());
+    return true;
+}
+} // rt
\ No newline at end of file
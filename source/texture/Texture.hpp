@@ -0,0 +1,79 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "loader/MappedFile.hpp"
+#include "math/Float.hpp"
+
+#include <string>
+#include <vector>
+
+namespace rt {
+
+
+enum class TextureFormat : U32
+{
+    RGBA8,
+    RGBA32F
+};
+
+// Texture stored on disk as a mip-mapped pyramid of fixed size tiles. Opening a texture maps
+// the file and only reads its header and tile table. Texels are paged in a tile at a time
+// through a TileCache, so scenes can reference far more texture data than fits in memory.
+//
+// Tiled files are written ahead of time with bake(), which builds the mip chain with a box filter.
+// Edge tiles are padded to the full tile size, so every tile has the same size in memory.
+class Texture
+{
+public:
+    static const U32 kTileSize = 64;
+
+    struct MipLevel
+    {
+        U32 width;
+        U32 height;
+        U32 tilesX;
+        U32 tilesY;
+        // Index of the first tile of this level in the tile table.
+        U32 firstTile;
+    };
+
+    Texture();
+    ~Texture();
+
+    // Write linear RGBA pixels, top row first, as a tiled mip-mapped texture file.
+    static B32 bake(const std::string& filename, U32 width, U32 height,
+                    const Float4* pixels, TextureFormat format = TextureFormat::RGBA8);
+
+    // Open a texture written with bake(). Only the header is read, and checked against the
+    // file, so a truncated or corrupt texture fails here instead of when it's sampled.
+    B32 open(const std::string& filename);
+    void close();
+
+    // Read a single tile from disk into pOut, which must hold getTileSizeInBytes().
+    // Safe to call from multiple threads, which never wait on each other.
+    B32 readTile(U32 level, U32 tileX, U32 tileY, U8* pOut) const;
+
+    U32 getId() const { return m_id; }
+    U32 getWidth() const { return m_levels.empty() ? 0 : m_levels[0].width; }
+    U32 getHeight() const { return m_levels.empty() ? 0 : m_levels[0].height; }
+    U32 getLevelCount() const { return (U32)m_levels.size(); }
+    const MipLevel& getLevel(U32 level) const { return m_levels[level]; }
+    TextureFormat getFormat() const { return m_format; }
+    U32 getTexelSizeInBytes() const { return m_format == TextureFormat::RGBA8 ? 4u : 16u; }
+    U32 getTileSizeInBytes() const { return kTileSize * kTileSize * getTexelSizeInBytes(); }
+
+private:
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    // Unique id, part of the tile cache key.
+    U32                     m_id;
+    TextureFormat           m_format;
+    std::vector<MipLevel>   m_levels;
+    std::vector<U64>        m_tileOffsets;
+
+    // Tiles are copied out of the mapping, the OS pages them in as they're touched.
+    MappedFile              m_file;
+};
+} // rt
\ No newline at end of file
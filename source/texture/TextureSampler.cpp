@@ -0,0 +1,157 @@
+// Raytracer.
+#include "TextureSampler.hpp"
+#include "Texture.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+namespace rt {
+
+
+// Tiles a thread fetched last. Texture ids are never reused and tiles never change, so a tile
+// found here is the one the cache would return, without a shard's lock or a reference count
+// round trip. Slots are replaced in turn, and one sample reads at most two levels of 2x2
+// tiles, so none of the tiles it's reading is let go before it's done. A few tiles per thread
+// stay alive past their eviction from the cache.
+struct RecentTiles
+{
+    static const U32 kSlotCount = 8;
+
+    U64                 keys[kSlotCount];
+    TileCache::TileRef  tiles[kSlotCount];
+    U32                 next = 0;
+
+    RecentTiles()
+    {
+        for (U64& key : keys)
+            key = ~0ULL;
+    }
+};
+
+static thread_local RecentTiles s_recentTiles;
+
+static const U8* findTile(TileCache& cache, const Texture& texture, U32 level, U32 tileX, U32 tileY)
+{
+    RecentTiles& recent = s_recentTiles;
+    U64 key = TileCache::makeKey(texture.getId(), level, tileX, tileY);
+    for (U32 i = 0; i < RecentTiles::kSlotCount; ++i)
+    {
+        if (recent.keys[i] == key)
+            return recent.tiles[i]->data();
+    }
+
+    TileCache::TileRef tile = cache.getTile(texture, level, tileX, tileY);
+    if (!tile)
+        return nullptr;
+    U32 slot = recent.next;
+    recent.next = (slot + 1) % RecentTiles::kSlotCount;
+    recent.keys[slot] = key;
+    recent.tiles[slot] = std::move(tile);
+    return recent.tiles[slot]->data();
+}
+
+static I32 wrap(I32 v, I32 size)
+{
+    I32 r = v % size;
+    return r < 0 ? r + size : r;
+}
+
+Float4 TextureSampler::fetch(const Texture* pTexture, U32 level, I32 x, I32 y, TileLookup& lookup) const
+{
+    const Texture::MipLevel& mip = pTexture->getLevel(level);
+    U32 px = (U32)wrap(x, (I32)mip.width);
+    U32 py = (U32)wrap(y, (I32)mip.height);
+    U32 tileX = px / Texture::kTileSize;
+    U32 tileY = py / Texture::kTileSize;
+
+    if (lookup.level != level || lookup.tileX != tileX || lookup.tileY != tileY)
+    {
+        lookup.pTile = findTile(*m_pCache, *pTexture, level, tileX, tileY);
+        lookup.level = level;
+        lookup.tileX = tileX;
+        lookup.tileY = tileY;
+    }
+    if (!lookup.pTile)
+        return Float4();
+
+    U32 texel = (py % Texture::kTileSize) * Texture::kTileSize + (px % Texture::kTileSize);
+    const U8* pTexel = lookup.pTile + (U64)texel * pTexture->getTexelSizeInBytes();
+    if (pTexture->getFormat() == TextureFormat::RGBA32F)
+    {
+        Float4 c;
+        memcpy(&c.x, pTexel, sizeof(F32) * 4);
+        return c;
+    }
+    const F32 kInv255 = 1.f / 255.f;
+    return Float4((unsigned char)pTexel[0] * kInv255, (unsigned char)pTexel[1] * kInv255,
+                  (unsigned char)pTexel[2] * kInv255, (unsigned char)pTexel[3] * kInv255);
+}
+
+Float4 TextureSampler::nearest(const Texture* pTexture, U32 level, const Float2& uv) const
+{
+    const Texture::MipLevel& mip = pTexture->getLevel(level);
+    TileLookup lookup;
+    return fetch(pTexture, level, (I32)floorf(uv.x * mip.width), (I32)floorf(uv.y * mip.height), lookup);
+}
+
+Float4 TextureSampler::bilinear(const Texture* pTexture, U32 level, const Float2& uv) const
+{
+    const Texture::MipLevel& mip = pTexture->getLevel(level);
+    F32 x = uv.x * mip.width - 0.5f;
+    F32 y = uv.y * mip.height - 0.5f;
+    F32 fx = floorf(x);
+    F32 fy = floorf(y);
+    F32 dx = x - fx;
+    F32 dy = y - fy;
+    I32 x0 = (I32)fx;
+    I32 y0 = (I32)fy;
+
+    TileLookup lookup;
+    return fetch(pTexture, level, x0, y0, lookup) * ((1.f - dx) * (1.f - dy)) +
+           fetch(pTexture, level, x0 + 1, y0, lookup) * (dx * (1.f - dy)) +
+           fetch(pTexture, level, x0, y0 + 1, lookup) * ((1.f - dx) * dy) +
+           fetch(pTexture, level, x0 + 1, y0 + 1, lookup) * (dx * dy);
+}
+
+Float4 TextureSampler::sample(const Texture* pTexture, const Float2& uv, F32 lod) const
+{
+    if (!pTexture || !m_pCache || pTexture->getLevelCount() == 0)
+        return Float4();
+
+    F32 maxLevel = (F32)(pTexture->getLevelCount() - 1);
+    lod = lod < 0.f ? 0.f : (lod > maxLevel ? maxLevel : lod);
+
+    switch (m_filter)
+    {
+    case Filter::Nearest:
+        return nearest(pTexture, (U32)(lod + 0.5f), uv);
+    case Filter::Bilinear:
+        return bilinear(pTexture, (U32)(lod + 0.5f), uv);
+    case Filter::Trilinear:
+    default:
+        {
+            U32 level0 = (U32)lod;
+            F32 t = lod - (F32)level0;
+            Float4 c0 = bilinear(pTexture, level0, uv);
+            if (t == 0.f)
+                return c0;
+            return c0 * (1.f - t) + bilinear(pTexture, level0 + 1, uv) * t;
+        }
+    }
+}
+
+Float4 TextureSampler::sample(const Texture* pTexture, const Float2& uv, const Float2& duvdx, const Float2& duvdy) const
+{
+    if (!pTexture || pTexture->getLevelCount() == 0)
+        return Float4();
+
+    // Footprint in texels at the base level, the longest axis decides.
+    const Texture::MipLevel& mip = pTexture->getLevel(0);
+    F32 dx = fmaxf(fabsf(duvdx.x) * mip.width, fabsf(duvdx.y) * mip.height);
+    F32 dy = fmaxf(fabsf(duvdy.x) * mip.width, fabsf(duvdy.y) * mip.height);
+    F32 width = fmaxf(dx, dy);
+    F32 lod = width > 1.f ? log2f(width) : 0.f;
+    return sample(pTexture, uv, lod);
+}
+} // rt
\ No newline at end of file
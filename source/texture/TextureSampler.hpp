@@ -0,0 +1,62 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+#include "math/Float.hpp"
+
+#include "texture/TileCache.hpp"
+
+namespace rt {
+
+class Texture;
+
+// Filters texels out of tiled textures, going through the shared tile cache.
+// Texture coordinates wrap around (repeat) in both directions.
+class TextureSampler
+{
+public:
+    enum class Filter
+    {
+        Nearest,
+        Bilinear,
+        // Bilinear on the two nearest mip levels, blended by the fractional level of detail.
+        Trilinear
+    };
+
+    TextureSampler(TileCache* pCache = nullptr, Filter filter = Filter::Trilinear)
+        : m_pCache(pCache)
+        , m_filter(filter) { }
+
+    // Sample at uv, at the given level of detail. Level 0 is the full resolution image,
+    // each level up halves it. Returns black if the texture can not be read.
+    Float4 sample(const Texture* pTexture, const Float2& uv, F32 lod = 0.f) const;
+
+    // Sample with a screen space footprint, given as the change in uv over one pixel in x and y. 
+    // The level of detail is picked so that the footprint covers about one texel.
+    Float4 sample(const Texture* pTexture, const Float2& uv, const Float2& duvdx, const Float2& duvdy) const;
+
+    void setCache(TileCache* pCache) { m_pCache = pCache; }
+    TileCache* getCache() const { return m_pCache; }
+
+    void setFilter(Filter filter) { m_filter = filter; }
+    Filter getFilter() const { return m_filter; }
+
+private:
+    // Remembers the last tile fetched, since neighbouring texels usually share it. The tile is
+    // held by the thread's recent tiles for as long as the sample is being filtered.
+    struct TileLookup
+    {
+        U32         level = ~0u;
+        U32         tileX = ~0u;
+        U32         tileY = ~0u;
+        const U8*   pTile = nullptr;
+    };
+
+    Float4 fetch(const Texture* pTexture, U32 level, I32 x, I32 y, TileLookup& lookup) const;
+    Float4 nearest(const Texture* pTexture, U32 level, const Float2& uv) const;
+    Float4 bilinear(const Texture* pTexture, U32 level, const Float2& uv) const;
+
+    TileCache*  m_pCache;
+    Filter      m_filter;
+};
+} // rt
\ No newline at end of file
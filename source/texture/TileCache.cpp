@@ -0,0 +1,109 @@
+// Raytracer.
+#include "TileCache.hpp"
+#include "Texture.hpp"
+
+namespace rt {
+
+
+TileCache::TileCache(U64 capacityInBytes, U32 shardCount)
+    : m_capacity(capacityInBytes)
+{
+    shardCount = shardCount > 0 ? shardCount : 1;
+    m_shards.resize(shardCount);
+    for (U32 i = 0; i < shardCount; ++i)
+    {
+        m_shards[i].reset(new Shard());
+        m_shards[i]->capacity = capacityInBytes / shardCount;
+    }
+}
+
+U64 TileCache::makeKey(U32 textureId, U32 level, U32 tileX, U32 tileY)
+{
+    // 24 bits of texture id, 6 bits of level, and 17 bits for each tile coordinate.
+    return ((U64)(textureId & 0xffffff) << 40ULL) | ((U64)(level & 0x3f) << 34ULL) |
+           ((U64)(tileX & 0x1ffff) << 17ULL) | (U64)(tileY & 0x1ffff);
+}
+
+TileCache::TileRef TileCache::getTile(const Texture& texture, U32 level, U32 tileX, U32 tileY)
+{
+    U64 key = makeKey(texture.getId(), level, tileX, tileY);
+    // Mix the key so neighbouring tiles spread over different shards.
+    U64 h = key * 0x9e3779b97f4a7c15ULL;
+    Shard& shard = *m_shards[(h >> 32ULL) % m_shards.size()];
+
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end())
+        {
+            ++shard.hits;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->tile;
+        }
+        ++shard.misses;
+    }
+
+    // Load outside of the lock, so other threads can keep using the shard while we wait on disk.
+    std::shared_ptr<std::vector<U8>> tile = std::make_shared<std::vector<U8>>(texture.getTileSizeInBytes());
+    if (!texture.readTile(level, tileX, tileY, tile->data()))
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end())
+    {
+        // Another thread loaded the same tile first, keep theirs.
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->tile;
+    }
+
+    shard.lru.push_front({ key, tile });
+    shard.map[key] = shard.lru.begin();
+    shard.bytes += tile->size();
+    while (shard.bytes > shard.capacity && shard.lru.size() > 1)
+    {
+        Entry& victim = shard.lru.back();
+        shard.bytes -= victim.tile->size();
+        shard.map.erase(victim.key);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+    return tile;
+}
+
+TileCache::Stats TileCache::getStats() const
+{
+    Stats stats = { };
+    for (const std::unique_ptr<Shard>& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.evictions += shard->evictions;
+        stats.bytesResident += shard->bytes;
+    }
+    return stats;
+}
+
+void TileCache::resetStats()
+{
+    for (std::unique_ptr<Shard>& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+    }
+}
+
+void TileCache::clear()
+{
+    for (std::unique_ptr<Shard>& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        shard->lru.clear();
+        shard->map.clear();
+        shard->bytes = 0;
+    }
+}
+} // rt
\ No newline at end of file
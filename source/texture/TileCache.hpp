@@ -0,0 +1,82 @@
+// Raytracer.
+#pragma once
+
+#include "common/Types.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rt {
+
+class Texture;
+
+// Fixed size cache of texture tiles, shared by all render threads. Tiles are loaded on demand
+// and the least recently used ones are evicted once the cache is over budget, so memory stays
+// bounded no matter how much texture data the scene references.
+//
+// The cache is split into shards, each with its own lock and LRU list, so threads sampling
+// different tiles rarely contend. Tiles are handed out by reference count; an evicted tile
+// stays alive until the last sampler reading it lets go.
+class TileCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<U8>> TileRef;
+
+    struct Stats
+    {
+        U64 hits;
+        U64 misses;
+        U64 evictions;
+        U64 bytesResident;
+
+        F64 getHitRate() const
+        {
+            U64 lookups = hits + misses;
+            return lookups ? (F64)hits / (F64)lookups : 0.0;
+        }
+    };
+
+    TileCache(U64 capacityInBytes = 256ULL * 1024ULL * 1024ULL, U32 shardCount = 32);
+
+    // Get a tile, loading it from the texture on a miss. Returns nullptr if the tile can not be read.
+    TileRef getTile(const Texture& texture, U32 level, U32 tileX, U32 tileY);
+
+    // Counters accumulated over every shard.
+    Stats getStats() const;
+    void resetStats();
+
+    // Drop every tile.
+    void clear();
+
+    U64 getCapacity() const { return m_capacity; }
+
+    // Key of a tile, unique over every texture opened.
+    static U64 makeKey(U32 textureId, U32 level, U32 tileX, U32 tileY);
+
+private:
+    struct Entry
+    {
+        U64     key;
+        TileRef tile;
+    };
+
+    struct Shard
+    {
+        std::mutex                                          lock;
+        // Most recently used tiles at the front.
+        std::list<Entry>                                    lru;
+        std::unordered_map<U64, std::list<Entry>::iterator> map;
+        U64                                                 bytes = 0;
+        U64                                                 capacity = 0;
+        U64                                                 hits = 0;
+        U64                                                 misses = 0;
+        U64                                                 evictions = 0;
+    };
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    U64                                 m_capacity;
+};
+} // rt
\ No newline at end of file